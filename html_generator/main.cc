@@ -1,44 +1,98 @@
-#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
-#include <filesystem>
+#include <iostream>
+#include <string>
+
+// Usage: html_generator [size...]
+//
+// Writes one response file per size, e.g. "200k" -> index200k.html, "8M" ->
+// index8M.html. Without arguments, an 8000000 byte body is written to
+// index.html. Each file is written under a temporary name and renamed into
+// place, so a server that maps the files never sees one half written.
+
+// Body bytes passed to each write call.
+const size_t kBlockSize = 1 << 20;
+
+// Parses "8000000", "200k" or "8M". Returns -1 if |text| is not a size.
+long long ParseSize(const std::string& text) {
+    char* end = nullptr;
+    long long size = strtoll(text.c_str(), &end, 10);
+    if (end == text.c_str() || size < 0) {
+        return -1;
+    }
+    std::string suffix(end);
+    if (suffix == "k" || suffix == "K") {
+        size *= 1000;
+    } else if (suffix == "m" || suffix == "M") {
+        size *= 1000 * 1000;
+    } else if (!suffix.empty()) {
+        return -1;
+    }
+    return size;
+}
 
-int main() {
-    int size = 8000000;
+bool WriteFile(const std::string& fileName, const std::string& header, long long size) {
     std::string sizeText = std::to_string(size);
 
-    std::ofstream output;
-    std::ifstream readHeader;
+    // 100단위로 작성
+    std::string headerText = header;
+    std::string::size_type pos = 0;
+    while((pos = headerText.find("XXX", pos)) != std::string::npos) {
+        headerText.replace(pos, 3, sizeText);
+        pos += sizeText.length();
+    }
 
-    output.open("index.html");
-    readHeader.open("./header.txt");
+    std::string tempName = fileName + ".tmp";
+    std::ofstream output(tempName, std::ios::binary);
+    if (!output.is_open()) {
+        std::cerr << "Failed to open " << tempName << std::endl;
+        return false;
+    }
+    output.write(headerText.c_str(), headerText.size());
 
-    if(readHeader.is_open()) {
+    std::string block(kBlockSize, 'M');
+    for (long long written = 0; written < size; written += block.size()) {
+        output.write(block.c_str(), std::min<long long>(block.size(), size - written));
+    }
+
+    std::cout << fileName << " File Size: " << output.tellp() << std::endl;
+    output.close();
+    if (!output || std::rename(tempName.c_str(), fileName.c_str()) != 0) {
+        std::cerr << "Failed to write " << fileName << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::ifstream readHeader("./header.txt");
+    std::string header;
+    if (readHeader.is_open()) {
         std::string str;
-        std::string::size_type pos;
-        while(!readHeader.eof()) {
-            getline(readHeader, str);
-
-            pos = 0;
-            // 100단위로 작성
-            while((pos = str.find("XXX", pos)) != std::string::npos) {
-                str.replace(pos, sizeText.length(), sizeText);
-                pos += 4;
-            } 
-            
-            str += "\n";
-            output.write(str.c_str(), str.size());
+        while (getline(readHeader, str)) {
+            header += str + "\n";
         }
+        readHeader.close();
     }
+    // An empty line ends the header block.
+    header += "\n";
 
-    for(int i=0; i<size; i++) {
-        output.write("M", 1);
+    if (argc < 2) {
+        return WriteFile("index.html", header, 8000000) ? 0 : 1;
     }
 
-    output.seekp(0, std::ios::end);
-    std::cout << "File Size: " << output.tellp() << std::endl;
-
-    output.close();
-    readHeader.close();
+    for (int i = 1; i < argc; i++) {
+        long long size = ParseSize(argv[i]);
+        if (size < 0) {
+            std::cerr << "Invalid size: " << argv[i] << std::endl;
+            return 1;
+        }
+        if (!WriteFile("index" + std::string(argv[i]) + ".html", header, size)) {
+            return 1;
+        }
+    }
 
     return 0;
-}
\ No newline at end of file
+}
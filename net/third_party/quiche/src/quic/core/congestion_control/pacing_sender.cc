@@ -10,7 +10,6 @@
 #include "quic/platform/api/quic_logging.h"
 
 #include <iostream>
-#include <fstream>
 
 namespace quic {
 namespace {
@@ -57,12 +56,6 @@ void PacingSender::OnCongestionEvent(bool rtt_updated,
                              acked_packets, lost_packets);
 }
 
-
-QuicTime first_sent_time = QuicTime::Zero();
-QuicTime::Delta diff = QuicTime::Delta::Zero();
-QuicTime::Delta prev_diff = QuicTime::Delta::Zero();
-QuicByteCount prev_cwnd = 0;
-int count;
 void PacingSender::OnPacketSent(
     QuicTime sent_time,
     QuicByteCount bytes_in_flight,
@@ -93,50 +86,10 @@ void PacingSender::OnPacketSent(
     return;
   }
 
-  if(!first_sent) {
-    first_sent_time = sent_time;
-    first_sent = true;
-    diff = QuicTime::Delta::Zero();
-    prev_diff = QuicTime::Delta::Zero();
-    count = 0;
-  }
-
   // The next packet should be sent as soon as the current packet has been
   // transferred.  PacingRate is based on bytes in flight including this packet.
   QuicTime::Delta delay =
       PacingRate(bytes_in_flight + bytes).TransferTime(bytes);
-  
-  diff = sent_time - first_sent_time;
-
-  if(diff.ToMilliseconds() - prev_diff.ToMilliseconds() > 10) {
-    // std::cout << "[pacing_sender] sentTime/PR/BW/PSN/ret/cwnd: " << diff.ToMilliseconds() << " / " << PacingRate(bytes_in_flight + bytes) << " / " 
-    //           << sender_->BandwidthEstimate() << " / "
-    //           << packet_number << " / " 
-    //           << ret_packet_ << " / "
-    //           << sender_->GetCongestionWindow()/kDefaultTCPMSS
-    //           << std::endl;
-
-    std::fstream writer;
-    writer.open("cc_log.txt", std::ios::app);
-    // writer << diff.ToMilliseconds() << '\t' << PacingRate(bytes_in_flight + bytes).ToKBitsPerSecond()  << '\t' 
-    //        << sender_->GetCongestionWindow()/kDefaultTCPMSS << '\t'
-    //        << packet_number << '\t'
-    //        << ret_packet_ << '\t'
-    //        << packet_number - ret_packet_
-    //        << std::endl;
-
-    writer << diff.ToMilliseconds() << '\t' << sender_->BandwidthEstimate().ToKBitsPerSecond()  << '\t' 
-           << sender_->GetCongestionWindow()/kDefaultTCPMSS << '\t'
-           << packet_number << '\t'
-           << ret_packet_ << '\t'
-           << packet_number - ret_packet_
-           << std::endl;
-
-
-    writer.close();
-
-    prev_diff = diff;
-  }
 
   if (!pacing_limited_ || lumpy_tokens_ == 0) {
     // Reset lumpy_tokens_ if either application or cwnd throttles sending or
@@ -193,17 +193,20 @@ class HandoverDetectionAlarmDelegate
 
     void OnAlarm() override {
       QUICHE_DCHECK(connection_->connected());
-      std::cout << "[quic_connection] Handover Detection timeout - " << connection_->timeStamp() - connection_->GetHandoverStart() << "msec" << std::endl;
-
-      if(connection_->OnNetworkUnrearchable() > 1) {
-        std::fstream writer;
-        writer.open("measure_delay.txt", std::ios::app);
-        int64_t pto_3 = connection_->sent_packet_manager().GetPtoDelay().ToMilliseconds() * 3;
-        writer << pto_3 << '\t';
-        writer.close();
-      } else {
+      // [SD] Packets keep the deadline moving without touching the alarm.
+      if (connection_->MaybeRearmHandoverDetection()) {
+        return;
+      }
+      const int result = connection_->OnNetworkUnrearchable();
+      connection_->TraceHandoverEvent(
+          HandoverTraceEvent::kHdtFired,
+          connection_->GetHandoverDetectionDelay().ToMicroseconds(), result);
+      if(result == 0) {
         // [SD] Lookup Fail, Start RLT
         connection_->UpdateRLT();
+      } else if (result == 1) {
+        // [SD] Same route, the silence was not a handover.
+        connection_->OnPathAlive();
       }
     }
 };
@@ -216,7 +219,6 @@ class RoutingTableLookupAlarmDelegate
 
     void OnAlarm() override {
       QUICHE_DCHECK(connection_->connected());
-      std::cout << "[quic_connection] RLT timeout, Lookup routing table - " << connection_->timeStamp() - connection_->GetHandoverStart() << "msec" << std::endl;
 
       // int res = connection_->OnNetworkUnrearchable();
       // if(res == 0) {
@@ -226,8 +228,12 @@ class RoutingTableLookupAlarmDelegate
       //   connection_->OnWriteError(101);
       // }
 
-      if(connection_->OnNetworkUnrearchable() < 2) {
+      const int result = connection_->OnNetworkUnrearchable();
+      connection_->TraceHandoverEvent(HandoverTraceEvent::kRltLookup, 0, result);
+      if(result == 0) {
         connection_->UpdateRLT();
+      } else if (result == 1) {
+        connection_->OnPathAlive();
       } else {
         connection_->CancelRLT();
       }
@@ -243,7 +249,7 @@ class RoutingTableLookupDeadlineAlarmDelegate
     void OnAlarm() override {
       QUICHE_DCHECK(connection_->connected());
 
-      std::cout << "[quic_connection] Fail to find available routing info, close the connection - " << connection_->timeStamp() - connection_->GetHandoverStart() << "msec" << std::endl;
+      connection_->TraceHandoverEvent(HandoverTraceEvent::kRltDeadline);
       connection_->CancelRLT();
       connection_->OnWriteError(101);
     }
@@ -353,12 +359,6 @@ QuicConnection::QuicConnection(
       discard_zero_rtt_decryption_keys_alarm_(alarm_factory_->CreateAlarm(
           arena_.New<DiscardZeroRttDecryptionKeysAlarmDelegate>(this),
           &arena_)),
-      hdt_alarm_(alarm_factory_->CreateAlarm(
-          arena_.New<HandoverDetectionAlarmDelegate>(this), &arena_)),
-      rlt_alarm_(alarm_factory_->CreateAlarm(
-          arena_.New<RoutingTableLookupAlarmDelegate>(this), &arena_)),
-      rlt_deadline_alarm_(alarm_factory_->CreateAlarm(
-          arena_.New<RoutingTableLookupDeadlineAlarmDelegate>(this), &arena_)),    
       visitor_(nullptr),
       debug_visitor_(nullptr),
       cb_visitor_(nullptr),
@@ -439,14 +439,55 @@ QuicConnection::QuicConnection(
     }
   }
   packet_creator_.SetDefaultPeerAddress(initial_peer_address);
-  rlt_interval_ = 10;
+  trace_id_ = server_connection_id.Hash();
+}
+
+HandoverController* QuicConnection::GetOrCreateHandoverController() {
+  if (handover_ == nullptr) {
+    QUICHE_DCHECK_EQ(Perspective::IS_CLIENT, perspective_);
+    // The alarms live on the heap rather than in arena_, which is sized for
+    // the alarms every connection has.
+    handover_ = std::make_unique<HandoverController>(
+        alarm_factory_->CreateAlarm(new HandoverDetectionAlarmDelegate(this)),
+        alarm_factory_->CreateAlarm(new RoutingTableLookupAlarmDelegate(this)),
+        alarm_factory_->CreateAlarm(
+            new RoutingTableLookupDeadlineAlarmDelegate(this)));
+  }
+  return handover_.get();
+}
+
+QuicTime::Delta QuicConnection::GetHandoverDetectionDelay() const {
+  if (handover_ == nullptr) {
+    return sent_packet_manager_.GetPtoDelay() * 3;
+  }
+  return handover_->detector().GetDetectionDelay(
+      sent_packet_manager_.GetPtoDelay(),
+      visitor_->ShouldKeepConnectionAlive());
+}
+
+void QuicConnection::ArmHandoverDetection() {
+  const QuicTime::Delta delay = GetHandoverDetectionDelay();
+  TraceHandoverEvent(HandoverTraceEvent::kHdtArmed, delay.ToMicroseconds());
+  handover_->hdt_alarm()->Set(handover_->detector().last_activity_time() +
+                              delay);
+}
+
+bool QuicConnection::MaybeRearmHandoverDetection() {
+  const QuicTime deadline = handover_->detector().last_activity_time() +
+                            GetHandoverDetectionDelay();
+  if (deadline <= clock_->ApproximateNow()) {
+    return false;
+  }
+  handover_->hdt_alarm()->Set(deadline);
+  return true;
 }
 
 void QuicConnection::UpdateRLT() {
-  rlt_alarm_->Update(clock_->ApproximateNow() + quic::QuicTime::Delta::FromMilliseconds(rlt_interval_), kAlarmGranularity);
+  HandoverController* handover = GetOrCreateHandoverController();
+  handover->rlt_alarm()->Update(clock_->ApproximateNow() + quic::QuicTime::Delta::FromMilliseconds(handover->rlt_interval_ms()), kAlarmGranularity);
 
-  if(!rlt_deadline_alarm_->IsSet()) {
-     rlt_deadline_alarm_->Update(GetNetworkBlackholeDeadline(), kAlarmGranularity);
+  if(!handover->rlt_deadline_alarm()->IsSet()) {
+     handover->rlt_deadline_alarm()->Update(GetNetworkBlackholeDeadline(), kAlarmGranularity);
   }
 
   // int lookup_interval;
@@ -475,12 +516,65 @@ void QuicConnection::UpdateRLT() {
   //std::cout << "State : " << rlt_alarm_->IsSet() << std::endl;
 }
 
+void QuicConnection::ScheduleRouteLookup() {
+  HandoverController* handover = GetOrCreateHandoverController();
+  QuicTime lookup_time = clock_->ApproximateNow();
+  const QuicTime earliest =
+      handover->last_lookup_time() +
+      QuicTime::Delta::FromMilliseconds(handover->rlt_interval_ms());
+  if (handover->last_lookup_time().IsInitialized() && earliest > lookup_time) {
+    lookup_time = earliest;
+  }
+  handover->rlt_alarm()->Update(lookup_time, kAlarmGranularity);
+  if (!handover->rlt_deadline_alarm()->IsSet()) {
+    handover->rlt_deadline_alarm()->Update(GetNetworkBlackholeDeadline(),
+                                           kAlarmGranularity);
+  }
+}
+
 void QuicConnection::CancelRLT() {
-  rlt_alarm_->Cancel();
-  rlt_deadline_alarm_->Cancel();
+  if (handover_ != nullptr) {
+    handover_->CancelRLT();
+  }
+}
+
+void QuicConnection::ReplayHandoverFrames() {
+  if (handover_ == nullptr || handover_->handover_frames().empty()) {
+    return;
+  }
+  if (session_notifier_ == nullptr) {
+    handover_->ClearHandoverFrames();
+    return;
+  }
+
+  ScopedPacketFlusher flusher(this);
+  const bool is_processing_packet = framer_.is_processing_packet();
+  // Acknowledge what was received on the old path first, so that the peer
+  // does not wait for a PTO to resend on its side. While a packet is being
+  // processed, the ACK goes out once processing is done.
+  if (!is_processing_packet && SupportsMultiplePacketNumberSpaces() &&
+      uber_received_packet_manager_.GetEarliestAckTimeout().IsInitialized()) {
+    SendAllPendingAcks();
+  }
+  // The session retransmits lost crypto and control frames (flow control
+  // updates among them) before lost stream data.
+  for (const QuicFrame& frame : handover_->handover_frames()) {
+    if (session_notifier_->IsFrameOutstanding(frame)) {
+      session_notifier_->OnFrameLost(frame);
+    }
+  }
+  handover_->ClearHandoverFrames();
+  if (!is_processing_packet) {
+    WriteIfNotBlocked();
+  }
 }
 
 
+void QuicConnection::OnPathAlive() {
+  CancelRLT();
+  ReplayHandoverFrames();
+}
+
 void QuicConnection::InstallInitialCrypters(QuicConnectionId connection_id) {
   CrypterPair crypters;
   CryptoUtils::CreateInitialObfuscators(perspective_, version(), connection_id,
@@ -1253,6 +1347,19 @@ void QuicConnection::OnSuccessfulMigration(bool is_port_change) {
   }
 }
 
+std::string QuicConnection::GetNetworkId(const QuicIpAddress& self_host) const {
+  if (!self_host.IsInitialized()) {
+    return "";
+  }
+  const QuicIpAddress gateway = cb_visitor_ == nullptr
+                                    ? QuicIpAddress()
+                                    : cb_visitor_->GetNetworkGateway(self_host);
+  if (!gateway.IsInitialized()) {
+    return self_host.ToString();
+  }
+  return absl::StrCat(self_host.ToString(), "/", gateway.ToString());
+}
+
 void QuicConnection::OnTransportParametersSent(
     const TransportParameters& transport_parameters) const {
   if (debug_visitor_ != nullptr) {
@@ -1450,7 +1557,6 @@ uint64_t QuicConnection::timeStamp() {
   return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 }
 
-QuicSocketAddress checkAddress;
 bool QuicConnection::OnStreamFrame(const QuicStreamFrame& frame) {
   QUIC_BUG_IF(quic_bug_12714_3, !connected_)
       << "Processing STREAM frame when connection is closed. Last frame: "
@@ -1499,35 +1605,20 @@ bool QuicConnection::OnStreamFrame(const QuicStreamFrame& frame) {
   // std::cout << "[quic_connection] Has in flight packet? " << sent_packet_manager_.HasInFlightPackets() 
   //             << " Has pending ack? " << HasPendingAcks() << std::endl;
 
-  if(first_try) {
-    //std::cout << "[quic_connection] first try" << std::endl;
-    checkAddress = last_received_packet_info_.destination_address;
-    first_rcv_ = timeStamp();
-    first_try = false;
-  }
-
-  if(checkAddress.host() == last_received_packet_info_.destination_address.host()) {
-    //if(!cm_state_)
-    //  std::cout << "[quic_connection] stream(" << timeStamp() - ho_start_ << "msec)... - default: " << default_path_.self_address << " last_packet: " << last_received_packet_info_.destination_address << std::endl;
-    //if(ho_delay_ == 0)
-      ho_start_ = timeStamp();
-
-    // if(checkAddress.port() != last_received_packet_info_.destination_address.port()) {
-    //   std::cout << "but port is different from " << checkAddress.port() << " to " << last_received_packet_info_.destination_address.port() << std::endl;
-    // }
-
-  } else {
-    //std::cout << "[quic_connection] ho_start_ = " << ho_start_ << std::endl;
-    ho_delay_ = timeStamp() - ho_start_;
-    //ho_start_ = timeStamp();
-
-    //std::fstream writer;
-    //hdt_alarm_->Cancel();
-    std::cout << "[quic_connection] Received stream frame after HO from "<< checkAddress.host() << " to " << last_received_packet_info_.destination_address.host() << ", Handover Delay : " << ho_delay_ <<  " ms" << std::endl;
-    // writer.open("ho_data.txt", std::ios::app);
-    // writer << ho_delay_ << std::endl;
-    // writer.close();
-    checkAddress = last_received_packet_info_.destination_address;
+  // [SD] QuicClock instead of the wall clock, this runs for every STREAM
+  // frame. A multipath server may keep sending on the previous path after a
+  // migration, only frames on the default path count.
+  if (handover_ != nullptr &&
+      last_received_packet_info_.destination_address ==
+          default_path_.self_address &&
+      handover_->OnStreamFrame(
+          clock_->ApproximateNow(),
+          last_received_packet_info_.destination_address)) {
+    TraceHandoverEvent(HandoverTraceEvent::kFirstDataOnNewPath,
+                       handover_->handover_delay().ToMicroseconds());
+    QUIC_DVLOG(1) << ENDPOINT << "Received stream frame after HO on "
+                  << last_received_packet_info_.destination_address.host()
+                  << ", Handover Delay : " << handover_->handover_delay();
   }
 
   return connected_;
@@ -1879,7 +1970,9 @@ bool QuicConnection::OnPathChallengeFrame(const QuicPathChallengeFrame& frame) {
   // [SD] cwnd override
   //sent_packet_manager_.cwind_override = true;
 
-  std::cout << "[quic_connection] Received PC - last ip: " << last_received_packet_info_.destination_address <<"  cur ip: "<< default_path_.self_address << " - " << timeStamp() - ho_start_ << " msec" << std::endl;
+  TraceHandoverEvent(HandoverTraceEvent::kPathChallengeReceived, 0,
+                     default_path_.self_address ==
+                         last_received_packet_info_.destination_address);
   if (has_path_challenge_in_current_packet_) {
     QUICHE_DCHECK(send_path_response_);
     QUIC_RELOADABLE_FLAG_COUNT_N(quic_send_path_response2, 2, 5);
@@ -1975,20 +2068,17 @@ bool QuicConnection::OnPathChallengeFrameInternal(
   return connected_;
 }
 
-QuicTime pv_start = QuicTime::Zero();
-QuicTime pv_end = QuicTime::Zero();
 bool QuicConnection::OnPathResponseFrame(const QuicPathResponseFrame& frame) {
   QUIC_BUG_IF(quic_bug_10511_9, !connected_)
       << "Processing PATH_RESPONSE frame when connection "
          "is closed. Last frame: "
       << most_recent_frame_type_;
 
-  pv_end = clock_->Now();
-  std::cout << "[quic_connection] Received PR - "
-            << GetEffectivePeerAddressFromCurrentPacket() << " - "
-            << timeStamp() - ho_start_ << " msec"
-            << std::endl;
-  sent_packet_manager_.SetPathValidationRtt(pv_end-pv_start);
+  const QuicTime::Delta path_validation_rtt =
+      clock_->Now() - path_challenge_sent_time_;
+  TraceHandoverEvent(HandoverTraceEvent::kPathResponseReceived,
+                     path_validation_rtt.ToMicroseconds());
+  sent_packet_manager_.SetPathValidationRtt(path_validation_rtt);
 
 
   if (!UpdatePacketContent(PATH_RESPONSE_FRAME)) {
@@ -2034,10 +2124,6 @@ bool QuicConnection::OnConnectionCloseFrame(
     // measure connection migration
     //std::cout << "[quic_connection] Server Connection Close - cid: " << GetOneActiveServerConnectionId() << std::endl;
     sent_packet_manager_.initMeasureState();
-    std::fstream writer;
-    writer.open("cc_log.txt", std::ios::app);
-    writer << std::endl;
-    writer.close();
 
     cm_state_ = false;
     maxWindow = 0;
@@ -2265,7 +2351,9 @@ bool QuicConnection::OnNewConnectionIdFrame(
   }
 
   //std::cout << "[quic_connection] Received NEW_CONNECTION_ID frame, so it is able to do next CM" << std::endl;
-  ho_state_ = true;
+  if (handover_ != nullptr) {
+    handover_->set_handover_state(true);
+  }
   return OnNewConnectionIdFrameInner(frame);
 }
 
@@ -3052,9 +3140,12 @@ void QuicConnection::ProcessUdpPacket(const QuicSocketAddress& self_address,
   current_packet_data_ = packet.data();
 
   // when received the packets,
-  if(active_cm_) {
+  if(handover_ != nullptr && handover_->active_cm()) {
     //std::cout << "[quic_connection] update HDT, RLT - " << last_received_packet_info_.destination_address << std::endl;
-    hdt_alarm_->Update(clock_->ApproximateNow() + sent_packet_manager_.GetPtoDelay()*3, kAlarmGranularity);
+    handover_->detector()->OnPacketReceived(clock_->ApproximateNow());
+    if (!handover_->hdt_alarm()->IsSet()) {
+      ArmHandoverDetection();
+    }
   }
 
   //std::cout << "[quic_connection] received udp " << "(" << timeStamp() - ho_start_ << "msec)" << std::endl;
@@ -3122,6 +3213,18 @@ void QuicConnection::ProcessUdpPacket(const QuicSocketAddress& self_address,
 
   ++stats_.packets_processed;
 
+  // [SD] A packet made it through, so a pending lookup has nothing to find.
+  // Frames buffered by a transient ENETUNREACH are replayed even if no
+  // lookup is pending, otherwise they would hold up CanWrite() for good.
+  if (handover_ != nullptr) {
+    if (handover_->rlt_alarm()->IsSet() ||
+        handover_->rlt_deadline_alarm()->IsSet()) {
+      OnPathAlive();
+    } else if (!handover_->handover_frames().empty()) {
+      ReplayHandoverFrames();
+    }
+  }
+
   QUIC_DLOG_IF(INFO, active_effective_peer_migration_type_ != NO_CHANGE)
       << "sent_packet_manager_.GetLargestObserved() = "
       << sent_packet_manager_.GetLargestObserved()
@@ -3151,7 +3254,6 @@ void QuicConnection::ProcessUdpPacket(const QuicSocketAddress& self_address,
 }
 
 void QuicConnection::OnBlockedWriterCanWrite() {
-  std::cout << "[quic_connection] OnBlockedWriterCanWrite()" << std::endl;
   writer_->SetWritable();
   OnCanWrite();
 }
@@ -3163,7 +3265,6 @@ void QuicConnection::SendAckNow() {
   }
   ScopedPacketFlusher flusher(this);
   QuicFrames frames;
-  std::cout << "[quic_connection] Send ACK after migration" << std::endl;
   frames.push_back(uber_received_packet_manager_.GetUpdatedAckFrame(
       static_cast<PacketNumberSpace>(APPLICATION_DATA), clock_->ApproximateNow()));
   packet_creator_.FlushAckFrame(frames);
@@ -3175,7 +3276,6 @@ void QuicConnection::OnCanWrite() {
     return;
   }
   if (writer_->IsWriteBlocked()) {
-    std::cout << "[quic_connection] IsWriteBlocked()" << std::endl;
     const std::string error_details =
         "Writer is blocked while calling OnCanWrite.";
     QUIC_BUG(quic_bug_10511_22) << ENDPOINT << error_details;
@@ -3615,6 +3715,13 @@ bool QuicConnection::CanWrite(HasRetransmittableData retransmittable) {
     return false;
   }
 
+  // [SD] Frames that failed with ENETUNREACH are only retransmitted from the
+  // handover buffer, so do not grow it further until they are replayed.
+  if (retransmittable == HAS_RETRANSMITTABLE_DATA && handover_ != nullptr &&
+      handover_->handover_frames_full()) {
+    return false;
+  }
+
   if (GetQuicReloadableFlag(quic_suppress_write_mid_packet_processing) &&
       version().CanSendCoalescedPackets() &&
       framer_.HasEncrypterOfEncryptionLevel(ENCRYPTION_INITIAL) &&
@@ -3807,6 +3914,15 @@ bool QuicConnection::WritePacket(SerializedPacket* packet) {
   //   std::cout << "[quic_connection] send to address : " << send_to_address << std::endl;
   // }
 
+  // [SD] Data for the default path may be scheduled on the secondary path.
+  const bool on_secondary_path = send_to_address == peer_address() &&
+                                 fate == SEND_TO_WRITER &&
+                                 !is_termination_packet && !is_mtu_discovery &&
+                                 ShouldSendOnSecondaryPath(*packet);
+  if (on_secondary_path) {
+    send_to_address = secondary_peer_address_;
+  }
+
   // Self address is always the default self address on this code path.
   bool send_on_current_path = send_to_address == peer_address();
   switch (fate) {
@@ -3959,44 +4075,36 @@ bool QuicConnection::WritePacket(SerializedPacket* packet) {
       // The write failed, but the writer is not blocked, so return true.
       return true;
     }
-    if (use_path_validator_ && !send_on_current_path) {
+    if (use_path_validator_ && !send_on_current_path && !on_secondary_path) {
       QUIC_RELOADABLE_FLAG_COUNT_N(quic_pass_path_response_to_validator, 2, 4);
       // Only handle MSG_TOO_BIG as error on current path.
       return true;
     }
   }
 
-  if (IsWriteError(result.status)) {
-      std::cout << "[quic_connection] Network is unreachable - (" << timeStamp() - ho_start_ << " msec" << ")" <<  std::endl;
-      std::fstream w;
-
-      w.open("error_type.txt", std::ios::app);
-      for(unsigned long i=0; i<packet->retransmittable_frames.size(); i++) {
-        std::cout << packet->retransmittable_frames[i];
-        w << packet->retransmittable_frames[i].type << " ";
-      }
-
-      for(unsigned long i=0; i<packet->nonretransmittable_frames.size(); i++) {
-        std::cout << packet->nonretransmittable_frames[i];
-        
-        w << packet->nonretransmittable_frames[i].type << " ";
-      }
-      w << std::endl;
-      w.close();
+  // [SD] A write error on the secondary path retires that path below rather
+  // than failing the connection.
+  const bool secondary_write_failed =
+      on_secondary_path && IsWriteError(result.status);
+  if (IsWriteError(result.status) && !secondary_write_failed) {
+    TraceHandoverEvent(HandoverTraceEvent::kWriteError,
+                       packet_number.ToUint64(), result.error_code);
 
     // [SD] Ignore network unreachable error
-    if(active_cm_ && result.error_code == 101) {
-      if(watcher_ == true)
+    if(IsActiveCM() && result.error_code == 101) {
+      if(handover_->watcher())
         return true;
 
-      // cancel T[hd] to prevent from setting T[close] again
-      hdt_alarm_->Cancel();
-      if(!rlt_alarm_->IsSet()) {
-        if(OnNetworkUnrearchable() < 2) {
-          UpdateRLT();
-        }
+      handover_->BufferHandoverFrames(
+          *packet, helper_->GetStreamSendBufferAllocator());
+      // [SD] The route is looked up from the RLT alarm, not here: migrating
+      // swaps the writer and writes out queued packets, which must not
+      // happen while this packet is being written.
+      if(!handover_->rlt_alarm()->IsSet()) {
+        // cancel T[hd] to prevent from setting T[close] again
+        handover_->hdt_alarm()->Cancel();
+        ScheduleRouteLookup();
       }
-      pending_packets_.push_back(CopySerializedPacket(*packet, helper_->GetStreamSendBufferAllocator(), false));
       return true;
     }
 
@@ -4100,7 +4208,14 @@ bool QuicConnection::WritePacket(SerializedPacket* packet) {
 
   const bool in_flight = sent_packet_manager_.OnPacketSent(
       packet, packet_send_time, packet->transmission_type,
-      IsRetransmittable(*packet), /*measure_rtt=*/send_on_current_path);
+      IsRetransmittable(*packet), /*measure_rtt=*/send_on_current_path,
+      on_secondary_path);
+  if (secondary_write_failed) {
+    QUIC_DLOG(INFO) << ENDPOINT << "Failed writing to secondary path "
+                    << send_to_address << " with error code "
+                    << result.error_code << ", retiring it.";
+    sent_packet_manager_.RetireSecondaryPath();
+  }
 
   // std::cout << "[quic_connection] After call sentPacket - in flight(" << packet->transmission_type << ") - ";
   // for(unsigned long i=0; i<packet->retransmittable_frames.size(); i++) {
@@ -4198,8 +4313,11 @@ bool QuicConnection::WritePacket(SerializedPacket* packet) {
   }
 
   // when sent the packets
-  if(active_cm_) {
-      hdt_alarm_->Update(clock_->ApproximateNow() + sent_packet_manager_.GetPtoDelay()*3, kAlarmGranularity);
+  if(handover_ != nullptr && handover_->active_cm()) {
+      handover_->detector()->OnActivity(clock_->ApproximateNow());
+      if (!handover_->hdt_alarm()->IsSet()) {
+        ArmHandoverDetection();
+      }
   }
   return true;
 }
@@ -5218,8 +5336,9 @@ void QuicConnection::CancelAllAlarms() {
   discard_previous_one_rtt_keys_alarm_->PermanentCancel();
   discard_zero_rtt_decryption_keys_alarm_->PermanentCancel();
   // rt
-  hdt_alarm_->PermanentCancel();
-  rlt_alarm_->PermanentCancel();
+  if (handover_ != nullptr) {
+    handover_->PermanentCancelAlarms();
+  }
 
   blackhole_detector_.StopDetection(/*permanent=*/true);
   idle_network_detector_.StopDetection();
@@ -5669,15 +5788,6 @@ bool QuicConnection::WritePacketUsingWriter(
       packet->encrypted_buffer, packet->encrypted_length, self_address.host(),
       peer_address, per_packet_options_);
 
-  //std::cout << "[quic_connection] WritePacketUsingWriter:" << std::endl;
-  for(unsigned long i=0; i<packet->nonretransmittable_frames.size(); i++) {
-      std::cout << packet->nonretransmittable_frames[i] << std::endl;
-  }
-  for(unsigned long i=0; i<packet->retransmittable_frames.size(); i++) {
-      std::cout << packet->retransmittable_frames[i] << std::endl;
-  }
-
-
   // If using a batch writer and the probing packet is buffered, flush it.
   if (writer->IsBatchMode() && result.status == WRITE_STATUS_OK &&
       result.bytes_written == 0) {
@@ -5779,6 +5889,8 @@ void QuicConnection::OnEffectivePeerMigrationValidated() {
 
   // Lift anti-amplification limit.
   default_path_.validated = true;
+  // [SD] The alternative path is the one the peer left.
+  MaybeStartSecondaryPath(alternative_path_);
   alternative_path_.Clear();
   if (send_address_token) {
     //std::cout << "[quic_connection] Send NEW TOKEN" << std::endl;
@@ -5889,6 +6001,10 @@ void QuicConnection::StartEffectivePeerMigration(AddressChangeType type) {
     previous_default_path.rtt_stats.emplace();
     previous_default_path.rtt_stats->CloneFrom(
         *sent_packet_manager_.GetRttStats());
+    // [SD] The client's network is identified by its address as seen here.
+    sent_packet_manager_.CachePathState(
+        previous_default_path.peer_address.host().ToString(),
+        clock_->ApproximateNow());
     // If the new peer address share the same IP with the alternative path, the
     // connection should switch to the congestion controller of the alternative
     // path. Otherwise, the connection should use a brand new one.
@@ -5907,6 +6023,12 @@ void QuicConnection::StartEffectivePeerMigration(AddressChangeType type) {
           alternative_path_.send_algorithm.release());
       sent_packet_manager_.SetRttStats(
           std::move(alternative_path_.rtt_stats).value());
+    } else {
+      // [SD] Start from the cached state if the client has been on this
+      // network recently instead of slow starting.
+      sent_packet_manager_.RestorePathState(
+          current_effective_peer_address.host().ToString(),
+          clock_->ApproximateNow());
     }
   }
   // Update to the new peer address.
@@ -5966,6 +6088,7 @@ void QuicConnection::StartEffectivePeerMigration(AddressChangeType type) {
       // validation.
       ++stats_.num_peer_migration_to_proactively_validated_address;
     }
+    MaybeStartSecondaryPath(previous_default_path);
     //std::cout << "[quic_connection] Default path is already validated, maybe send NEW TOKEN" << std::endl;
     OnEffectivePeerMigrationValidated();
     return;
@@ -6324,6 +6447,7 @@ void QuicConnection::PostProcessAfterAckFrame(bool send_stop_waiting,
 
 void QuicConnection::SetSessionNotifier(
     SessionNotifierInterface* session_notifier) {
+  session_notifier_ = session_notifier;
   sent_packet_manager_.SetSessionNotifier(session_notifier);
 }
 
@@ -6458,8 +6582,9 @@ void QuicConnection::SendAllPendingAcks() {
   QUIC_DVLOG(1) << ENDPOINT << "Trying to send all pending ACKs";
   //std::cout << "[quic_connection] Send all pending ACK" << std::endl;
   ack_alarm_->Cancel();
-  if(ho_delay_ == 0)
-    sent_ack_num++;
+  if (handover_ != nullptr) {
+    handover_->OnAcksSent();
+  }
   //std::cout << "[quic_connection] sent ack num: " << sent_ack_num << std::endl;
   QuicTime earliest_ack_timeout =
       uber_received_packet_manager_.GetEarliestAckTimeout();
@@ -7104,15 +7229,15 @@ bool QuicConnection::SendPathChallenge(
       QuicPacketCreator::ScopedPeerAddressContext context(
           &packet_creator_, peer_address, client_cid, server_cid,
           connection_migration_use_new_cid_);
-      pv_start = clock_->Now();
+      path_challenge_sent_time_ = clock_->Now();
       if (writer == writer_) {
         ScopedPacketFlusher flusher(this);
         // It's on current path, add the PATH_CHALLENGE the same way as other
         // frames. This may cause connection to be closed.
-        std::cout << "[quic_connection] Send PC (Non-Probing packet) from:" << self_address << "  to:" << peer_address << " - " << timeStamp() - ho_start_ << "msec" << std::endl;
+        TraceHandoverEvent(HandoverTraceEvent::kPathChallengeSent, 0, 1);
         packet_creator_.AddPathChallengeFrame(data_buffer);
       } else {
-        std::cout << "[quic_connection] Send PC (Probing Packet) from:" << self_address << "  to:" << peer_address << " - " << timeStamp() - ho_start_ << "msec" << std::endl;
+        TraceHandoverEvent(HandoverTraceEvent::kPathChallengeSent, 0, 0);
         std::unique_ptr<SerializedPacket> probing_packet =
             packet_creator_.SerializePathChallengeConnectivityProbingPacket(
                 data_buffer);
@@ -7124,7 +7249,9 @@ bool QuicConnection::SendPathChallenge(
       }
     }
 
-    rlt_alarm_->Cancel();
+    if (handover_ != nullptr) {
+      handover_->rlt_alarm()->Cancel();
+    }
     return connected_;
   }
   if (writer == writer_) {
@@ -7260,7 +7387,7 @@ bool QuicConnection::SendPathResponse(
       last_received_packet_info_.destination_address) {
     // The PATH_CHALLENGE is received on the default socket. Respond on the same
     // socket.
-    std::cout << "[quic_connection] Send PR from " << default_path_.self_address << " to " << peer_address_to_send << " - " << timeStamp() - ho_start_ << "msec - Default path" << std::endl;
+    TraceHandoverEvent(HandoverTraceEvent::kPathResponseSent, 0, 1);
     return packet_creator_.AddPathResponseFrame(data_buffer);
   }
 
@@ -7287,7 +7414,7 @@ bool QuicConnection::SendPathResponse(
   // Ignore the return value to treat write error on the alternative writer as
   // part of network error. If the writer becomes blocked, wait for the peer to
   // send another PATH_CHALLENGE.
-  std::cout << "[quic_connection] Send PR to " << peer_address_to_send  <<  " - " << timeStamp() - ho_start_ << "msec - Alternative Path"  << std::endl;
+  TraceHandoverEvent(HandoverTraceEvent::kPathResponseSent, 0, 0);
   WritePacketUsingWriter(std::move(probing_packet), writer,
                          last_received_packet_info_.destination_address,
                          peer_address_to_send,
@@ -7423,16 +7550,32 @@ bool QuicConnection::MigratePath(const QuicSocketAddress& self_address,
                                self_address_change_type == NO_CHANGE) &&
                               (peer_address_change_type == PORT_CHANGE ||
                                peer_address_change_type == NO_CHANGE);
+  const bool resets_path_state = version().HasIetfQuicFrames() &&
+                                 !is_port_change;
+  if (resets_path_state) {
+    // [SD] Remember the state of the network we are leaving, in case we come
+    // back to it.
+    sent_packet_manager_.CachePathState(
+        GetNetworkId(default_path_.self_address.host()),
+        clock_->ApproximateNow());
+  }
   SetSelfAddress(self_address);
   UpdatePeerAddress(peer_address);
   SetQuicPacketWriter(writer, owns_writer);
   MaybeClearQueuedPacketsOnPathChange();
   OnSuccessfulMigration(is_port_change);
-  std::cout << "[quic_connection] Complete migration" << std::endl;
+  TraceHandoverEvent(HandoverTraceEvent::kMigrationComplete, 0, is_port_change);
+  if (resets_path_state &&
+      sent_packet_manager_.RestorePathState(GetNetworkId(self_address.host()),
+                                            clock_->ApproximateNow())) {
+    QUIC_DVLOG(1) << ENDPOINT << "Restored path state of "
+                  << GetNetworkId(self_address.host());
+  }
   // [SD] routing search timer init 0
-  hdt_alarm_->Cancel();
-  rlt_alarm_->Cancel();
-  rlt_deadline_alarm_->Cancel();
+  if (handover_ != nullptr) {
+    handover_->CancelAlarms();
+    handover_->detector()->ResetSamples();
+  }
   //InitTimerLookup();
   
   // if(pending_packet_ != NULL) {
@@ -7458,18 +7601,10 @@ bool QuicConnection::MigratePath(const QuicSocketAddress& self_address,
   //     WriteQueuedPackets()
   // }
 
-  // while(!pending_packets_.empty()) {
-  //   std::cout << "[quic_connection] Maybe send pending retransmittable frames because of handover" << std::endl;
-  //   SerializedPacket* packet = pending_packets_.back();
-  //   //buffered_packets_.emplace_back(*packet, self_address, peer_address);
-  //   for(unsigned long i=0; i<packet->retransmittable_frames.size(); i++) {
-  //     std::cout << packet->retransmittable_frames[i].type << std::endl; 
-  //     packet_creator_.AddFrame(packet->retransmittable_frames[i], RTO_RETRANSMISSION);
-  //   }
-  //   pending_packets_.pop_back();
-  // }
   WriteQueuedPackets();
-  framer_.cm_state_ = cm_state_ = true;
+  // [SD] Resend what was dropped on the unreachable path.
+  ReplayHandoverFrames();
+  cm_state_ = true;
   return true;
 }
 
@@ -7742,12 +7877,6 @@ void QuicConnection::ReversePathValidationResultDelegate::
     QUIC_CODE_COUNT_N(quic_kick_off_client_address_validation, 6, 6);
     connection_->alternative_path_.Clear();
   }
-
-  // [SD] fail path validation after network is unreachable error
-  if(connection_->IsNetworkUnreachable()) {
-    std::cout << "[quic_connection] Fail path validation after network is unreachable" << std::endl;
-    connection_->OnWriteError(101);
-  }
 }
 
 QuicConnection::ScopedRetransmissionTimeoutIndicator::
@@ -7818,5 +7947,34 @@ QuicConnection::OnPeerIpAddressChanged() {
   return old_send_algorithm;
 }
 
+void QuicConnection::MaybeStartSecondaryPath(const PathState& path) {
+  if (!enable_multipath_ || perspective_ != Perspective::IS_SERVER ||
+      !path.validated || !path.peer_address.IsInitialized() ||
+      path.self_address != default_path_.self_address ||
+      path.peer_address.host() == default_path_.peer_address.host()) {
+    return;
+  }
+  // StartEffectivePeerMigration() cached the state of the path under the
+  // peer host before resetting the congestion controller.
+  if (!sent_packet_manager_.StartSecondaryPath(
+          path.peer_address.host().ToString(), clock_->ApproximateNow())) {
+    return;
+  }
+  secondary_peer_address_ = path.peer_address;
+  QUIC_DLOG(INFO) << ENDPOINT << "Keep sending on " << path.peer_address
+                  << " next to " << default_path_.peer_address;
+}
+
+bool QuicConnection::ShouldSendOnSecondaryPath(
+    const SerializedPacket& packet) {
+  if (!sent_packet_manager_.HasSecondaryPath() ||
+      packet.encryption_level != ENCRYPTION_FORWARD_SECURE ||
+      IsRetransmittable(packet) != HAS_RETRANSMITTABLE_DATA) {
+    return false;
+  }
+  return sent_packet_manager_.ShouldSendOnSecondaryPath(
+      clock_->ApproximateNow());
+}
+
 #undef ENDPOINT  // undef for jumbo builds
 }  // namespace quic
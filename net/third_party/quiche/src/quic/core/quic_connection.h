@@ -42,6 +42,8 @@
 #include "quic/core/quic_connection_stats.h"
 #include "quic/core/quic_constants.h"
 #include "quic/core/quic_framer.h"
+#include "quic/core/quic_handover_controller.h"
+#include "quic/core/quic_handover_trace.h"
 #include "quic/core/quic_idle_network_detector.h"
 #include "quic/core/quic_mtu_discovery.h"
 #include "quic/core/quic_network_blackhole_detector.h"
@@ -78,6 +80,13 @@ class QUIC_EXPORT_PRIVATE QuicClientBaseVisitorInterface {
     
     // Called when network was unreachable.
     virtual int OnNetworkUnreachable() = 0;
+
+    // [SD] Returns the default gateway of the network |self_host| is on, or
+    // an uninitialized address if it is not known.
+    virtual QuicIpAddress GetNetworkGateway(
+        const QuicIpAddress& /*self_host*/) const {
+      return QuicIpAddress();
+    }
 };
 
 
@@ -652,84 +661,132 @@ class QUIC_EXPORT_PRIVATE QuicConnection
 
 
   void SetFastTimer() {
-    if(!hdt_alarm_->IsSet()) {
+    HandoverController* handover = GetOrCreateHandoverController();
+    if(!handover->hdt_alarm()->IsSet()) {
       //std::cout << "[quic_connection] Set fast rt search alarm because fast timer is expired " << std::endl;
-      hdt_alarm_->Set(clock_->ApproximateNow() + sent_packet_manager_.GetPtoDelay()*3);
+      handover->detector()->OnActivity(clock_->ApproximateNow());
+      ArmHandoverDetection();
     }
   }
 
+  // [SD] The alarm itself may still be set to an earlier deadline, it is moved
+  // when it fires.
   QuicTime HDTDeadline() {
-    return hdt_alarm_->deadline();
+    if (!IsSetHDT()) {
+      return QuicTime::Zero();
+    }
+    return handover_->detector().last_activity_time() +
+           GetHandoverDetectionDelay();
   }
 
   bool IsSetHDT() {
-    return hdt_alarm_->IsSet();
+    return handover_ != nullptr && handover_->hdt_alarm()->IsSet();
   }
 
   void BoomHDT() {
-    if(hdt_alarm_->IsSet()) {
-      hdt_alarm_->Cancel();
+    HandoverController* handover = GetOrCreateHandoverController();
+    if(handover->hdt_alarm()->IsSet()) {
+      handover->hdt_alarm()->Cancel();
     }
-    hdt_alarm_->Set(NowTime());
+    handover->detector()->Expire();
+    handover->hdt_alarm()->Set(NowTime());
   }
   
+  bool IsSetRLT() {
+    return handover_ != nullptr && handover_->rlt_alarm()->IsSet();
+  }
+
   bool IsPCHDT() {
-    return hdt_alarm_->IsPermanentlyCancelled();
+    return handover_ != nullptr &&
+           handover_->hdt_alarm()->IsPermanentlyCancelled();
   }
 
   QuicTime NowTime() {
     return clock_->ApproximateNow();
   }
 
+  // [SD] Routing table lookup interval in msec.
+  void SetRltInterval(uint64_t rlt_interval_ms) {
+    GetOrCreateHandoverController()->set_rlt_interval_ms(rlt_interval_ms);
+  }
 
-  uint64_t rlt_interval_; 
   // [SD] timestamp
   uint64_t timeStamp();
 
   bool IsDouteStateNetworkUnreachable() {
-    return doute_network_unreachable_;
+    return handover_ != nullptr && handover_->doubts_network_unreachable();
   }
 
   void DouteNetworkIsUnreachable() {
-    doute_network_unreachable_ = true;
+    GetOrCreateHandoverController()->set_doubts_network_unreachable();
   }
 
+  // [SD] Handover timestamps in milliseconds of the connection's clock. Zero
+  // without a handover controller.
   uint64_t GetHandoverZeroRTT() {
-    return first_rcv_;
+    if (handover_ == nullptr) {
+      return 0;
+    }
+    return (handover_->first_receive_time() - QuicTime::Zero())
+        .ToMilliseconds();
   }
 
-  // [SD] Set ho_start_ value
   uint64_t GetHandoverDelay() {
-    return ho_delay_;
+    if (handover_ == nullptr) {
+      return 0;
+    }
+    return handover_->handover_delay().ToMilliseconds();
   }
 
   uint64_t GetHandoverStart() {
-    return ho_start_;
+    if (handover_ == nullptr) {
+      return 0;
+    }
+    return (handover_->handover_start_time() - QuicTime::Zero())
+        .ToMilliseconds();
   }
 
+  // [SD] Time since the last STREAM frame on the current path.
+  QuicTime::Delta GetTimeSinceHandoverStart() {
+    if (handover_ == nullptr) {
+      return QuicTime::Delta::Zero();
+    }
+    return clock_->ApproximateNow() - handover_->handover_start_time();
+  }
+
+  // [SD] Records |event| of this connection in the handover trace, if tracing
+  // is enabled.
+  void TraceHandoverEvent(HandoverTraceEvent event,
+                          int64_t value = 0,
+                          uint32_t arg = 0) {
+    HandoverTracer* tracer = HandoverTracer::Get();
+    if (tracer->enabled()) {
+      tracer->Record(event, clock_->ApproximateNow(), trace_id_, perspective_,
+                     value, arg);
+    }
+  }
+
+  // [SD] Identifies this connection in the handover trace and the transport
+  // metrics, stable across connection ID changes.
+  uint64_t trace_id() const { return trace_id_; }
+
   int64_t GetBandwidth() {
     return bw_;
   }
 
+  // [SD] Allocates the handover controller on clients, and starts the
+  // handover measurements over.
   void InitHandoverValue() {
-    first_rcv_ = 0;
-    ho_start_ = 0;
-    ho_delay_ = 0;
-    first_try = true;
-    ho_state_ = false;
     cm_state_ = false;
-    active_cm_ = false;
-    watcher_ = false;
-    network_unreachable_ = false;
-    searching_deadline = 0;
+    GetOrCreateHandoverController()->Reset();
   }
 
   void SetHandoverState(bool ho_state) {
-    ho_state_ = ho_state;
+    GetOrCreateHandoverController()->set_handover_state(ho_state);
   }
 
   bool GetHandoverState() {
-    return ho_state_;
+    return handover_ != nullptr && handover_->handover_state();
   }
 
   void SetMigrationState(bool cm_state) {
@@ -740,35 +797,66 @@ class QUIC_EXPORT_PRIVATE QuicConnection
     return cm_state_;
   }
 
-  void SetStartPsn(uint64_t start_psn) {
-    framer_.start_psn_ = start_psn;
-  }
-
-  void SetStartTimeFramer(uint64_t start_time) {
-    framer_.start_time_ = start_time;
-  }
-
   void SetWatcherOn(bool watcher) {
-    watcher_ = watcher;
+    GetOrCreateHandoverController()->set_watcher(watcher);
   }
 
   void SetActiveCM(bool active_cm) {
-    active_cm_ = active_cm;
+    if (active_cm || handover_ != nullptr) {
+      GetOrCreateHandoverController()->set_active_cm(active_cm);
+    }
   }
 
-  bool IsNetworkUnreachable() {
-    return network_unreachable_;
+  bool IsActiveCM() {
+    return handover_ != nullptr && handover_->active_cm();
   }
 
+  // [SD] Null unless InitHandoverValue() or another handover setter was
+  // called on a client connection.
+  HandoverController* handover_controller() { return handover_.get(); }
+
   int mquic_cwnd_size = 0;
-  int tlu_ex_factor;
-  int init_lookup_interval;
-  int counting_rt = 0;
-  int sent_ack_num = 0;
+
+  // [SD] If set on a server, the validated path a client migrates away from
+  // keeps carrying data next to the new one until it degrades, see
+  // QuicSentPacketManager::StartSecondaryPath().
+  void set_enable_multipath(bool enable_multipath) {
+    enable_multipath_ = enable_multipath;
+  }
+
+  // [SD] Number of routing table lookups and of ACK flushes before the first
+  // handover.
+  int GetLookupCount() const {
+    return handover_ == nullptr ? 0 : handover_->num_lookups();
+  }
+  int GetSentAckCount() const {
+    return handover_ == nullptr ? 0 : handover_->num_acks_sent();
+  }
 
   void UpdateRLT();
   void CancelRLT();
 
+  // [SD] Arms the RLT alarm to look up the route as soon as possible, but no
+  // sooner than an RLT interval after the last lookup, and its deadline.
+  void ScheduleRouteLookup();
+
+  // [SD] Time without sent or received packets after which the HDT alarm
+  // looks for a handover.
+  QuicTime::Delta GetHandoverDetectionDelay() const;
+
+  // [SD] Called when the HDT alarm fires. If packets were seen since it was
+  // set, sets it to the new deadline and returns true.
+  bool MaybeRearmHandoverDetection();
+
+  // [SD] Marks the buffered handover frames that are still outstanding as lost
+  // so that the session resends them, and writes them out if possible.
+  void ReplayHandoverFrames();
+
+  // [SD] Called when the path turns out to be fine, i.e. the lookup finds the
+  // route unchanged or a packet arrives. Stops the routing table lookup and
+  // its deadline, and resends the frames buffered in the meantime.
+  void OnPathAlive();
+
   // From QuicFramerVisitorInterface
   void OnError(QuicFramer* framer) override;
   bool OnProtocolVersionMismatch(ParsedQuicVersion received_version) override;
@@ -887,7 +975,9 @@ class QUIC_EXPORT_PRIVATE QuicConnection
   }
 
   int OnNetworkUnrearchable() {
-    counting_rt++;
+    if (handover_ != nullptr) {
+      handover_->OnLookup(clock_->ApproximateNow());
+    }
     return cb_visitor_->OnNetworkUnreachable();
   }
 
@@ -2187,11 +2277,6 @@ class QUIC_EXPORT_PRIVATE QuicConnection
   // TLS handshaker.
   QuicArenaScopedPtr<QuicAlarm> discard_zero_rtt_decryption_keys_alarm_;
 
-  // An alarm that find new path
-  QuicArenaScopedPtr<QuicAlarm> hdt_alarm_;
-  QuicArenaScopedPtr<QuicAlarm> rlt_alarm_;
-  QuicArenaScopedPtr<QuicAlarm> rlt_deadline_alarm_;
-
   // Neither visitor is owned by this class.
   QuicConnectionVisitorInterface* visitor_;
   QuicConnectionDebugVisitor* debug_visitor_;
@@ -2452,27 +2537,48 @@ class QUIC_EXPORT_PRIVATE QuicConnection
   absl::optional<QuicWallTime> quic_bug_10511_43_timestamp_;
   std::string quic_bug_10511_43_error_detail_;
 
-  // [SD] To measure handover delay
-  uint64_t first_rcv_ = 0;
-  uint64_t ho_start_ = 0;
-  uint64_t ho_delay_ = 0;
+  // [SD] When the last PATH_CHALLENGE was sent.
+  QuicTime path_challenge_sent_time_ = QuicTime::Zero();
+  // Identifies this connection in the handover trace.
+  uint64_t trace_id_ = 0;
   uint64_t preAck;
-  bool first_try = true;
-  bool ho_state_ = false;
   bool cm_state_ = false;
-  bool active_cm_ = false;
-  bool watcher_ = false;
-  bool network_unreachable_ = false;
-  bool measure_one = false;
-  uint64_t searching_deadline = 0;
   int64_t bw_ = 0;
   double pre_bw_ = 0;
   uint64_t maxWindow, maxRet;
   bool window_flag = true;
-  bool doute_network_unreachable_ = false;
 
+  // [SD] Handover detection, routing table lookup and the frames lost to an
+  // unreachable network. Only allocated on clients, see
+  // GetOrCreateHandoverController().
+  std::unique_ptr<HandoverController> handover_;
+
+  // Not owned. Set by SetSessionNotifier().
+  SessionNotifierInterface* session_notifier_ = nullptr;
+
+  // [SD] Returns the key of the network |self_host| is on in the path state
+  // cache: the host followed by its gateway, if the client base knows it.
+  std::string GetNetworkId(const QuicIpAddress& self_host) const;
+
+  // [SD] Allocates the handover controller and its alarms on first use.
+  HandoverController* GetOrCreateHandoverController();
+
+  // [SD] Sets the HDT alarm, which must not be set, to the current detection
+  // deadline.
+  void ArmHandoverDetection();
+
+  // [SD] Keeps sending on |path|, a path the peer left, if multipath is
+  // enabled and |path| is validated.
+  void MaybeStartSecondaryPath(const PathState& path);
+
+  // [SD] Returns true if |packet| should leave on the secondary path instead
+  // of the default one.
+  bool ShouldSendOnSecondaryPath(const SerializedPacket& packet);
 
-  std::vector<SerializedPacket*> pending_packets_;
+  bool enable_multipath_ = false;
+  // [SD] Peer address of the secondary path. Only meaningful while
+  // sent_packet_manager_ has one.
+  QuicSocketAddress secondary_peer_address_;
 };
 
 }  // namespace quic
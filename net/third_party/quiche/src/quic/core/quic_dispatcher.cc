@@ -446,6 +446,22 @@ QuicConnectionId QuicDispatcher::MaybeReplaceServerConnectionId(
     const QuicConnectionId& server_connection_id,
     const ParsedQuicVersion& version) const {
   const uint8_t server_connection_id_length = server_connection_id.length();
+  // [SD] In a multi-core server every connection ID the dispatcher picks
+  // starts with the ID of this worker.
+  if (worker_steering_ != nullptr &&
+      expected_server_connection_id_length_ > 0 &&
+      version.AllowsVariableLengthConnectionIds()) {
+    if (server_connection_id_length == expected_server_connection_id_length_ &&
+        QuicWorkerSteering::DecodeWorkerId(server_connection_id) ==
+            worker_id_) {
+      return server_connection_id;
+    }
+    QuicConnectionId new_connection_id =
+        QuicUtils::CreateReplacementConnectionId(
+            server_connection_id, expected_server_connection_id_length_);
+    QuicWorkerSteering::EncodeWorkerId(worker_id_, &new_connection_id);
+    return new_connection_id;
+  }
   if (server_connection_id_length == expected_server_connection_id_length_) {
     return server_connection_id;
   }
@@ -634,6 +650,10 @@ bool QuicDispatcher::MaybeDispatchPacket(
     return true;
   }
 
+  if (MaybeForwardToOwningWorker(packet_info)) {
+    return true;
+  }
+
   if (OnFailedToDispatchPacket(packet_info)) {
     return true;
   }
@@ -1065,6 +1085,9 @@ void QuicDispatcher::OnConnectionClosed(QuicConnectionId server_connection_id,
   for (const QuicConnectionId& cid :
        connection->GetActiveServerConnectionIds()) {
     reference_counted_session_map_.erase(cid);
+    if (worker_steering_ != nullptr) {
+      worker_steering_->Unregister(cid);
+    }
   }
   --num_sessions_in_session_map_;
 }
@@ -1105,11 +1128,22 @@ void QuicDispatcher::OnNewConnectionIdSent(
   auto insertion_result = reference_counted_session_map_.insert(
       std::make_pair(new_connection_id, it->second));
   QUICHE_DCHECK(insertion_result.second);
+  // [SD] The client switches to a new connection ID when it migrates, so
+  // other workers must be able to find the owner.
+  if (worker_steering_ != nullptr &&
+      !worker_steering_->Register(new_connection_id, worker_id_)) {
+    QUIC_LOG_FIRST_N(WARNING, 10)
+        << "Worker steering table full, " << new_connection_id
+        << " is steered by its first byte only";
+  }
 }
 
 void QuicDispatcher::OnConnectionIdRetired(
     const QuicConnectionId& server_connection_id) {
   reference_counted_session_map_.erase(server_connection_id);
+  if (worker_steering_ != nullptr) {
+    worker_steering_->Unregister(server_connection_id);
+  }
 }
 
 void QuicDispatcher::OnConnectionAddedToTimeWaitList(
@@ -1229,6 +1263,7 @@ void QuicDispatcher::ProcessBufferedChlos(size_t max_connections_to_create) {
           original_connection_id);
     }
     QUIC_DLOG(INFO) << "Created new session for " << server_connection_id;
+    session->connection()->set_enable_multipath(enable_multipath_);
 
     auto insertion_result = reference_counted_session_map_.insert(
         std::make_pair(server_connection_id,
@@ -1342,6 +1377,7 @@ void QuicDispatcher::ProcessChlo(ParsedClientHello parsed_chlo,
   // [SD] Measure Method
   if(cwnd_size_ > 0)
     session->connection()->mquic_cwnd_size = cwnd_size_;
+  session->connection()->set_enable_multipath(enable_multipath_);
 
   QuicSession* session_ptr;
   auto insertion_result = reference_counted_session_map_.insert(std::make_pair(
@@ -1377,6 +1413,53 @@ void QuicDispatcher::SetLastError(QuicErrorCode error) {
   last_error_ = error;
 }
 
+bool QuicDispatcher::MaybeForwardToOwningWorker(
+    const ReceivedPacketInfo& packet_info) {
+  // Long header packets belong to handshakes, which do not migrate and stay on
+  // the worker the kernel picked.
+  if (worker_steering_ == nullptr || processing_forwarded_packet_ ||
+      packet_info.form != IETF_QUIC_SHORT_HEADER_PACKET) {
+    return false;
+  }
+  const int owner =
+      worker_steering_->GetOwner(packet_info.destination_connection_id);
+  if (owner < 0 || owner == worker_id_) {
+    return false;
+  }
+  if (!worker_steering_->Forward(owner, packet_info.self_address,
+                                 packet_info.peer_address,
+                                 packet_info.packet)) {
+    QUIC_DLOG(INFO) << "Forwarding queue of worker " << owner
+                    << " full, dropping packet for "
+                    << packet_info.destination_connection_id;
+  }
+  return true;
+}
+
+void QuicDispatcher::ProcessForwardedPacket(
+    const QuicWorkerSteering::ForwardedPacket& packet) {
+  processing_forwarded_packet_ = true;
+  ProcessPacket(packet.self_address, packet.peer_address,
+                QuicReceivedPacket(packet.data, packet.length,
+                                   packet.receipt_time));
+  processing_forwarded_packet_ = false;
+}
+
+void QuicDispatcher::StartTransportMetrics(QuicTime::Delta interval) {
+  metrics_sampler_ = std::make_unique<QuicTransportMetricsSampler>(
+      this, helper_->GetClock(), alarm_factory_.get(), interval,
+      static_cast<uint8_t>(worker_id_));
+  metrics_sampler_->Start();
+}
+
+void QuicDispatcher::SampleConnections(QuicTransportMetricsSampler* sampler) {
+  PerformActionOnActiveSessions([sampler](QuicSession* session) {
+    if (session->connection()->connected()) {
+      sampler->Sample(session->connection());
+    }
+  });
+}
+
 bool QuicDispatcher::OnFailedToDispatchPacket(
     const ReceivedPacketInfo& /*packet_info*/) {
   return false;
@@ -26,7 +26,9 @@
 #include "quic/core/quic_process_packet_interface.h"
 #include "quic/core/quic_session.h"
 #include "quic/core/quic_time_wait_list_manager.h"
+#include "quic/core/quic_transport_metrics.h"
 #include "quic/core/quic_version_manager.h"
+#include "quic/core/quic_worker_steering.h"
 #include "quic/platform/api/quic_reference_counted.h"
 #include "quic/platform/api/quic_socket_address.h"
 #include "common/quiche_linked_hash_map.h"
@@ -42,7 +44,8 @@ class QuicCryptoServerConfig;
 class QUIC_NO_EXPORT QuicDispatcher
     : public QuicTimeWaitListManager::Visitor,
       public ProcessPacketInterface,
-      public QuicBufferedPacketStore::VisitorInterface {
+      public QuicBufferedPacketStore::VisitorInterface,
+      public QuicTransportMetricsSampler::Delegate {
  public:
   // Ideally we'd have a linked_hash_set: the  boolean is unused.
   using WriteBlockedList =
@@ -166,6 +169,32 @@ class QUIC_NO_EXPORT QuicDispatcher
 
   void SetMquicCwnd(int cwnd_size) { cwnd_size_ = cwnd_size; }
 
+  // [SD] Lets the connections of new sessions keep sending on the path a
+  // client migrates away from, see QuicConnection::set_enable_multipath().
+  void SetEnableMultipath(bool enable_multipath) {
+    enable_multipath_ = enable_multipath;
+  }
+
+  // [SD] Makes this dispatcher worker |worker_id| of a multi-core server.
+  // Server connection IDs it mints carry |worker_id|, and short header
+  // packets of connections owned by other workers are forwarded to them.
+  void SetWorkerSteering(QuicWorkerSteering* worker_steering, int worker_id) {
+    worker_steering_ = worker_steering;
+    worker_id_ = worker_id;
+  }
+
+  // [SD] Processes a packet forwarded by another worker. It is never
+  // forwarded again.
+  void ProcessForwardedPacket(
+      const QuicWorkerSteering::ForwardedPacket& packet);
+
+  // [SD] Samples the transport metrics of all sessions every |interval|,
+  // see QuicTransportMetricsSampler. Call after SetWorkerSteering().
+  void StartTransportMetrics(QuicTime::Delta interval);
+
+  // QuicTransportMetricsSampler::Delegate
+  void SampleConnections(QuicTransportMetricsSampler* sampler) override;
+
  protected:
   // Creates a QUIC session based on the given information.
   // |alpn| is the selected ALPN from |parsed_chlo.alpns|.
@@ -392,6 +421,10 @@ class QUIC_NO_EXPORT QuicDispatcher
   absl::optional<ParsedClientHello> TryExtractChloOrBufferEarlyPacket(
       const ReceivedPacketInfo& packet_info);
 
+  // [SD] Forwards |packet_info| to the worker that owns its connection ID.
+  // Returns false if the packet should be processed by this dispatcher.
+  bool MaybeForwardToOwningWorker(const ReceivedPacketInfo& packet_info);
+
   // Deliver |packets| to |session| for further processing.
   void DeliverPacketsToSession(
       const std::list<QuicBufferedPacketStore::BufferedPacket>& packets,
@@ -481,6 +514,16 @@ class QUIC_NO_EXPORT QuicDispatcher
   bool should_update_expected_server_connection_id_length_;
 
   int cwnd_size_ = 0;
+  bool enable_multipath_ = false;
+
+  // [SD] Set in multi-core servers, not owned.
+  QuicWorkerSteering* worker_steering_ = nullptr;
+  int worker_id_ = 0;
+  // True while a packet forwarded by another worker is processed.
+  bool processing_forwarded_packet_ = false;
+
+  // [SD] Set by StartTransportMetrics().
+  std::unique_ptr<QuicTransportMetricsSampler> metrics_sampler_;
 
   const bool use_recent_reset_addresses_ =
       GetQuicRestartFlag(quic_use_recent_reset_addresses);
@@ -11,7 +11,6 @@
 #include <string>
 #include <utility>
 #include <iostream>
-#include <fstream>
 
 #include "absl/base/attributes.h"
 #include "absl/base/macros.h"
@@ -5848,9 +5847,6 @@ bool QuicFramer::AppendStopWaitingFrame(const QuicPacketHeader& header,
   return true;
 }
 
-uint64_t my_gap, track_gap, before_gap;
-uint64_t mul_index;
-uint64_t my_la;
 bool QuicFramer::AppendIetfAckFrameAndTypeByte(const QuicAckFrame& frame,
                                                QuicDataWriter* writer) {
   uint8_t type = IETF_ACK;
@@ -5918,32 +5914,22 @@ bool QuicFramer::AppendIetfAckFrameAndTypeByte(const QuicAckFrame& frame,
     //std::cout << "[quic_framer] la: " << largest_acked << " psa: " << previous_smallest << " gap: " << gap << " ack_range: " << ack_range << std::endl; 
     //std::cout << " gap: " << gap << " ack_range: " << ack_range;
     // if(gap > 0) {
-    //   if(largest_acked.ToUint64() > my_la) {
-    //       if(gap != my_gap)
+    //   if(largest_acked.ToUint64() > my_la_) {
+    //       if(gap != my_gap_)
     //         //std::cout << "[quic_framer] [" << largest_acked << "] Gap is " << gap << " Ack Range: " << ack_range << std::endl;
     //         //std::cout << "[quic_framer] la: " << largest_acked << " psa: " << previous_smallest << " gap: " << gap << " ack_range: " << ack_range << std::endl; 
-    //       if(gap > 50 && my_gap < gap) {
+    //       if(gap > 50 && my_gap_ < gap) {
     //         std::fstream my_writer;
     //         my_writer.open("ho_loss.txt", std::ios::app);
     //         my_writer << start_psn_ << '\t' << largest_acked << '\t' << gap << std::endl;
     //         my_writer.close();
     //       }
     //   }
-    //   if(my_gap < gap)
-    //     my_gap = gap;
+    //   if(my_gap_ < gap)
+    //     my_gap_ = gap;
     // }
 
-    if(cm_state_ && largest_acked.ToUint64() > my_la && gap > 0) {
-        std::fstream my_writer;
-        my_writer.open("ho_loss.txt", std::ios::app);
-        //my_writer << start_psn_ << '\t' << largest_acked << '\t' << gap << std::endl;
-        my_writer << gap << std::endl;
-        my_writer.close();
-        cm_state_ = false;
-    }
-
-    //track_gap += gap;
-    my_la = largest_acked.ToUint64();
+    //track_gap_ += gap;
 
     if (writer->remaining() < ecn_size ||
         writer->remaining() - ecn_size <
@@ -5964,18 +5950,18 @@ bool QuicFramer::AppendIetfAckFrameAndTypeByte(const QuicAckFrame& frame,
   // std::fstream t_writer;
   // t_writer.open("ho_gap_track.txt", std::ios::app);
 
-  // if(largest_acked.ToUint64() > mul_index*500) {
-  //   t_writer << largest_acked << '\t' << track_gap << std::endl;
-  //   mul_index++;
+  // if(largest_acked.ToUint64() > mul_index_*500) {
+  //   t_writer << largest_acked << '\t' << track_gap_ << std::endl;
+  //   mul_index_++;
   // }
 
-  // if(before_gap != track_gap) {
-  //   t_writer << largest_acked << '\t' << track_gap << std::endl;
-  //   before_gap = track_gap;
+  // if(before_gap_ != track_gap_) {
+  //   t_writer << largest_acked << '\t' << track_gap_ << std::endl;
+  //   before_gap_ = track_gap_;
   // }
 
   // t_writer.close();
-  // track_gap = 0;
+  // track_gap_ = 0;
 
   if (appended_ack_blocks < ack_block_count) {
     // Truncation is needed, rewrite the ack block count.
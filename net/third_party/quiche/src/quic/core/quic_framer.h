@@ -527,11 +527,6 @@ class QUIC_EXPORT_PRIVATE QuicFramer {
   bool AppendAckFrequencyFrame(const QuicAckFrequencyFrame& frame,
                                QuicDataWriter* writer);
 
-  // [SD] start psn
-  uint64_t start_psn_;
-  uint64_t start_time_;
-  bool cm_state_ = false;
-
   // SetDecrypter sets the primary decrypter, replacing any that already exists.
   // If an alternative decrypter is in place then the function QUICHE_DCHECKs.
   // This is intended for cases where one knows that future packets will be
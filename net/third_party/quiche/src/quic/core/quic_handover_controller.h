@@ -0,0 +1,259 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef QUICHE_QUIC_CORE_QUIC_HANDOVER_CONTROLLER_H_
+#define QUICHE_QUIC_CORE_QUIC_HANDOVER_CONTROLLER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "quic/core/frames/quic_frame.h"
+#include "quic/core/quic_alarm.h"
+#include "quic/core/quic_buffer_allocator.h"
+#include "quic/core/quic_handover_detector.h"
+#include "quic/core/quic_packets.h"
+#include "quic/core/quic_time.h"
+#include "quic/platform/api/quic_export.h"
+#include "quic/platform/api/quic_ip_address.h"
+#include "quic/platform/api/quic_logging.h"
+#include "quic/platform/api/quic_socket_address.h"
+#include "common/quiche_circular_deque.h"
+
+namespace quic {
+
+// [SD] Number of frames kept while the network is unreachable beyond which
+// the connection stops sending new data. None is dropped: the packets failed
+// before reaching the sent packet manager, so nothing else would retransmit
+// them.
+const size_t kMaxHandoverFrames = 256;
+
+// [SD] Client-side handover state of a QuicConnection: the handover detection
+// (HDT), routing table lookup (RLT) and RLT deadline alarms, the frames that
+// could not be written while the network was unreachable and the handover
+// delay measurements.
+//
+// The connection only allocates it for clients that opt into mQUIC handover
+// handling, so server connections carry a null pointer instead of this state
+// and its alarms.
+class QUIC_EXPORT_PRIVATE HandoverController {
+ public:
+  // Takes ownership of the alarms.
+  HandoverController(QuicAlarm* hdt_alarm,
+                     QuicAlarm* rlt_alarm,
+                     QuicAlarm* rlt_deadline_alarm)
+      : hdt_alarm_(hdt_alarm),
+        rlt_alarm_(rlt_alarm),
+        rlt_deadline_alarm_(rlt_deadline_alarm) {}
+
+  HandoverController(const HandoverController&) = delete;
+  HandoverController& operator=(const HandoverController&) = delete;
+
+  ~HandoverController() { ClearHandoverFrames(); }
+
+  // Starts the measurements over, e.g. before a new request.
+  void Reset() {
+    first_receive_time_ = QuicTime::Zero();
+    handover_start_time_ = QuicTime::Zero();
+    handover_delay_ = QuicTime::Delta::Zero();
+    stream_self_address_ = QuicSocketAddress();
+    handover_state_ = false;
+    active_cm_ = false;
+    watcher_ = false;
+  }
+
+  // Called for every STREAM frame, received on |self_address|. Returns true
+  // if it is the first one on a new local address, handover_delay() is then
+  // the time since the last one on the previous address.
+  bool OnStreamFrame(QuicTime now, const QuicSocketAddress& self_address) {
+    if (!first_receive_time_.IsInitialized()) {
+      stream_self_address_ = self_address;
+      first_receive_time_ = now;
+    }
+    if (stream_self_address_.host() == self_address.host()) {
+      handover_start_time_ = now;
+      return false;
+    }
+    handover_delay_ = now - handover_start_time_;
+    stream_self_address_ = self_address;
+    return true;
+  }
+
+  // Keeps the retransmittable frames of |packet|, which could not be written
+  // because the network is unreachable. Data is copied with |allocator|.
+  void BufferHandoverFrames(const SerializedPacket& packet,
+                            QuicBufferAllocator* allocator) {
+    for (const QuicFrame& frame : packet.retransmittable_frames) {
+      if (MergeIntoBufferedFrame(frame)) {
+        continue;
+      }
+      handover_frames_.push_back(CopyQuicFrame(allocator, frame));
+    }
+    if (handover_frames_full()) {
+      QUIC_LOG_FIRST_N(WARNING, 10)
+          << "Handover send queue is full, holding back new data";
+    }
+  }
+
+  const QuicheCircularDeque<QuicFrame>& handover_frames() const {
+    return handover_frames_;
+  }
+
+  // True once kMaxHandoverFrames are buffered. The connection then sends no
+  // new retransmittable data until the frames are handed back to the session.
+  bool handover_frames_full() const {
+    return handover_frames_.size() >= kMaxHandoverFrames;
+  }
+
+  // Frees the buffered handover frames.
+  void ClearHandoverFrames() {
+    for (QuicFrame& frame : handover_frames_) {
+      DeleteFrame(&frame);
+    }
+    handover_frames_.clear();
+  }
+
+  // Cancels the RLT and its deadline.
+  void CancelRLT() {
+    rlt_alarm_->Cancel();
+    rlt_deadline_alarm_->Cancel();
+  }
+
+  // Cancels all alarms, e.g. after a migration.
+  void CancelAlarms() {
+    hdt_alarm_->Cancel();
+    CancelRLT();
+  }
+
+  // Called when the connection closes.
+  void PermanentCancelAlarms() {
+    hdt_alarm_->PermanentCancel();
+    rlt_alarm_->PermanentCancel();
+    rlt_deadline_alarm_->PermanentCancel();
+  }
+
+  QuicAlarm* hdt_alarm() { return hdt_alarm_.get(); }
+  QuicAlarm* rlt_alarm() { return rlt_alarm_.get(); }
+  QuicAlarm* rlt_deadline_alarm() { return rlt_deadline_alarm_.get(); }
+
+  QuicHandoverDetector* detector() { return &detector_; }
+  const QuicHandoverDetector& detector() const { return detector_; }
+
+  // Time of the first STREAM frame since Reset().
+  QuicTime first_receive_time() const { return first_receive_time_; }
+  // Time of the last STREAM frame on the current local address.
+  QuicTime handover_start_time() const { return handover_start_time_; }
+  QuicTime::Delta handover_delay() const { return handover_delay_; }
+
+  bool active_cm() const { return active_cm_; }
+  void set_active_cm(bool active_cm) { active_cm_ = active_cm; }
+
+  // While set, ENETUNREACH write errors are ignored.
+  bool watcher() const { return watcher_; }
+  void set_watcher(bool watcher) { watcher_ = watcher; }
+
+  // Set once the peer issued a connection ID for the next migration.
+  bool handover_state() const { return handover_state_; }
+  void set_handover_state(bool handover_state) {
+    handover_state_ = handover_state;
+  }
+
+  uint64_t rlt_interval_ms() const { return rlt_interval_ms_; }
+  void set_rlt_interval_ms(uint64_t rlt_interval_ms) {
+    rlt_interval_ms_ = rlt_interval_ms;
+  }
+
+  // Number of routing table lookups, and the time of the last one.
+  int num_lookups() const { return num_lookups_; }
+  QuicTime last_lookup_time() const { return last_lookup_time_; }
+  void OnLookup(QuicTime now) {
+    ++num_lookups_;
+    last_lookup_time_ = now;
+  }
+
+  // Number of ACK-only flushes before the first handover.
+  int num_acks_sent() const { return num_acks_sent_; }
+  void OnAcksSent() {
+    if (handover_delay_.IsZero()) {
+      ++num_acks_sent_;
+    }
+  }
+
+  bool doubts_network_unreachable() const {
+    return doubts_network_unreachable_;
+  }
+  void set_doubts_network_unreachable() { doubts_network_unreachable_ = true; }
+
+ private:
+  // Folds |frame| into a buffered frame that already covers it, e.g. the
+  // retransmission of data that already failed once. Returns true if it did.
+  bool MergeIntoBufferedFrame(const QuicFrame& frame) {
+    for (QuicFrame& pending : handover_frames_) {
+      if (frame.type != pending.type) {
+        continue;
+      }
+      if (frame.type == STREAM_FRAME) {
+        // Fold overlapping or adjacent ranges of the same stream.
+        QuicStreamFrame& stream_frame = pending.stream_frame;
+        if (stream_frame.stream_id != frame.stream_frame.stream_id ||
+            frame.stream_frame.offset < stream_frame.offset ||
+            frame.stream_frame.offset >
+                stream_frame.offset + stream_frame.data_length) {
+          continue;
+        }
+        const QuicStreamOffset end =
+            std::max(stream_frame.offset + stream_frame.data_length,
+                     frame.stream_frame.offset + frame.stream_frame.data_length);
+        if (end - stream_frame.offset >
+            std::numeric_limits<QuicPacketLength>::max()) {
+          continue;
+        }
+        stream_frame.data_length =
+            static_cast<QuicPacketLength>(end - stream_frame.offset);
+        stream_frame.fin |= frame.stream_frame.fin;
+        return true;
+      }
+      if (IsControlFrame(frame.type) &&
+          GetControlFrameId(frame) == GetControlFrameId(pending)) {
+        // Same control frame sent again.
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::unique_ptr<QuicAlarm> hdt_alarm_;
+  std::unique_ptr<QuicAlarm> rlt_alarm_;
+  std::unique_ptr<QuicAlarm> rlt_deadline_alarm_;
+  // Packet times behind hdt_alarm_.
+  QuicHandoverDetector detector_;
+
+  // Retransmittable frames of packets that failed with ENETUNREACH. They
+  // never reach the sent packet manager, so the connection hands them back to
+  // the session as lost after migrating, to be resent on the new path.
+  QuicheCircularDeque<QuicFrame> handover_frames_;
+
+  QuicTime first_receive_time_ = QuicTime::Zero();
+  QuicTime handover_start_time_ = QuicTime::Zero();
+  QuicTime::Delta handover_delay_ = QuicTime::Delta::Zero();
+  QuicTime last_lookup_time_ = QuicTime::Zero();
+  // Local address the last STREAM frame was received on.
+  QuicSocketAddress stream_self_address_;
+  uint64_t rlt_interval_ms_ = 10;
+  int num_lookups_ = 0;
+  int num_acks_sent_ = 0;
+  bool handover_state_ = false;
+  bool active_cm_ = false;
+  bool watcher_ = false;
+  bool doubts_network_unreachable_ = false;
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_CORE_QUIC_HANDOVER_CONTROLLER_H_
@@ -0,0 +1,126 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef QUICHE_QUIC_CORE_QUIC_HANDOVER_DETECTOR_H_
+#define QUICHE_QUIC_CORE_QUIC_HANDOVER_DETECTOR_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "quic/core/quic_time.h"
+#include "quic/platform/api/quic_export.h"
+
+namespace quic {
+
+// [SD] Number of inter-arrival samples needed before the detection delay
+// follows the observed packet gaps instead of 3 * PTO.
+const int kHandoverDetectionMinSamples = 16;
+
+// [SD] Shortest inter-arrival gap taken for a pause of the peer, so that a
+// scheduling hiccup on a very fast link does not discard samples.
+const int64_t kHandoverDetectionMinPauseUs = 10000;
+
+// [SD] Keeps the state behind the handover detection timer (HDT). Each sent or
+// received packet only records its time here. The HDT alarm is not moved per
+// packet: when it fires, the connection asks for the deadline again and
+// re-arms the alarm if packets were seen in the meantime.
+//
+// While the peer keeps sending, the detection delay is derived from the
+// smoothed packet inter-arrival time and its deviation, the way RttStats
+// smooths RTT samples, so that a handover is detected between PTO and
+// 3 * PTO. A pause of the peer halves the sample count, so the delay falls
+// back to 3 * PTO once the stream has stopped for a while.
+class QUIC_EXPORT_PRIVATE QuicHandoverDetector {
+ public:
+  QuicHandoverDetector()
+      : last_activity_time_(QuicTime::Zero()),
+        last_receive_time_(QuicTime::Zero()),
+        smoothed_gap_us_(0),
+        mean_deviation_us_(0),
+        num_samples_(0) {}
+
+  QuicHandoverDetector(const QuicHandoverDetector&) = delete;
+  QuicHandoverDetector& operator=(const QuicHandoverDetector&) = delete;
+
+  // Called for each received packet.
+  void OnPacketReceived(QuicTime now) {
+    if (last_receive_time_.IsInitialized()) {
+      const int64_t gap_us = (now - last_receive_time_).ToMicroseconds();
+      if (num_samples_ == 0) {
+        smoothed_gap_us_ = gap_us;
+        mean_deviation_us_ = gap_us / 2;
+        ++num_samples_;
+      } else if (gap_us > kHandoverDetectionMinPauseUs &&
+                 gap_us > smoothed_gap_us_ + 4 * mean_deviation_us_) {
+        // The peer paused, e.g. between two requests. The gap is not a
+        // sample of the stream, and the older samples say less about the
+        // next one.
+        num_samples_ /= 2;
+      } else {
+        mean_deviation_us_ =
+            (3 * mean_deviation_us_ + std::abs(smoothed_gap_us_ - gap_us)) / 4;
+        smoothed_gap_us_ = (7 * smoothed_gap_us_ + gap_us) / 8;
+        if (num_samples_ < kHandoverDetectionMinSamples) {
+          ++num_samples_;
+        }
+      }
+    }
+    last_receive_time_ = now;
+    last_activity_time_ = now;
+  }
+
+  // Called for each sent packet, and whenever detection should start over
+  // from |now|.
+  void OnActivity(QuicTime now) { last_activity_time_ = now; }
+
+  // Returns the time without packets after which a handover is assumed.
+  // |steady_stream| tells whether the peer may keep sending, e.g. because
+  // streams are open; otherwise the gaps say nothing about the path. The
+  // delay only adapts while packets are actually arriving, and never drops
+  // below |pto_delay|, since a sender may pause that long waiting for acks.
+  QuicTime::Delta GetDetectionDelay(QuicTime::Delta pto_delay,
+                                    bool steady_stream) const {
+    const QuicTime::Delta max_delay = pto_delay * 3;
+    if (!steady_stream || num_samples_ < kHandoverDetectionMinSamples) {
+      return max_delay;
+    }
+    const QuicTime::Delta delay = std::max(
+        QuicTime::Delta::FromMicroseconds(smoothed_gap_us_ +
+                                          4 * mean_deviation_us_),
+        pto_delay);
+    // Recent activity that was not a receipt, e.g. a request sent after an
+    // idle period, says nothing about the gaps of the stream.
+    if (last_receive_time_ + delay < last_activity_time_) {
+      return max_delay;
+    }
+    return std::min(delay, max_delay);
+  }
+
+  // Forgets the inter-arrival samples, e.g. after a migration to a path with
+  // different timing.
+  void ResetSamples() {
+    last_receive_time_ = QuicTime::Zero();
+    smoothed_gap_us_ = 0;
+    mean_deviation_us_ = 0;
+    num_samples_ = 0;
+  }
+
+  // Makes the next deadline check report that the deadline has passed.
+  void Expire() { last_activity_time_ = QuicTime::Zero(); }
+
+  QuicTime last_activity_time() const { return last_activity_time_; }
+
+ private:
+  // Last time a packet was sent or received.
+  QuicTime last_activity_time_;
+  QuicTime last_receive_time_;
+  int64_t smoothed_gap_us_;
+  int64_t mean_deviation_us_;
+  int num_samples_;
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_CORE_QUIC_HANDOVER_DETECTOR_H_
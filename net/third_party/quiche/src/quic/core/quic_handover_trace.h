@@ -0,0 +1,298 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef QUICHE_QUIC_CORE_QUIC_HANDOVER_TRACE_H_
+#define QUICHE_QUIC_CORE_QUIC_HANDOVER_TRACE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "quic/core/quic_time.h"
+#include "quic/core/quic_types.h"
+#include "quic/platform/api/quic_export.h"
+
+namespace quic {
+
+// [SD] Events of the handover trace. Values are part of the file format, only
+// append new ones.
+enum class HandoverTraceEvent : uint8_t {
+  // Handover detection timer went from idle to armed. value: delay in us.
+  kHdtArmed = 0,
+  // Handover detection timer fired. value: detection delay in us,
+  // arg: result of the routing table lookup.
+  kHdtFired = 1,
+  // Routing table lookup timer fired. arg: result of the lookup.
+  kRltLookup = 2,
+  // No route found before the deadline, the connection is closed.
+  kRltDeadline = 3,
+  // Write failed. value: packet number, arg: errno.
+  kWriteError = 4,
+  kPathChallengeSent = 5,
+  kPathChallengeReceived = 6,
+  kPathResponseSent = 7,
+  kPathResponseReceived = 8,
+  // Client switched its default path. arg: 1 if only the port changed.
+  kMigrationComplete = 9,
+  // First STREAM frame received on a new local address. value: time since the
+  // last STREAM frame on the previous address in us.
+  kFirstDataOnNewPath = 10,
+  // Request sent / response received by the toy client. arg: request index.
+  kRequestStart = 11,
+  kRequestEnd = 12,
+  // Written by the flusher. value: records dropped because a ring was full.
+  kRecordsDropped = 13,
+};
+
+// [SD] Fixed-size binary trace record. Written to the trace file as is, after
+// a HandoverTraceFileHeader.
+struct QUIC_EXPORT_PRIVATE HandoverTraceRecord {
+  // Written in place of |count| records that a full ring dropped.
+  static HandoverTraceRecord Dropped(uint64_t count) {
+    HandoverTraceRecord record = {};
+    record.event = static_cast<uint8_t>(HandoverTraceEvent::kRecordsDropped);
+    record.value = static_cast<int64_t>(count);
+    return record;
+  }
+
+  // QuicClock time in microseconds.
+  uint64_t time_us;
+  // Identifies the connection, stable across connection ID changes.
+  uint64_t connection;
+  // Event specific, see HandoverTraceEvent.
+  int64_t value;
+  uint32_t arg;
+  uint8_t event;
+  uint8_t perspective;
+  uint8_t padding[2];
+};
+static_assert(sizeof(HandoverTraceRecord) == 32,
+              "HandoverTraceRecord is part of the trace file format");
+
+// [SD] Starts every run in a trace file. The transport metrics file uses it
+// too, with its own magic.
+struct QUIC_EXPORT_PRIVATE HandoverTraceFileHeader {
+  char magic[4];
+  uint32_t version;
+};
+
+static constexpr char kHandoverTraceMagic[4] = {'M', 'Q', 'T', 'R'};
+static constexpr uint32_t kHandoverTraceVersion = 1;
+
+// [SD] How often TraceFileWriter writes the rings to the file. At namespace
+// scope, since wait_for() binds it by reference and an in-class constexpr
+// member would need an out-of-line definition before C++17.
+static constexpr std::chrono::milliseconds kTraceFlushInterval{10};
+
+// [SD] Single producer, single consumer ring of trace records. The producer is
+// the thread the ring belongs to, the consumer is the flusher thread.
+template <typename Record>
+class QUIC_EXPORT_PRIVATE TraceRing {
+ public:
+  // Must be a power of two.
+  static constexpr uint64_t kCapacity = 4096;
+
+  // Returns false and counts the record as dropped if the ring is full.
+  bool Push(const Record& record) {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= kCapacity) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    records_[head & (kCapacity - 1)] = record;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Writes all pending records to |file|. Only called by the consumer.
+  void Drain(FILE* file) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    while (tail != head) {
+      // Write the contiguous part up to the end of the buffer at once.
+      const uint64_t index = tail & (kCapacity - 1);
+      const uint64_t count = std::min(head - tail, kCapacity - index);
+      fwrite(&records_[index], sizeof(Record), count, file);
+      tail += count;
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+
+  uint64_t TakeDropped() {
+    return dropped_.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  Record records_[kCapacity];
+  std::atomic<uint64_t> head_{0};
+  std::atomic<uint64_t> tail_{0};
+  std::atomic<uint64_t> dropped_{0};
+};
+
+using HandoverTraceRing = TraceRing<HandoverTraceRecord>;
+
+// [SD] Process wide file of fixed-size |Record|s. Recording is a bounded,
+// lock-free push to a ring owned by the calling thread, so it does not add
+// file I/O or locking to the paths whose latency is being measured. A flusher
+// thread writes the rings to the file every kTraceFlushInterval. |Record|
+// provides Dropped(count), the record written in place of records a full ring
+// dropped.
+// Rings are per thread and per |Record|, so there is one writer per |Record|.
+template <typename Record>
+class QUIC_EXPORT_PRIVATE TraceFileWriter {
+ public:
+  TraceFileWriter(const char (&magic)[4], uint32_t version)
+      : version_(version) {
+    std::copy(std::begin(magic), std::end(magic), magic_);
+  }
+
+  // Opens |path| for appending and starts the flusher. Returns false if the
+  // file cannot be opened or the writer is already running.
+  bool Start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ != nullptr) {
+      return false;
+    }
+    file_ = fopen(path.c_str(), "ab");
+    if (file_ == nullptr) {
+      return false;
+    }
+    HandoverTraceFileHeader header;
+    std::copy(std::begin(magic_), std::end(magic_), header.magic);
+    header.version = version_;
+    fwrite(&header, sizeof(header), 1, file_);
+    stop_ = false;
+    flusher_ = std::thread([this] { RunFlusher(); });
+    enabled_.store(true, std::memory_order_release);
+    return true;
+  }
+
+  // Stops recording, flushes everything recorded so far and closes the file.
+  void Stop() {
+    enabled_.store(false, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (file_ == nullptr) {
+        return;
+      }
+      stop_ = true;
+    }
+    stop_cv_.notify_one();
+    flusher_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    FlushLocked();
+    fclose(file_);
+    file_ = nullptr;
+  }
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  void Push(const Record& record) {
+    if (enabled()) {
+      GetThreadRing()->Push(record);
+    }
+  }
+
+ private:
+  // Returns the ring of the calling thread, registering it on first use. Rings
+  // are never freed, the flusher may still be draining them.
+  TraceRing<Record>* GetThreadRing() {
+    thread_local TraceRing<Record>* ring = nullptr;
+    if (ring == nullptr) {
+      auto new_ring = std::make_unique<TraceRing<Record>>();
+      ring = new_ring.get();
+      std::lock_guard<std::mutex> lock(mutex_);
+      rings_.push_back(std::move(new_ring));
+    }
+    return ring;
+  }
+
+  void RunFlusher() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+      stop_cv_.wait_for(lock, kTraceFlushInterval);
+      FlushLocked();
+    }
+  }
+
+  void FlushLocked() {
+    for (const auto& ring : rings_) {
+      ring->Drain(file_);
+      const uint64_t dropped = ring->TakeDropped();
+      if (dropped > 0) {
+        const Record record = Record::Dropped(dropped);
+        fwrite(&record, sizeof(record), 1, file_);
+      }
+    }
+    fflush(file_);
+  }
+
+  char magic_[4];
+  const uint32_t version_;
+  std::atomic<bool> enabled_{false};
+  // Guards everything below.
+  std::mutex mutex_;
+  std::condition_variable stop_cv_;
+  bool stop_ = false;
+  FILE* file_ = nullptr;
+  std::thread flusher_;
+  std::vector<std::unique_ptr<TraceRing<Record>>> rings_;
+};
+
+// [SD] Process wide handover tracer, writing HandoverTraceRecords. The file is
+// decoded offline by trace_decoder.
+class QUIC_EXPORT_PRIVATE HandoverTracer {
+ public:
+  static HandoverTracer* Get() {
+    static HandoverTracer* tracer = new HandoverTracer();
+    return tracer;
+  }
+
+  // Opens |path| for appending and starts the flusher. Returns false if the
+  // file cannot be opened or tracing is already running.
+  bool Start(const std::string& path) { return writer_.Start(path); }
+
+  // Stops recording, flushes everything recorded so far and closes the file.
+  void Stop() { writer_.Stop(); }
+
+  bool enabled() const { return writer_.enabled(); }
+
+  void Record(HandoverTraceEvent event,
+              QuicTime time,
+              uint64_t connection,
+              Perspective perspective,
+              int64_t value,
+              uint32_t arg) {
+    if (!enabled()) {
+      return;
+    }
+    HandoverTraceRecord record;
+    record.time_us = (time - QuicTime::Zero()).ToMicroseconds();
+    record.connection = connection;
+    record.value = value;
+    record.arg = arg;
+    record.event = static_cast<uint8_t>(event);
+    record.perspective = static_cast<uint8_t>(perspective);
+    record.padding[0] = record.padding[1] = 0;
+    writer_.Push(record);
+  }
+
+ private:
+  HandoverTracer() : writer_(kHandoverTraceMagic, kHandoverTraceVersion) {}
+
+  TraceFileWriter<HandoverTraceRecord> writer_;
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_CORE_QUIC_HANDOVER_TRACE_H_
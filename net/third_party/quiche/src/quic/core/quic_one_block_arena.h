@@ -21,8 +21,7 @@ namespace quic {
 
 template <uint32_t ArenaSize>
 class QUIC_EXPORT_PRIVATE QuicOneBlockArena {
-  // [SD] default: 8
-  static const uint32_t kMaxAlign = 16;
+  static const uint32_t kMaxAlign = 8;
 
  public:
   QuicOneBlockArena() : offset_(0) {}
@@ -63,15 +62,14 @@ class QUIC_EXPORT_PRIVATE QuicOneBlockArena {
   // Actual storage.
   // Subtle/annoying: the value '8' must be coded explicitly into the alignment
   // declaration for MSVC.
-  alignas(16) char storage_[ArenaSize];
+  alignas(8) char storage_[ArenaSize];
   // Current offset into the storage.
   uint32_t offset_;
 };
 
-// [SD] Default : 1152
 // QuicConnections currently use around 1KB of polymorphic types which would
 // ordinarily be on the heap. Instead, store them inline in an arena.
-using QuicConnectionArena = QuicOneBlockArena<2176>;
+using QuicConnectionArena = QuicOneBlockArena<1152>;
 
 }  // namespace quic
 
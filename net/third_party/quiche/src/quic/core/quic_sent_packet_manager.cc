@@ -63,6 +63,47 @@ inline bool ShouldForceRetransmission(TransmissionType transmission_type) {
 // losses.
 static const uint32_t kConservativeUnpacedBurst = 2;
 
+// [SD] Bounds of the per-network path state cache. Entries older than
+// kPathStateCacheLifetimeSecs are not restored, the network has most likely
+// changed its conditions by then.
+static const size_t kMaxCachedPathStates = 8;
+static const int64_t kPathStateCacheLifetimeSecs = 300;
+// [SD] Burst allowed when resuming on a cached path. The rate comes from an
+// older estimate, so do not let the pacer send a full window unpaced.
+static const uint32_t kRestoredPathUnpacedBurst = 10;
+
+// [SD] A secondary path whose oldest packet in flight waited this many PTOs
+// without an ack is considered gone.
+static const int kSecondaryPathMaxPtos = 3;
+// [SD] A secondary path whose smoothed RTT exceeds its min RTT by this factor
+// is degrading, e.g. the signal of the radio behind it is fading.
+static const int kSecondaryPathMaxRttInflation = 3;
+
+// [SD] Initial congestion window, in packets, to resume with from a cached
+// |congestion_window|.
+QuicPacketCount CachedCongestionWindowInPackets(
+    QuicByteCount congestion_window) {
+  return std::max<QuicPacketCount>(
+      kInitialCongestionWindow,
+      std::min<QuicPacketCount>(congestion_window / kDefaultTCPMSS,
+                                kMaxInitialCongestionWindow));
+}
+
+// [SD] Time until a packet sent now on a path is expected to reach the peer:
+// half an RTT plus the time to drain what is already in flight at the
+// estimated bandwidth.
+QuicTime::Delta EstimateDeliveryDelay(
+    const RttStats& rtt_stats,
+    const SendAlgorithmInterface& send_algorithm,
+    QuicByteCount bytes_in_flight) {
+  QuicTime::Delta delay = rtt_stats.SmoothedOrInitialRtt() * 0.5;
+  const QuicBandwidth bandwidth = send_algorithm.BandwidthEstimate();
+  if (!bandwidth.IsZero()) {
+    delay = delay + bandwidth.TransferTime(bytes_in_flight);
+  }
+  return delay;
+}
+
 }  // namespace
 
 #define ENDPOINT                                                         \
@@ -511,13 +552,21 @@ void QuicSentPacketManager::MaybeInvokeCongestionEvent(
   }
   const bool overshooting_detected =
       stats_->overshooting_detected_with_network_parameters_adjusted;
-  if (using_pacing_) {
-    //std::cout << "[quic_sent_packet_manager] MaybeInvokeCongestionEvent - using_pacing_" << std::endl;
-    pacing_sender_.OnCongestionEvent(rtt_updated, prior_in_flight, event_time,
-                                     packets_acked_, packets_lost_);
-  } else {
-    send_algorithm_->OnCongestionEvent(rtt_updated, prior_in_flight, event_time,
-                                       packets_acked_, packets_lost_);
+  if (secondary_path_ != nullptr) {
+    OnSecondaryPathCongestionEvent(event_time, &prior_in_flight);
+  }
+  // The event may have been about the secondary path only.
+  if (rtt_updated || !packets_acked_.empty() || !packets_lost_.empty()) {
+    if (using_pacing_) {
+      //std::cout << "[quic_sent_packet_manager] MaybeInvokeCongestionEvent - using_pacing_" << std::endl;
+      pacing_sender_.OnCongestionEvent(rtt_updated, prior_in_flight,
+                                       event_time, packets_acked_,
+                                       packets_lost_);
+    } else {
+      send_algorithm_->OnCongestionEvent(rtt_updated, prior_in_flight,
+                                         event_time, packets_acked_,
+                                         packets_lost_);
+    }
   }
   if (debug_delegate_ != nullptr && !overshooting_detected &&
       stats_->overshooting_detected_with_network_parameters_adjusted) {
@@ -838,7 +887,8 @@ bool QuicSentPacketManager::OnPacketSent(
     QuicTime sent_time,
     TransmissionType transmission_type,
     HasRetransmittableData has_retransmittable_data,
-    bool measure_rtt) {
+    bool measure_rtt,
+    bool on_secondary_path) {
   const SerializedPacket& packet = *mutable_packet;
   QuicPacketNumber packet_number = packet.packet_number;
   QUICHE_DCHECK_LE(FirstSendingPacketNumber(), packet_number);
@@ -859,12 +909,26 @@ bool QuicSentPacketManager::OnPacketSent(
     in_flight = false;
     measure_rtt = false;
   }
-  if (using_pacing_) {
-    pacing_sender_.OnPacketSent(sent_time, unacked_packets_.bytes_in_flight(),
+  if (on_secondary_path && in_flight && secondary_path_ != nullptr) {
+    if (using_pacing_) {
+      secondary_path_->pacing_sender.OnPacketSent(
+          sent_time, secondary_path_->bytes_in_flight, packet_number,
+          packet.encrypted_length, has_retransmittable_data);
+    } else {
+      secondary_path_->send_algorithm->OnPacketSent(
+          sent_time, secondary_path_->bytes_in_flight, packet_number,
+          packet.encrypted_length, has_retransmittable_data);
+    }
+    SecondaryPacket& secondary_packet = secondary_path_->packets[packet_number];
+    secondary_packet.sent_time = sent_time;
+    secondary_packet.bytes = packet.encrypted_length;
+    secondary_path_->bytes_in_flight += packet.encrypted_length;
+  } else if (using_pacing_) {
+    pacing_sender_.OnPacketSent(sent_time, GetPrimaryBytesInFlight(),
                                 packet_number, packet.encrypted_length,
                                 has_retransmittable_data);
   } else {
-    send_algorithm_->OnPacketSent(sent_time, unacked_packets_.bytes_in_flight(),
+    send_algorithm_->OnPacketSent(sent_time, GetPrimaryBytesInFlight(),
                                   packet_number, packet.encrypted_length,
                                   has_retransmittable_data);
   }
@@ -1211,6 +1275,10 @@ void QuicSentPacketManager::InvokeLossDetection(QuicTime time) {
   stats_->total_loss_detection_response_time +=
       detection_stats.total_loss_detection_response_time;
 
+  if (secondary_path_ != nullptr) {
+    DetectSecondaryPathLosses(time);
+  }
+
   for (const LostPacket& packet : packets_lost_) {
     QuicTransmissionInfo* info =
         unacked_packets_.GetMutableTransmissionInfo(packet.packet_number);
@@ -1270,14 +1338,20 @@ QuicTime::Delta QuicSentPacketManager::TimeUntilSend(QuicTime now) const {
     return QuicTime::Delta::Zero();
   }
 
+  QuicTime::Delta delay;
   if (using_pacing_) {
-    return pacing_sender_.TimeUntilSend(now,
-                                        unacked_packets_.bytes_in_flight());
+    delay = pacing_sender_.TimeUntilSend(now, GetPrimaryBytesInFlight());
+  } else {
+    delay = send_algorithm_->CanSend(GetPrimaryBytesInFlight())
+                ? QuicTime::Delta::Zero()
+                : QuicTime::Delta::Infinite();
   }
 
-  return send_algorithm_->CanSend(unacked_packets_.bytes_in_flight())
-             ? QuicTime::Delta::Zero()
-             : QuicTime::Delta::Infinite();
+  // [SD] The next packet goes out on whichever path can take it first.
+  if (secondary_path_ != nullptr && !secondary_path_->draining) {
+    delay = std::min(delay, SecondaryPathTimeUntilSend(now));
+  }
+  return delay;
 }
 
 const QuicTime QuicSentPacketManager::GetRetransmissionTime() const {
@@ -1543,8 +1617,297 @@ void QuicSentPacketManager::SetSendAlgorithm(
   pacing_sender_.set_sender(send_algorithm);
 }
 
+void QuicSentPacketManager::CachePathState(const std::string& network_id,
+                                          QuicTime now) {
+  if (network_id.empty() || rtt_stats_.min_rtt().IsZero()) {
+    return;
+  }
+  auto it = path_state_cache_.find(network_id);
+  if (it == path_state_cache_.end() &&
+      path_state_cache_.size() >= kMaxCachedPathStates) {
+    // Evict the least recently cached entry.
+    auto oldest = path_state_cache_.begin();
+    for (auto entry = path_state_cache_.begin();
+         entry != path_state_cache_.end(); ++entry) {
+      if (entry->second.cached_time < oldest->second.cached_time) {
+        oldest = entry;
+      }
+    }
+    path_state_cache_.erase(oldest);
+  }
+  CachedPathState& state = path_state_cache_[network_id];
+  state.rtt_stats.CloneFrom(rtt_stats_);
+  state.bandwidth_estimate = send_algorithm_->BandwidthEstimate();
+  state.congestion_window = send_algorithm_->GetCongestionWindow();
+  state.cached_time = now;
+}
+
+bool QuicSentPacketManager::RestorePathState(const std::string& network_id,
+                                            QuicTime now) {
+  auto it = path_state_cache_.find(network_id);
+  if (it == path_state_cache_.end()) {
+    return false;
+  }
+  if (now - it->second.cached_time >
+      QuicTime::Delta::FromSeconds(kPathStateCacheLifetimeSecs)) {
+    path_state_cache_.erase(it);
+    return false;
+  }
+  const CachedPathState& state = it->second;
+  rtt_stats_.CloneFrom(state.rtt_stats);
+  if (!state.bandwidth_estimate.IsZero()) {
+    AdjustNetworkParameters(SendAlgorithmInterface::NetworkParams(
+        state.bandwidth_estimate, state.rtt_stats.min_rtt(),
+        /*allow_cwnd_to_decrease=*/false));
+  }
+  const QuicPacketCount cwnd_in_packets =
+      CachedCongestionWindowInPackets(state.congestion_window);
+  send_algorithm_->SetInitialCongestionWindowInPackets(cwnd_in_packets);
+  if (using_pacing_) {
+    pacing_sender_.SetBurstTokens(kRestoredPathUnpacedBurst);
+  }
+  QUIC_DVLOG(1) << ENDPOINT << "Restored path state of " << network_id
+                << ", min_rtt: " << rtt_stats_.min_rtt()
+                << ", bandwidth: " << state.bandwidth_estimate
+                << ", cwnd: " << cwnd_in_packets;
+  return true;
+}
+
+bool QuicSentPacketManager::StartSecondaryPath(const std::string& network_id,
+                                              QuicTime now) {
+  if (secondary_path_ != nullptr) {
+    return false;
+  }
+  auto it = path_state_cache_.find(network_id);
+  if (it == path_state_cache_.end() ||
+      now - it->second.cached_time >
+          QuicTime::Delta::FromSeconds(kPathStateCacheLifetimeSecs)) {
+    return false;
+  }
+  const CachedPathState& state = it->second;
+  auto path = std::make_unique<SecondaryPath>();
+  path->rtt_stats.CloneFrom(state.rtt_stats);
+  path->send_algorithm.reset(SendAlgorithmInterface::Create(
+      clock_, &path->rtt_stats, &unacked_packets_,
+      send_algorithm_->GetCongestionControlType(), random_, stats_,
+      initial_congestion_window_, nullptr));
+  path->send_algorithm->SetInitialCongestionWindowInPackets(
+      CachedCongestionWindowInPackets(state.congestion_window));
+  if (!state.bandwidth_estimate.IsZero()) {
+    path->send_algorithm->AdjustNetworkParameters(
+        SendAlgorithmInterface::NetworkParams(
+            state.bandwidth_estimate, state.rtt_stats.min_rtt(),
+            /*allow_cwnd_to_decrease=*/false));
+  }
+  path->pacing_sender.set_sender(path->send_algorithm.get());
+  path->pacing_sender.set_max_pacing_rate(pacing_sender_.max_pacing_rate());
+  path->pacing_sender.set_alarm_granularity(
+      pacing_sender_.alarm_granularity());
+  secondary_path_ = std::move(path);
+  QUIC_DVLOG(1) << ENDPOINT << "Started secondary path on " << network_id
+                << ", min_rtt: " << secondary_path_->rtt_stats.min_rtt()
+                << ", bandwidth: " << state.bandwidth_estimate;
+  return true;
+}
+
+bool QuicSentPacketManager::ShouldSendOnSecondaryPath(QuicTime now) {
+  if (secondary_path_ == nullptr) {
+    return false;
+  }
+  MaybeRetireSecondaryPath(now);
+  // Timer transmissions probe the current path.
+  if (secondary_path_ == nullptr || secondary_path_->draining ||
+      pending_timer_transmission_count_ > 0) {
+    return false;
+  }
+  const SecondaryPath& path = *secondary_path_;
+  if (!SecondaryPathTimeUntilSend(now).IsZero()) {
+    return false;
+  }
+  const QuicByteCount primary_in_flight = GetPrimaryBytesInFlight();
+  const bool primary_can_send =
+      using_pacing_
+          ? pacing_sender_.TimeUntilSend(now, primary_in_flight).IsZero()
+          : send_algorithm_->CanSend(primary_in_flight);
+  if (!primary_can_send) {
+    return true;
+  }
+  return EstimateDeliveryDelay(path.rtt_stats, *path.send_algorithm,
+                               path.bytes_in_flight) <
+         EstimateDeliveryDelay(rtt_stats_, *send_algorithm_,
+                               primary_in_flight);
+}
+
+void QuicSentPacketManager::RetireSecondaryPath() {
+  if (secondary_path_ == nullptr) {
+    return;
+  }
+  QUIC_DVLOG(1) << ENDPOINT << "Retiring secondary path with "
+                << secondary_path_->packets.size() << " packets in flight";
+  // Move the data still in flight on the secondary path to the current one,
+  // without a congestion event, as OnConnectionMigration() does.
+  for (const auto& entry : secondary_path_->packets) {
+    const QuicPacketNumber packet_number = entry.first;
+    if (!unacked_packets_.IsUnacked(packet_number) ||
+        !unacked_packets_.GetTransmissionInfo(packet_number).in_flight) {
+      continue;
+    }
+    unacked_packets_.RemoveFromInFlight(packet_number);
+    if (unacked_packets_.HasRetransmittableFrames(packet_number)) {
+      MarkForRetransmission(packet_number, PATH_RETRANSMISSION);
+    }
+  }
+  secondary_path_.reset();
+}
+
+void QuicSentPacketManager::DetectSecondaryPathLosses(QuicTime time) {
+  SecondaryPath& path = *secondary_path_;
+  // The loss algorithm judged these packets by the reordering against the
+  // current path and its RTT, which says nothing about the secondary path.
+  packets_lost_.erase(
+      std::remove_if(packets_lost_.begin(), packets_lost_.end(),
+                     [&path](const LostPacket& packet) {
+                       return path.packets.count(packet.packet_number) > 0;
+                     }),
+      packets_lost_.end());
+  for (const AckedPacket& packet : packets_acked_) {
+    if (path.packets.count(packet.packet_number) > 0) {
+      path.largest_acked.UpdateMax(packet.packet_number);
+    }
+  }
+  if (!path.largest_acked.IsInitialized()) {
+    return;
+  }
+  // Time threshold of RFC 9002 with the RTT of the secondary path.
+  const QuicTime::Delta loss_delay = std::max(
+      kAlarmGranularity, std::max(path.rtt_stats.latest_rtt(),
+                                  path.rtt_stats.SmoothedOrInitialRtt()) *
+                             1.125);
+  for (const auto& entry : path.packets) {
+    if (entry.first >= path.largest_acked ||
+        time - entry.second.sent_time < loss_delay) {
+      break;
+    }
+    // Packets acked by this ack frame have left the flight already.
+    if (!unacked_packets_.IsUnacked(entry.first) ||
+        !unacked_packets_.GetTransmissionInfo(entry.first).in_flight) {
+      continue;
+    }
+    packets_lost_.push_back(LostPacket(entry.first, entry.second.bytes));
+  }
+}
+
+void QuicSentPacketManager::OnSecondaryPathCongestionEvent(
+    QuicTime event_time,
+    QuicByteCount* prior_in_flight) {
+  SecondaryPath& path = *secondary_path_;
+  const QuicByteCount prior_secondary_in_flight = path.bytes_in_flight;
+  AckedPacketVector primary_acked;
+  AckedPacketVector secondary_acked;
+  QuicTime latest_sent_time = QuicTime::Zero();
+  for (const AckedPacket& packet : packets_acked_) {
+    auto it = path.packets.find(packet.packet_number);
+    if (it == path.packets.end()) {
+      primary_acked.push_back(packet);
+      continue;
+    }
+    secondary_acked.push_back(packet);
+    latest_sent_time = std::max(latest_sent_time, it->second.sent_time);
+    path.bytes_in_flight -= it->second.bytes;
+    path.packets.erase(it);
+  }
+  LostPacketVector primary_lost;
+  LostPacketVector secondary_lost;
+  for (const LostPacket& packet : packets_lost_) {
+    auto it = path.packets.find(packet.packet_number);
+    if (it == path.packets.end()) {
+      primary_lost.push_back(packet);
+      continue;
+    }
+    secondary_lost.push_back(packet);
+    path.bytes_in_flight -= it->second.bytes;
+    path.packets.erase(it);
+  }
+  packets_acked_.swap(primary_acked);
+  packets_lost_.swap(primary_lost);
+
+  // The ack delay only applies to the largest acked packet, which is usually
+  // on the faster path, so the sample includes it.
+  const bool rtt_updated = latest_sent_time.IsInitialized();
+  if (rtt_updated) {
+    path.rtt_stats.UpdateRtt(event_time - latest_sent_time,
+                             QuicTime::Delta::Zero(), event_time);
+  }
+  if (rtt_updated || !secondary_acked.empty() || !secondary_lost.empty()) {
+    if (using_pacing_) {
+      path.pacing_sender.OnCongestionEvent(rtt_updated,
+                                           prior_secondary_in_flight,
+                                           event_time, secondary_acked,
+                                           secondary_lost);
+    } else {
+      path.send_algorithm->OnCongestionEvent(rtt_updated,
+                                             prior_secondary_in_flight,
+                                             event_time, secondary_acked,
+                                             secondary_lost);
+    }
+  }
+  *prior_in_flight -= std::min(*prior_in_flight, prior_secondary_in_flight);
+  MaybeRetireSecondaryPath(event_time);
+}
+
+void QuicSentPacketManager::MaybeRetireSecondaryPath(QuicTime now) {
+  SecondaryPath& path = *secondary_path_;
+  if (path.packets.empty()) {
+    if (path.draining) {
+      QUIC_DVLOG(1) << ENDPOINT << "Secondary path drained";
+      secondary_path_.reset();
+    }
+    return;
+  }
+  const QuicTime::Delta pto_delay =
+      path.rtt_stats.SmoothedOrInitialRtt() +
+      std::max(pto_rttvar_multiplier_ * path.rtt_stats.mean_deviation(),
+               kAlarmGranularity) +
+      peer_max_ack_delay_;
+  if (now - path.packets.begin()->second.sent_time >
+      pto_delay * kSecondaryPathMaxPtos) {
+    RetireSecondaryPath();
+    return;
+  }
+  if (!path.draining && !path.rtt_stats.min_rtt().IsZero() &&
+      path.rtt_stats.smoothed_rtt() >
+          path.rtt_stats.min_rtt() * kSecondaryPathMaxRttInflation) {
+    QUIC_DVLOG(1) << ENDPOINT << "Secondary path degraded, srtt: "
+                  << path.rtt_stats.smoothed_rtt()
+                  << ", min_rtt: " << path.rtt_stats.min_rtt();
+    path.draining = true;
+  }
+}
+
+QuicByteCount QuicSentPacketManager::GetPrimaryBytesInFlight() const {
+  const QuicByteCount bytes_in_flight = unacked_packets_.bytes_in_flight();
+  if (secondary_path_ == nullptr) {
+    return bytes_in_flight;
+  }
+  return bytes_in_flight -
+         std::min(bytes_in_flight, secondary_path_->bytes_in_flight);
+}
+
+QuicTime::Delta QuicSentPacketManager::SecondaryPathTimeUntilSend(
+    QuicTime now) const {
+  const SecondaryPath& path = *secondary_path_;
+  if (using_pacing_) {
+    return path.pacing_sender.TimeUntilSend(now, path.bytes_in_flight);
+  }
+  return path.send_algorithm->CanSend(path.bytes_in_flight)
+             ? QuicTime::Delta::Zero()
+             : QuicTime::Delta::Infinite();
+}
+
 std::unique_ptr<SendAlgorithmInterface>
 QuicSentPacketManager::OnConnectionMigration(bool reset_send_algorithm) {
+  // [SD] A new migration starts over from a single path.
+  RetireSecondaryPath();
   consecutive_rto_count_ = 0;
   consecutive_tlp_count_ = 0;
   consecutive_pto_count_ = 0;
@@ -1766,7 +2129,14 @@ void QuicSentPacketManager::OnApplicationLimited() {
   if (using_pacing_) {
     pacing_sender_.OnApplicationLimited();
   }
-  send_algorithm_->OnApplicationLimited(unacked_packets_.bytes_in_flight());
+  send_algorithm_->OnApplicationLimited(GetPrimaryBytesInFlight());
+  if (secondary_path_ != nullptr) {
+    if (using_pacing_) {
+      secondary_path_->pacing_sender.OnApplicationLimited();
+    }
+    secondary_path_->send_algorithm->OnApplicationLimited(
+        secondary_path_->bytes_in_flight);
+  }
   if (debug_delegate_ != nullptr) {
     debug_delegate_->OnApplicationLimited();
   }
@@ -138,6 +138,9 @@ class QUIC_EXPORT_PRIVATE QuicSentPacketManager {
 
   void SetMaxPacingRate(QuicBandwidth max_pacing_rate) {
     pacing_sender_.set_max_pacing_rate(max_pacing_rate);
+    if (secondary_path_ != nullptr) {
+      secondary_path_->pacing_sender.set_max_pacing_rate(max_pacing_rate);
+    }
   }
 
   QuicBandwidth MaxPacingRate() const {
@@ -198,12 +201,14 @@ class QUIC_EXPORT_PRIVATE QuicSentPacketManager {
   // Called when we have sent bytes to the peer.  This informs the manager both
   // the number of bytes sent and if they were retransmitted and if this packet
   // is used for rtt measuring.  Returns true if the sender should reset the
-  // retransmission timer.
+  // retransmission timer. [SD] |on_secondary_path| tells that the packet left
+  // on the secondary path, whose send algorithm then accounts for it.
   bool OnPacketSent(SerializedPacket* mutable_packet,
                     QuicTime sent_time,
                     TransmissionType transmission_type,
                     HasRetransmittableData has_retransmittable_data,
-                    bool measure_rtt);
+                    bool measure_rtt,
+                    bool on_secondary_path = false);
 
   bool CanSendAckFrequency() const;
 
@@ -312,6 +317,37 @@ class QUIC_EXPORT_PRIVATE QuicSentPacketManager {
   std::unique_ptr<SendAlgorithmInterface> OnConnectionMigration(
       bool reset_send_algorithm);
 
+  // [SD] Remembers the RTT, bandwidth and congestion window of the current
+  // path under |network_id| so that they can be restored if the connection
+  // migrates back to that network. Must be called before
+  // OnConnectionMigration() resets them. Does nothing without RTT samples.
+  void CachePathState(const std::string& network_id, QuicTime now);
+
+  // [SD] Seeds RTT stats, the send algorithm and the pacer from the state
+  // cached for |network_id|, if there is an entry that has not aged out.
+  // Should be called after OnConnectionMigration(). Returns true if the state
+  // was restored.
+  bool RestorePathState(const std::string& network_id, QuicTime now);
+
+  // [SD] Starts a secondary path next to the current one, e.g. the path the
+  // peer migrated away from while it still delivers packets. It gets its own
+  // RTT stats and send algorithm, seeded from the state cached for
+  // |network_id| by CachePathState(). Returns false if there is no such state
+  // or a secondary path already exists.
+  bool StartSecondaryPath(const std::string& network_id, QuicTime now);
+
+  // [SD] Returns true if the next data packet should be sent on the secondary
+  // path: its congestion window has room and either the current path is
+  // blocked or the secondary path is expected to deliver the packet first.
+  // Retires the secondary path first if it degraded.
+  bool ShouldSendOnSecondaryPath(QuicTime now);
+
+  // [SD] Stops using the secondary path. Packets still in flight on it are
+  // retransmitted on the current path.
+  void RetireSecondaryPath();
+
+  bool HasSecondaryPath() const { return secondary_path_ != nullptr; }
+
   // Called when an ack frame is initially parsed.
   void OnAckFrameStart(QuicPacketNumber largest_acked,
                        QuicTime::Delta ack_delay_time,
@@ -336,6 +372,9 @@ class QUIC_EXPORT_PRIVATE QuicSentPacketManager {
 
   void SetPacingAlarmGranularity(QuicTime::Delta alarm_granularity) {
     pacing_sender_.set_alarm_granularity(alarm_granularity);
+    if (secondary_path_ != nullptr) {
+      secondary_path_->pacing_sender.set_alarm_granularity(alarm_granularity);
+    }
   }
 
   QuicPacketNumber GetLargestObserved() const {
@@ -529,6 +568,27 @@ class QUIC_EXPORT_PRIVATE QuicSentPacketManager {
   // necessary.
   void InvokeLossDetection(QuicTime time);
 
+  // [SD] Replaces the losses the loss algorithm found among secondary path
+  // packets with the ones that are lost by the RTT of that path.
+  void DetectSecondaryPathLosses(QuicTime time);
+
+  // [SD] Takes the secondary path packets out of packets_acked_ and
+  // packets_lost_ and hands them to the send algorithm of that path. Removes
+  // their bytes from |prior_in_flight|.
+  void OnSecondaryPathCongestionEvent(QuicTime event_time,
+                                      QuicByteCount* prior_in_flight);
+
+  // [SD] Retires the secondary path if it stopped acknowledging packets, or
+  // lets it drain if its RTT inflated. Removes it once it has drained.
+  void MaybeRetireSecondaryPath(QuicTime now);
+
+  // [SD] Bytes in flight on the current path.
+  QuicByteCount GetPrimaryBytesInFlight() const;
+
+  // [SD] Time until the secondary path, which must exist, can take the next
+  // packet. Paced like the current path if pacing is used.
+  QuicTime::Delta SecondaryPathTimeUntilSend(QuicTime now) const;
+
   // Invokes OnCongestionEvent if |rtt_updated| is true, there are pending acks,
   // or pending losses.  Clears pending acks and pending losses afterwards.
   // |prior_in_flight| is the number of bytes in flight before the losses or
@@ -772,6 +832,37 @@ class QUIC_EXPORT_PRIVATE QuicSentPacketManager {
   bool ignore_ack_delay_;
 
   QuicTime::Delta pv_rtt_;
+
+  // [SD] Path state remembered per network across migrations.
+  struct CachedPathState {
+    RttStats rtt_stats;
+    QuicBandwidth bandwidth_estimate = QuicBandwidth::Zero();
+    QuicByteCount congestion_window = 0;
+    QuicTime cached_time = QuicTime::Zero();
+  };
+  // Keyed by network identity, at most kMaxCachedPathStates entries.
+  std::map<std::string, CachedPathState> path_state_cache_;
+
+  // [SD] Packets of the secondary path are tracked in unacked_packets_ like
+  // all others, this only adds what the secondary send algorithm needs.
+  struct SecondaryPacket {
+    QuicTime sent_time = QuicTime::Zero();
+    QuicPacketLength bytes = 0;
+  };
+  struct SecondaryPath {
+    RttStats rtt_stats;
+    // Points to |rtt_stats|.
+    std::unique_ptr<SendAlgorithmInterface> send_algorithm;
+    // Paces |send_algorithm| if the current path is paced.
+    PacingSender pacing_sender;
+    // Packets in flight on this path.
+    std::map<QuicPacketNumber, SecondaryPacket> packets;
+    QuicByteCount bytes_in_flight = 0;
+    QuicPacketNumber largest_acked;
+    // Set once the path degraded. No new packets are sent on it.
+    bool draining = false;
+  };
+  std::unique_ptr<SecondaryPath> secondary_path_;
 };
 
 }  // namespace quic
@@ -0,0 +1,235 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef QUICHE_QUIC_CORE_QUIC_TRANSPORT_METRICS_H_
+#define QUICHE_QUIC_CORE_QUIC_TRANSPORT_METRICS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "quic/core/quic_alarm.h"
+#include "quic/core/quic_alarm_factory.h"
+#include "quic/core/quic_connection.h"
+#include "quic/core/quic_handover_trace.h"
+#include "quic/core/quic_time.h"
+#include "quic/core/quic_types.h"
+#include "quic/platform/api/quic_export.h"
+
+namespace quic {
+
+// [SD] Kinds of transport metrics records. Values are part of the file format,
+// only append new ones.
+enum class TransportMetricsKind : uint8_t {
+  // State of one connection.
+  kConnection = 0,
+  // All connections of one dispatcher: windows, rates, bytes and losses are
+  // summed, smoothed RTT is the mean and min RTT the minimum.
+  kAggregate = 1,
+  // Written by the flusher. num_connections: records dropped because a ring
+  // was full.
+  kRecordsDropped = 2,
+};
+
+// [SD] Fixed-size transport metrics record. Written to the metrics file as is,
+// after a HandoverTraceFileHeader with kTransportMetricsMagic.
+struct QUIC_EXPORT_PRIVATE TransportMetricsRecord {
+  static TransportMetricsRecord Dropped(uint64_t count) {
+    TransportMetricsRecord record = {};
+    record.kind = static_cast<uint8_t>(TransportMetricsKind::kRecordsDropped);
+    record.num_connections = static_cast<uint32_t>(
+        std::min<uint64_t>(count, std::numeric_limits<uint32_t>::max()));
+    return record;
+  }
+
+  // QuicClock time in microseconds, as in the handover trace.
+  uint64_t time_us;
+  // QuicConnection::trace_id(), 0 in aggregates.
+  uint64_t connection;
+  uint64_t congestion_window;
+  uint64_t bytes_in_flight;
+  uint64_t bandwidth_estimate_bps;
+  uint64_t pacing_rate_bps;
+  uint64_t bytes_sent;
+  uint64_t bytes_received;
+  uint32_t smoothed_rtt_us;
+  uint32_t min_rtt_us;
+  uint32_t packets_lost;
+  uint32_t packets_retransmitted;
+  uint32_t num_connections;
+  uint8_t kind;
+  uint8_t perspective;
+  // Server worker the connections belong to.
+  uint8_t worker;
+  uint8_t padding;
+};
+static_assert(sizeof(TransportMetricsRecord) == 88,
+              "TransportMetricsRecord is part of the metrics file format");
+
+static constexpr char kTransportMetricsMagic[4] = {'M', 'Q', 'T', 'M'};
+static constexpr uint32_t kTransportMetricsVersion = 1;
+
+// [SD] Process wide transport metrics file. Like the handover trace, samples
+// are pushed to a ring of the sampling thread and written by a flusher, so
+// workers never block on each other or on the file. Decoded by trace_decoder.
+class QUIC_EXPORT_PRIVATE TransportMetricsExporter {
+ public:
+  static TransportMetricsExporter* Get() {
+    static TransportMetricsExporter* exporter = new TransportMetricsExporter();
+    return exporter;
+  }
+
+  // Opens |path| for appending and starts the flusher. Returns false if the
+  // file cannot be opened or the exporter is already running.
+  bool Start(const std::string& path) { return writer_.Start(path); }
+
+  // Stops recording, flushes everything recorded so far and closes the file.
+  void Stop() { writer_.Stop(); }
+
+  bool enabled() const { return writer_.enabled(); }
+
+  void Record(const TransportMetricsRecord& record) { writer_.Push(record); }
+
+ private:
+  TransportMetricsExporter()
+      : writer_(kTransportMetricsMagic, kTransportMetricsVersion) {}
+
+  TraceFileWriter<TransportMetricsRecord> writer_;
+};
+
+// [SD] Samples the congestion controller, RTT and loss counters of a set of
+// connections on an alarm of their own event loop, so the state is read by
+// the thread that owns it. Each round writes a record per connection and an
+// aggregate of all of them to the TransportMetricsExporter.
+class QUIC_EXPORT_PRIVATE QuicTransportMetricsSampler {
+ public:
+  class QUIC_EXPORT_PRIVATE Delegate {
+   public:
+    virtual ~Delegate() = default;
+
+    // Calls Sample() for each connection to sample.
+    virtual void SampleConnections(QuicTransportMetricsSampler* sampler) = 0;
+  };
+
+  QuicTransportMetricsSampler(Delegate* delegate,
+                              const QuicClock* clock,
+                              QuicAlarmFactory* alarm_factory,
+                              QuicTime::Delta interval,
+                              uint8_t worker)
+      : delegate_(delegate),
+        clock_(clock),
+        interval_(interval),
+        worker_(worker),
+        alarm_(alarm_factory->CreateAlarm(new AlarmDelegate(this))),
+        aggregate_(),
+        rtt_sum_us_(0) {}
+
+  QuicTransportMetricsSampler(const QuicTransportMetricsSampler&) = delete;
+  QuicTransportMetricsSampler& operator=(const QuicTransportMetricsSampler&) =
+      delete;
+
+  ~QuicTransportMetricsSampler() { alarm_->PermanentCancel(); }
+
+  // Samples every |interval| from now on.
+  void Start() {
+    if (!alarm_->IsSet()) {
+      alarm_->Set(clock_->ApproximateNow() + interval_);
+    }
+  }
+
+  // Records |connection| in the current round. Only called from
+  // Delegate::SampleConnections().
+  void Sample(QuicConnection* connection) {
+    const QuicSentPacketManager& manager = connection->sent_packet_manager();
+    const QuicConnectionStats& stats = connection->GetStats();
+    TransportMetricsRecord record = {};
+    record.time_us = (now_ - QuicTime::Zero()).ToMicroseconds();
+    record.connection = connection->trace_id();
+    record.congestion_window = manager.GetCongestionWindowInBytes();
+    record.bytes_in_flight = manager.GetBytesInFlight();
+    record.bandwidth_estimate_bps = stats.estimated_bandwidth.ToBitsPerSecond();
+    record.pacing_rate_bps = manager.GetPacingRate().ToBitsPerSecond();
+    record.bytes_sent = stats.bytes_sent;
+    record.bytes_received = stats.bytes_received;
+    record.smoothed_rtt_us = ClampToUint32(stats.srtt_us);
+    record.min_rtt_us = ClampToUint32(stats.min_rtt_us);
+    record.packets_lost = ClampToUint32(stats.packets_lost);
+    record.packets_retransmitted = ClampToUint32(stats.packets_retransmitted);
+    record.num_connections = 1;
+    record.kind = static_cast<uint8_t>(TransportMetricsKind::kConnection);
+    record.perspective = static_cast<uint8_t>(connection->perspective());
+    record.worker = worker_;
+    TransportMetricsExporter::Get()->Record(record);
+
+    aggregate_.congestion_window += record.congestion_window;
+    aggregate_.bytes_in_flight += record.bytes_in_flight;
+    aggregate_.bandwidth_estimate_bps += record.bandwidth_estimate_bps;
+    aggregate_.pacing_rate_bps += record.pacing_rate_bps;
+    aggregate_.bytes_sent += record.bytes_sent;
+    aggregate_.bytes_received += record.bytes_received;
+    aggregate_.packets_lost += record.packets_lost;
+    aggregate_.packets_retransmitted += record.packets_retransmitted;
+    aggregate_.perspective = record.perspective;
+    if (aggregate_.num_connections == 0 ||
+        record.min_rtt_us < aggregate_.min_rtt_us) {
+      aggregate_.min_rtt_us = record.min_rtt_us;
+    }
+    rtt_sum_us_ += record.smoothed_rtt_us;
+    ++aggregate_.num_connections;
+  }
+
+ private:
+  class AlarmDelegate : public QuicAlarm::DelegateWithoutContext {
+   public:
+    explicit AlarmDelegate(QuicTransportMetricsSampler* sampler)
+        : sampler_(sampler) {}
+    AlarmDelegate(const AlarmDelegate&) = delete;
+    AlarmDelegate& operator=(const AlarmDelegate&) = delete;
+
+    void OnAlarm() override { sampler_->OnAlarm(); }
+
+   private:
+    QuicTransportMetricsSampler* sampler_;
+  };
+
+  static uint32_t ClampToUint32(uint64_t value) {
+    return static_cast<uint32_t>(
+        std::min<uint64_t>(value, std::numeric_limits<uint32_t>::max()));
+  }
+
+  void OnAlarm() {
+    now_ = clock_->ApproximateNow();
+    if (TransportMetricsExporter::Get()->enabled()) {
+      aggregate_ = {};
+      rtt_sum_us_ = 0;
+      delegate_->SampleConnections(this);
+      aggregate_.time_us = (now_ - QuicTime::Zero()).ToMicroseconds();
+      aggregate_.kind = static_cast<uint8_t>(TransportMetricsKind::kAggregate);
+      aggregate_.worker = worker_;
+      if (aggregate_.num_connections > 0) {
+        aggregate_.smoothed_rtt_us =
+            static_cast<uint32_t>(rtt_sum_us_ / aggregate_.num_connections);
+      }
+      TransportMetricsExporter::Get()->Record(aggregate_);
+    }
+    alarm_->Set(now_ + interval_);
+  }
+
+  Delegate* delegate_;
+  const QuicClock* clock_;
+  const QuicTime::Delta interval_;
+  const uint8_t worker_;
+  std::unique_ptr<QuicAlarm> alarm_;
+  // Time of the current round.
+  QuicTime now_ = QuicTime::Zero();
+  // Aggregate of the current round.
+  TransportMetricsRecord aggregate_;
+  uint64_t rtt_sum_us_;
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_CORE_QUIC_TRANSPORT_METRICS_H_
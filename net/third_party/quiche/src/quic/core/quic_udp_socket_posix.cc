@@ -107,13 +107,7 @@ void SetV4SelfIpInControlMessage(const QuicIpAddress& self_address,
   in_pktinfo* pktinfo = reinterpret_cast<in_pktinfo*>(CMSG_DATA(cmsg));
   memset(pktinfo, 0, sizeof(in_pktinfo));
   pktinfo->ipi_ifindex = 0;
-  //[SD] Test
-  std::string address_string = self_address.ToPackedString();
-  //std::cout << "[quic_udp_socket_posix] set self address: " << self_address.ToString() << std::endl;
-  //std::string address_string = QuicIpAddress::Any4().ToPackedString();
-  //std::cout << "[quic_udp_socket_posix] set self address: 0.0.0.0" << std::endl;
-  memcpy(&pktinfo->ipi_spec_dst, address_string.c_str(),
-         address_string.length());
+  pktinfo->ipi_spec_dst = self_address.GetIPv4();
 }
 
 void SetV6SelfIpInControlMessage(const QuicIpAddress& self_address,
@@ -121,8 +115,57 @@ void SetV6SelfIpInControlMessage(const QuicIpAddress& self_address,
   QUICHE_DCHECK(self_address.IsIPv6());
   in6_pktinfo* pktinfo = reinterpret_cast<in6_pktinfo*>(CMSG_DATA(cmsg));
   memset(pktinfo, 0, sizeof(in6_pktinfo));
-  std::string address_string = self_address.ToPackedString();
-  memcpy(&pktinfo->ipi6_addr, address_string.c_str(), address_string.length());
+  pktinfo->ipi6_addr = self_address.GetIPv6();
+}
+
+// [SD] A self IP control message ready to be handed to sendmsg().
+struct SelfIpControlMessage {
+  QuicIpAddress self_ip;
+  size_t length = 0;
+  alignas(cmsghdr) char buffer[CMSG_SPACE(sizeof(in6_pktinfo))];
+};
+
+// [SD] A connection writes on its default path and, while validating a new
+// one, on an alternative path, so each thread caches the control messages of
+// the last two self IPs. Entries are keyed by the self IP: after a migration
+// the new address misses and replaces the least recently used entry.
+const int kNumCachedSelfIpControlMessages = 2;
+thread_local SelfIpControlMessage
+    cached_self_ip_control_messages[kNumCachedSelfIpControlMessages];
+thread_local int last_used_self_ip_control_message = 0;
+
+const SelfIpControlMessage& GetSelfIpControlMessage(
+    const QuicIpAddress& self_ip) {
+  for (int i = 0; i < kNumCachedSelfIpControlMessages; ++i) {
+    const SelfIpControlMessage& entry = cached_self_ip_control_messages[i];
+    if (entry.length > 0 && entry.self_ip == self_ip) {
+      last_used_self_ip_control_message = i;
+      return entry;
+    }
+  }
+
+  last_used_self_ip_control_message =
+      (last_used_self_ip_control_message + 1) %
+      kNumCachedSelfIpControlMessages;
+  SelfIpControlMessage& entry =
+      cached_self_ip_control_messages[last_used_self_ip_control_message];
+  memset(entry.buffer, 0, sizeof(entry.buffer));
+  cmsghdr* cmsg = reinterpret_cast<cmsghdr*>(entry.buffer);
+  if (self_ip.IsIPv4()) {
+    cmsg->cmsg_len = CMSG_LEN(sizeof(in_pktinfo));
+    cmsg->cmsg_level = IPPROTO_IP;
+    cmsg->cmsg_type = IP_PKTINFO;
+    SetV4SelfIpInControlMessage(self_ip, cmsg);
+    entry.length = CMSG_SPACE(sizeof(in_pktinfo));
+  } else {
+    cmsg->cmsg_len = CMSG_LEN(sizeof(in6_pktinfo));
+    cmsg->cmsg_level = IPPROTO_IPV6;
+    cmsg->cmsg_type = IPV6_PKTINFO;
+    SetV6SelfIpInControlMessage(self_ip, cmsg);
+    entry.length = CMSG_SPACE(sizeof(in6_pktinfo));
+  }
+  entry.self_ip = self_ip;
+  return entry;
 }
 
 void PopulatePacketInfoFromControlMessage(struct cmsghdr* cmsg,
@@ -591,11 +634,25 @@ WriteResult QuicUdpSocketApi::WritePacket(
 
   cmsghdr* cmsg = nullptr;
 
-  //std::cout << "[quic_udp_socket_posix] call write packet raw" << std::endl;
-
   // Set self IP.
-  if (packet_info.HasValue(QuicUdpPacketInfoBit::V4_SELF_IP) &&
+  // [SD] Without a TTL the control message only carries the self IP, so the
+  // cached one is used instead of building it for every packet.
+  const bool has_ttl = packet_info.HasValue(QuicUdpPacketInfoBit::TTL);
+  if (!has_ttl && packet_info.HasValue(QuicUdpPacketInfoBit::V4_SELF_IP) &&
       packet_info.self_v4_ip().IsInitialized()) {
+    const SelfIpControlMessage& control_message =
+        GetSelfIpControlMessage(packet_info.self_v4_ip());
+    hdr.msg_control = const_cast<char*>(control_message.buffer);
+    hdr.msg_controllen = control_message.length;
+  } else if (!has_ttl &&
+             packet_info.HasValue(QuicUdpPacketInfoBit::V6_SELF_IP) &&
+             packet_info.self_v6_ip().IsInitialized()) {
+    const SelfIpControlMessage& control_message =
+        GetSelfIpControlMessage(packet_info.self_v6_ip());
+    hdr.msg_control = const_cast<char*>(control_message.buffer);
+    hdr.msg_controllen = control_message.length;
+  } else if (packet_info.HasValue(QuicUdpPacketInfoBit::V4_SELF_IP) &&
+             packet_info.self_v4_ip().IsInitialized()) {
     if (!NextCmsg(&hdr, control_buffer, sizeof(control_buffer), IPPROTO_IP,
                   IP_PKTINFO, sizeof(in_pktinfo), &cmsg)) {
       QUIC_LOG_FIRST_N(ERROR, 100)
@@ -617,7 +674,7 @@ WriteResult QuicUdpSocketApi::WritePacket(
 
 #if defined(QUIC_UDP_SOCKET_SUPPORT_TTL)
   // Set ttl.
-  if (packet_info.HasValue(QuicUdpPacketInfoBit::TTL)) {
+  if (has_ttl) {
     int cmsg_level =
         packet_info.peer_address().host().IsIPv4() ? IPPROTO_IP : IPPROTO_IPV6;
     int cmsg_type =
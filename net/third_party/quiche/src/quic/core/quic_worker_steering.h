@@ -0,0 +1,283 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef QUICHE_QUIC_CORE_QUIC_WORKER_STEERING_H_
+#define QUICHE_QUIC_CORE_QUIC_WORKER_STEERING_H_
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "quic/core/quic_connection_id.h"
+#include "quic/core/quic_constants.h"
+#include "quic/core/quic_packets.h"
+#include "quic/core/quic_time.h"
+#include "quic/core/quic_utils.h"
+#include "quic/platform/api/quic_export.h"
+#include "quic/platform/api/quic_socket_address.h"
+
+namespace quic {
+
+// [SD] Steers packets between the workers of a multi-core server. Every worker
+// owns a SO_REUSEPORT socket and a QuicDispatcher. The kernel shards packets
+// by 4-tuple, which changes when a client migrates, so a worker may receive
+// packets of a connection owned by another worker:
+//  - Connection IDs minted by the dispatcher carry the owning worker in their
+//    first byte.
+//  - Connection IDs issued later with NEW_CONNECTION_ID are derived by the
+//    connection ID manager, so the owner registers them in a lock-free table.
+// Packets that land on the wrong worker are copied to the owner's forwarding
+// queue, and the owner is woken up through an eventfd.
+class QUIC_EXPORT_PRIVATE QuicWorkerSteering {
+ public:
+  // Worker IDs must fit in the first byte of a connection ID.
+  static const int kMaxWorkers = 64;
+  // Packets each worker can have pending before forwarded packets are dropped.
+  // Must be a power of two.
+  static const uint64_t kForwardingQueueSize = 1024;
+  // Entries of the connection ID table. Must be a power of two.
+  static const uint64_t kConnectionIdTableSize = 1 << 16;
+  // Slots probed before a table insertion fails.
+  static const int kMaxProbes = 16;
+
+  struct ForwardedPacket {
+    QuicSocketAddress self_address;
+    QuicSocketAddress peer_address;
+    QuicTime receipt_time = QuicTime::Zero();
+    size_t length = 0;
+    char data[kMaxIncomingPacketSize];
+  };
+
+  explicit QuicWorkerSteering(int num_workers)
+      : num_workers_(num_workers),
+        connection_id_table_(
+            new std::atomic<uint64_t>[kConnectionIdTableSize]) {
+    for (uint64_t i = 0; i < kConnectionIdTableSize; ++i) {
+      connection_id_table_[i].store(kEmptyEntry, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < num_workers_; ++i) {
+      workers_.push_back(std::make_unique<Worker>());
+    }
+  }
+  QuicWorkerSteering(const QuicWorkerSteering&) = delete;
+  QuicWorkerSteering& operator=(const QuicWorkerSteering&) = delete;
+
+  ~QuicWorkerSteering() {
+    for (const auto& worker : workers_) {
+      if (worker->wakeup_fd >= 0) {
+        close(worker->wakeup_fd);
+      }
+    }
+  }
+
+  int num_workers() const { return num_workers_; }
+
+  // Readable when packets were forwarded to |worker_id|. Register it with the
+  // worker's event loop and call Drain() when it fires.
+  int wakeup_fd(int worker_id) const { return workers_[worker_id]->wakeup_fd; }
+
+  // Writes |worker_id| into |connection_id|.
+  static void EncodeWorkerId(int worker_id, QuicConnectionId* connection_id) {
+    connection_id->mutable_data()[0] = static_cast<char>(worker_id);
+  }
+
+  // Returns the worker encoded in |connection_id|.
+  static int DecodeWorkerId(const QuicConnectionId& connection_id) {
+    return connection_id.IsEmpty()
+               ? -1
+               : static_cast<uint8_t>(connection_id.data()[0]);
+  }
+
+  // Records that |worker_id| owns |connection_id|. Returns false if the table
+  // is too full around the connection ID, in which case the connection ID is
+  // steered by its first byte only.
+  bool Register(const QuicConnectionId& connection_id, int worker_id) {
+    const uint64_t hash = Hash(connection_id);
+    const uint64_t entry =
+        (hash & kKeyMask) | static_cast<uint64_t>(worker_id + 1);
+    for (int i = 0; i < kMaxProbes; ++i) {
+      std::atomic<uint64_t>& slot = Slot(hash, i);
+      uint64_t current = slot.load(std::memory_order_acquire);
+      if ((current == kEmptyEntry || current == kRemovedEntry) &&
+          slot.compare_exchange_strong(current, entry,
+                                       std::memory_order_acq_rel)) {
+        return true;
+      }
+      if (current != kRemovedEntry &&
+          (current & kKeyMask) == (hash & kKeyMask)) {
+        slot.store(entry, std::memory_order_release);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Unregister(const QuicConnectionId& connection_id) {
+    const uint64_t hash = Hash(connection_id);
+    for (int i = 0; i < kMaxProbes; ++i) {
+      std::atomic<uint64_t>& slot = Slot(hash, i);
+      uint64_t current = slot.load(std::memory_order_acquire);
+      if (current == kEmptyEntry) {
+        return;
+      }
+      if (current != kRemovedEntry &&
+          (current & kKeyMask) == (hash & kKeyMask)) {
+        slot.compare_exchange_strong(current, kRemovedEntry,
+                                     std::memory_order_acq_rel);
+        return;
+      }
+    }
+  }
+
+  // Returns the worker that owns |connection_id|, or -1 if no worker does.
+  int GetOwner(const QuicConnectionId& connection_id) const {
+    const uint64_t hash = Hash(connection_id);
+    for (int i = 0; i < kMaxProbes; ++i) {
+      const uint64_t current = Slot(hash, i).load(std::memory_order_acquire);
+      if (current == kEmptyEntry) {
+        break;
+      }
+      if (current != kRemovedEntry &&
+          (current & kKeyMask) == (hash & kKeyMask)) {
+        return static_cast<int>(current & ~kKeyMask) - 1;
+      }
+    }
+    const int worker_id = DecodeWorkerId(connection_id);
+    return worker_id < num_workers_ ? worker_id : -1;
+  }
+
+  // Copies |packet| to the forwarding queue of |worker_id|. Returns false and
+  // drops the packet if the queue is full. Safe to call from any worker.
+  bool Forward(int worker_id,
+               const QuicSocketAddress& self_address,
+               const QuicSocketAddress& peer_address,
+               const QuicReceivedPacket& packet) {
+    if (packet.length() > kMaxIncomingPacketSize) {
+      return false;
+    }
+    Worker* worker = workers_[worker_id].get();
+    uint64_t position =
+        worker->enqueue_position.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &worker->cells[position & (kForwardingQueueSize - 1)];
+      const uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const int64_t difference =
+          static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+      if (difference == 0) {
+        if (worker->enqueue_position.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        worker->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        position = worker->enqueue_position.load(std::memory_order_relaxed);
+      }
+    }
+    cell->packet.self_address = self_address;
+    cell->packet.peer_address = peer_address;
+    cell->packet.receipt_time = packet.receipt_time();
+    cell->packet.length = packet.length();
+    memcpy(cell->packet.data, packet.data(), packet.length());
+    cell->sequence.store(position + 1, std::memory_order_release);
+
+    // Only the first packet after a drain wakes the worker up.
+    if (!worker->wakeup_pending.exchange(true, std::memory_order_acq_rel)) {
+      const uint64_t one = 1;
+      ssize_t rc = write(worker->wakeup_fd, &one, sizeof(one));
+      (void)rc;
+    }
+    return true;
+  }
+
+  // Hands the packets forwarded to |worker_id| to |visitor|, which is called
+  // as visitor(const ForwardedPacket&). Only called by the worker itself.
+  template <typename Visitor>
+  size_t Drain(int worker_id, Visitor visitor) {
+    Worker* worker = workers_[worker_id].get();
+    uint64_t value;
+    ssize_t rc = read(worker->wakeup_fd, &value, sizeof(value));
+    (void)rc;
+    // Cleared before draining, so packets queued from now on wake us again.
+    worker->wakeup_pending.store(false, std::memory_order_release);
+
+    size_t count = 0;
+    while (true) {
+      Cell& cell = worker->cells[worker->dequeue_position &
+                                 (kForwardingQueueSize - 1)];
+      if (cell.sequence.load(std::memory_order_acquire) !=
+          worker->dequeue_position + 1) {
+        break;
+      }
+      visitor(cell.packet);
+      cell.sequence.store(worker->dequeue_position + kForwardingQueueSize,
+                          std::memory_order_release);
+      ++worker->dequeue_position;
+      ++count;
+    }
+    return count;
+  }
+
+  // Returns the number of packets dropped because the queue of |worker_id|
+  // was full.
+  uint64_t packets_dropped(int worker_id) const {
+    return workers_[worker_id]->dropped.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Bounded multi-producer, single-consumer queue cell. |sequence| tells
+  // producers and the consumer whose turn it is.
+  struct Cell {
+    std::atomic<uint64_t> sequence;
+    ForwardedPacket packet;
+  };
+
+  struct Worker {
+    Worker() : wakeup_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+      for (uint64_t i = 0; i < kForwardingQueueSize; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    const int wakeup_fd;
+    std::atomic<bool> wakeup_pending{false};
+    std::atomic<uint64_t> dropped{0};
+    // Producers and the consumer on separate cache lines.
+    alignas(64) std::atomic<uint64_t> enqueue_position{0};
+    alignas(64) uint64_t dequeue_position = 0;
+    Cell cells[kForwardingQueueSize];
+  };
+
+  // Table entries hold the connection ID hash in the upper 56 bits and the
+  // worker ID + 1 in the low byte.
+  static const uint64_t kKeyMask = ~static_cast<uint64_t>(0xff);
+  static const uint64_t kEmptyEntry = 0;
+  static const uint64_t kRemovedEntry = 0xff;
+
+  static uint64_t Hash(const QuicConnectionId& connection_id) {
+    return QuicUtils::FNV1a_64_Hash(
+        absl::string_view(connection_id.data(), connection_id.length()));
+  }
+
+  std::atomic<uint64_t>& Slot(uint64_t hash, int probe) const {
+    return connection_id_table_[((hash >> 8) + probe) &
+                                (kConnectionIdTableSize - 1)];
+  }
+
+  const int num_workers_;
+  std::unique_ptr<std::atomic<uint64_t>[]> connection_id_table_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_CORE_QUIC_WORKER_STEERING_H_
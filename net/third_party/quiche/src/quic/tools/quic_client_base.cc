@@ -15,6 +15,7 @@
 #include <net/route.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <utility>
 
 #include "quic/core/crypto/quic_random.h"
 #include "quic/core/http/spdy_utils.h"
@@ -26,6 +27,11 @@
 #include "quic/platform/api/quic_logging.h"
 
 namespace quic {
+
+// [SD] Default delay between the connection attempts of Reconnect(), the
+// Connection Attempt Delay recommended by RFC 8305.
+const int64_t kDefaultRaceDelayMs = 250;
+
 // [SD] Address Change Alarm
 // class AddressChangeDelegate : public QuicAlarm::Delegate {
 //   public:
@@ -128,7 +134,14 @@ QuicClientBase::QuicClientBase(
       network_helper_(std::move(network_helper)),
       connection_debug_visitor_(nullptr),
       server_connection_id_length_(kQuicDefaultConnectionIdLength),
-      client_connection_id_length_(0) {
+      client_connection_id_length_(0),
+      route_table_synced_(false),
+      enable_route_monitor_(true),
+      route_monitor_started_(false),
+      enable_standby_paths_(false),
+      race_delay_(QuicTime::Delta::FromMilliseconds(kDefaultRaceDelayMs)),
+      next_race_time_(QuicTime::Zero()),
+      num_sessions_replaced_(0) {
         //address_change_alarm_ = absl::WrapUnique<QuicAlarm>(alarm_factory_->CreateAlarm(new AddressChangeDelegate(this)));
       }
 
@@ -170,25 +183,15 @@ QuicIpAddress IfaceToIp(std::string iface) {
   return ip;
 }
 
-// routing table search
-int QuicClientBase::OnNetworkUnreachable() {
-  if(!connected()) {
-    std::cout << "[quic_client_base] not connected.." << std::endl;
-    return 0;
-  }
-
-  // Find my new path address
+// [SD] Reads every default route in /proc/net/route and keeps the one with
+// the lowest metric. Only used when the route table is not monitored.
+bool ReadDefaultRouteFromProc(QuicClientBase::DefaultRoute* route) {
   FILE* rt_fp;
   in_addr gway;
   in_addr_t dest, mask;
   int flags, refcnt, use, metric, mtu, win, irtt;
-  char new_iface[64];
-  QuicIpAddress newIP, newGateway;
-
-  newIP = QuicIpAddress();
-  newGateway = QuicIpAddress();
+  char iface[64];
 
-  //std::cout << "[quic_toy_client] Searching... - " << timeStamp() - session()->connection()->GetHandoverStart() << " msec" << std::endl;
   if((rt_fp = fopen("/proc/net/route", "r")) == NULL) {
       perror("file open error");
       return false;
@@ -199,54 +202,149 @@ int QuicClientBase::OnNetworkUnreachable() {
       return false;
   }
 
-  int nread = fscanf(rt_fp, "%63s%X%X%X%d%d%d%X%d%d%d\n",
-                    new_iface, &dest, &gway.s_addr, &flags, &refcnt, &use, &metric, &mask,
-                    &mtu, &win, &irtt);
-  if (nread != 11) {
-      std::cout << "[quic_client_base] fail to read routing table.." << std::endl;
-      fclose(rt_fp);
-      return 0;
+  bool found = false;
+  while (fscanf(rt_fp, "%63s%X%X%X%d%d%d%X%d%d%d\n",
+                iface, &dest, &gway.s_addr, &flags, &refcnt, &use, &metric,
+                &mask, &mtu, &win, &irtt) == 11) {
+    if ((flags & (RTF_UP|RTF_GATEWAY)) != (RTF_UP|RTF_GATEWAY) || dest != 0) {
+      continue;
+    }
+    if (found && static_cast<uint32_t>(metric) >= route->metric) {
+      continue;
+    }
+    route->iface = iface;
+    route->gateway = QuicIpAddress(gway);
+    route->metric = metric;
+    found = true;
   }
   fclose(rt_fp);
 
-  if ((flags & (RTF_UP|RTF_GATEWAY)) == (RTF_UP|RTF_GATEWAY) && dest == 0) {
-    // new path address found
-    newIP = QuicIpAddress(IfaceToIp(std::string(new_iface)));
-    newGateway = QuicIpAddress(gway);
-    // current path set first
-    if(!current_path_gateway_.IsInitialized()) {
-      //std::cout << "[quic_client_base] set current path gateway with ip" << std::endl;
-      current_path_gateway_ = newGateway;
-      current_path_ip_ = newIP;
-      return 0;
-    } 
-    // same info found
-    if(newGateway == current_path_gateway_) {
-      //std::cout << "[quic_client_base] Same Gateway, so check IP. new: " << newGateway << " / cur: " << current_path_gateway_ << std::endl;
-      if(newIP == current_path_ip_) {
-        //std::cout << "[quic_client_base] Not Changed IP new: " << newIP << " / cur: " << current_path_ip_ << std::endl;
-        return 1;
-      }
+  if (found) {
+    route->host = IfaceToIp(route->iface);
+  }
+  return found;
+}
+
+// [SD] Picks the default route with the lowest metric among those whose
+// interface has an address.
+bool PickDefaultRoute(const std::vector<QuicClientBase::DefaultRoute>& routes,
+                      QuicClientBase::DefaultRoute* route) {
+  const QuicClientBase::DefaultRoute* best = nullptr;
+  for (const QuicClientBase::DefaultRoute& candidate : routes) {
+    // The route may show up before the address of its interface.
+    if (!candidate.host.IsInitialized()) {
+      continue;
     }
+    if (best == nullptr || candidate.metric < best->metric) {
+      best = &candidate;
+    }
+  }
+  if (best == nullptr) {
+    return false;
   }
-  
-  if(newGateway.ToString() == "") {
+  *route = *best;
+  return true;
+}
+
+bool QuicClientBase::LookupDefaultRoute(DefaultRoute* route) const {
+  if (route_table_synced_) {
+    return PickDefaultRoute(default_routes_, route);
+  }
+  std::vector<DefaultRoute> routes;
+  if (network_helper_->GetDefaultRoutes(&routes)) {
+    return PickDefaultRoute(routes, route);
+  }
+  return ReadDefaultRouteFromProc(route);
+}
+
+void QuicClientBase::SetNetworkGateway(const QuicIpAddress& self_host,
+                                       const QuicIpAddress& gateway) {
+  for (auto& network : network_gateways_) {
+    if (network.first == self_host) {
+      network.second = gateway;
+      return;
+    }
+  }
+  network_gateways_.push_back(std::make_pair(self_host, gateway));
+}
+
+QuicIpAddress QuicClientBase::GetNetworkGateway(
+    const QuicIpAddress& self_host) const {
+  for (const auto& network : network_gateways_) {
+    if (network.first == self_host) {
+      return network.second;
+    }
+  }
+  return QuicIpAddress();
+}
+
+// routing table search
+int QuicClientBase::OnNetworkUnreachable() {
+  if(!connected()) {
+    std::cout << "[quic_client_base] not connected.." << std::endl;
+    return 0;
+  }
+
+  // Find my new path address
+  DefaultRoute route;
+  if (!LookupDefaultRoute(&route)) {
     std::cout << "[quic_client_base] Fail to find new path in routing table" << std::endl;
     return 0;
   }
+  const QuicIpAddress& newIP = route.host;
+  const QuicIpAddress& newGateway = route.gateway;
+  // [SD] Identifies the network in the connection's path state cache.
+  SetNetworkGateway(newIP, newGateway);
+
+  // current path set first
+  if(!current_path_gateway_.IsInitialized()) {
+    current_path_gateway_ = newGateway;
+    current_path_ip_ = newIP;
+    return 0;
+  }
+  // same info found
+  if(newGateway == current_path_gateway_ && newIP == current_path_ip_) {
+    return 1;
+  }
 
-  std::cout << "[quic_client_base] Detected handover and Start connection migration to " << new_iface
-    << "(" << newIP << ") - " << timeStamp() - session()->connection()->GetHandoverStart() << " msec" << std::endl;
+  std::cout << "[quic_client_base] Detected handover and Start connection migration to " << route.iface
+    << "(" << newIP << ") - " << session()->connection()->GetTimeSinceHandoverStart().ToMilliseconds() << " msec" << std::endl;
   // [SD] migration start
   current_path_gateway_ = newGateway;
   current_path_ip_ = newIP;
+  if (MigrateToStandbyPath(newIP)) {
+    std::cout << "[quic_client_base] migrated to standby path - " <<
+        session()->connection()->GetTimeSinceHandoverStart().ToMilliseconds() << " msec" << std::endl;
+    return 2;
+  }
   std::cout << "[quic_client_base] validate and migration - " << 
-      timeStamp() - session()->connection()->GetHandoverStart() << " msec" << std::endl;
-    //ValidateAndMigrateSocket(QuicIpAddress::Any4());
+      session()->connection()->GetTimeSinceHandoverStart().ToMilliseconds() << " msec" << std::endl;
   ValidateAndMigrateSocket(newIP);
   return 2;
 }
 
+void QuicClientBase::OnDefaultRoutesChanged(std::vector<DefaultRoute> routes) {
+  default_routes_ = std::move(routes);
+  route_table_synced_ = true;
+  failed_standby_hosts_.clear();
+
+  if (!connected() || session()->GetHandshakeState() < HANDSHAKE_CONFIRMED) {
+    return;
+  }
+  QuicConnection* connection = session()->connection();
+  if (!connection->IsActiveCM()) {
+    return;
+  }
+  // [SD] The route change is seen before any write fails or the HDT alarm
+  // fires, so look up the new path now. The alarms stay armed as a fallback in
+  // case the kernel never reports the new route.
+  if (OnNetworkUnreachable() > 1) {
+    connection->CancelRLT();
+  }
+  PruneStandbyPaths();
+  MaybeValidateStandbyPaths();
+}
+
 // bool QuicClientBase::OnNetworkUnreachable() {
 //   if(!connected()) {
 //     return false;
@@ -254,7 +352,7 @@ int QuicClientBase::OnNetworkUnreachable() {
 
 //   // [SD] migration start
 //   std::cout << "[quic_client_base] validate and migration - " << 
-//     timeStamp() - session()->connection()->GetHandoverStart() << " msec" << std::endl;
+//     session()->connection()->GetTimeSinceHandoverStart().ToMilliseconds() << " msec" << std::endl;
 //   return ValidateAndMigrateSocket(QuicIpAddress::Any4());
 // }
 
@@ -282,10 +380,43 @@ bool QuicClientBase::Initialize() {
     return false;
   }
 
+  // [SD] The monitor outlives reconnects, so start it only once.
+  if (enable_route_monitor_ && !route_monitor_started_) {
+    route_monitor_started_ = network_helper_->StartRouteMonitor();
+  }
+
   initialized_ = true;
   return true;
 }
 
+bool QuicClientBase::Reconnect() {
+  if (initialized_) {
+    Disconnect();
+  }
+  const std::vector<DefaultRoute> routes = GetUsableDefaultRoutes();
+  if (!routes.empty()) {
+    set_bind_to_address(routes.front().host);
+  }
+  if (!Initialize()) {
+    return false;
+  }
+  session_self_address_ = network_helper_->GetLatestClientAddress();
+  if (race_delay_ > QuicTime::Delta::Zero() && routes.size() > 1) {
+    race_routes_.assign(routes.begin() + 1, routes.end());
+    next_race_time_ = helper_->GetClock()->ApproximateNow() + race_delay_;
+  }
+  Connect();
+  // The preferred route may fail before the race starts, e.g. if a write on
+  // it fails right away. Go on with the next ones.
+  while (!connected() && !race_routes_.empty()) {
+    MaybeRaceNextRoute();
+    while (EncryptionBeingEstablished()) {
+      WaitForEvents();
+    }
+  }
+  return connected();
+}
+
 bool QuicClientBase::Connect() {
   // Attempt multiple connects until the maximum number of client hellos have
   // been sent.
@@ -374,6 +505,15 @@ void QuicClientBase::InitializeSession() {
 void QuicClientBase::Disconnect() {
   QUICHE_DCHECK(initialized_);
 
+  CancelRace();
+
+  // [SD] Standby paths belong to the connection being closed. Their sockets
+  // are left open by CleanUpAllUDPSockets().
+  for (const auto& context : validated_paths_) {
+    network_helper_->CleanUpUDPSocket(context->self_address());
+  }
+  validated_paths_.clear();
+
   initialized_ = false;
   if (connected()) {
     session()->connection()->CloseConnection(
@@ -405,6 +545,8 @@ bool QuicClientBase::WaitForEvents() {
   }
 
   network_helper_->RunEventLoop();
+  MaybeRaceNextRoute();
+  MaybeValidateStandbyPaths();
 
   QUICHE_DCHECK(session() != nullptr);
   ParsedQuicVersion version = UnsupportedQuicVersion();
@@ -492,6 +634,17 @@ std::unique_ptr<QuicPacketWriter> QuicClientBase::CreateWriterForNewNetwork(
   return std::unique_ptr<QuicPacketWriter>(writer);
 }
 
+std::unique_ptr<QuicPacketWriter> QuicClientBase::CreateWriterForStandbyPath(
+    const QuicIpAddress& host,
+    QuicSocketAddress* self_address) {
+  // Unlike CreateWriterForNewNetwork(), keep |bind_to_address_| and the
+  // latest socket of the network helper on the current path until the client
+  // actually migrates.
+  return std::unique_ptr<QuicPacketWriter>(
+      network_helper_->CreateStandbyUDPSocket(server_address_, host,
+                                              local_port_, self_address));
+}
+
 bool QuicClientBase::ChangeEphemeralPort() {
   auto current_host = network_helper_->GetLatestClientAddress().host();
   return MigrateSocketWithSpecifiedPort(current_host, 0 /*any ephemeral port*/);
@@ -505,6 +658,29 @@ const QuicSession* QuicClientBase::session() const {
   return session_.get();
 }
 
+QuicSession* QuicClientBase::GetSessionForSelfAddress(
+    const QuicSocketAddress& self_address) {
+  for (RaceAttempt& attempt : race_attempts_) {
+    if (attempt.self_address == self_address) {
+      return attempt.session.get();
+    }
+  }
+  return session_.get();
+}
+
+void QuicClientBase::StartTransportMetrics(QuicTime::Delta interval) {
+  metrics_sampler_ = std::make_unique<QuicTransportMetricsSampler>(
+      this, helper_->GetClock(), alarm_factory_.get(), interval,
+      /* worker= */ 0);
+  metrics_sampler_->Start();
+}
+
+void QuicClientBase::SampleConnections(QuicTransportMetricsSampler* sampler) {
+  if (session_ != nullptr && session_->connection()->connected()) {
+    sampler->Sample(session_->connection());
+  }
+}
+
 QuicClientBase::NetworkHelper* QuicClientBase::network_helper() {
   return network_helper_.get();
 }
@@ -658,6 +834,128 @@ class ValidationResultDelegate : public QuicPathValidator::ResultDelegate {
   QuicClientBase* client_;
 };
 
+// [SD] Keeps a validated standby path in the client until a handover needs
+// it.
+class StandbyPathValidationResultDelegate
+    : public QuicPathValidator::ResultDelegate {
+ public:
+  StandbyPathValidationResultDelegate(QuicClientBase* client)
+      : QuicPathValidator::ResultDelegate(), client_(client) {}
+
+  void OnPathValidationSuccess(
+      std::unique_ptr<QuicPathValidationContext> context) override {
+    QUIC_DLOG(INFO) << "Standby path " << *context << " is validated";
+    client_->AddValidatedPath(std::move(context));
+  }
+
+  void OnPathValidationFailure(
+      std::unique_ptr<QuicPathValidationContext> context) override {
+    // Unlike a failed migration, this leaves the connection alone: its
+    // alternative path may be the one a migration is about to use.
+    QUIC_LOG(WARNING) << "Fail to validate standby path " << *context;
+    client_->OnStandbyPathValidationFailure(context->self_address());
+  }
+
+ private:
+  QuicClientBase* client_;
+};
+
+void QuicClientBase::MaybeValidateStandbyPaths() {
+  // The connection keeps one validated alternative path, so validating a
+  // second standby path would invalidate the first.
+  if (!enable_standby_paths_ || !route_table_synced_ || !connected() ||
+      session()->GetHandshakeState() < HANDSHAKE_CONFIRMED ||
+      HasPendingPathValidation() || !validated_paths_.empty()) {
+    return;
+  }
+  QuicConnection* connection = session()->connection();
+  // Stay out of the way of a handover: a migration is in progress until the
+  // connection runs on the path picked by the last lookup.
+  if (connection->IsSetRLT() ||
+      connection->self_address().host() != current_path_ip_) {
+    return;
+  }
+
+  // Routes with the lowest metric first.
+  for (const DefaultRoute& route : GetUsableDefaultRoutes()) {
+    if (route.host == current_path_ip_) {
+      continue;
+    }
+    if (std::find(failed_standby_hosts_.begin(), failed_standby_hosts_.end(),
+                  route.host) != failed_standby_hosts_.end()) {
+      continue;
+    }
+
+    // The path validator runs one validation at a time. If this one fails,
+    // the next route is tried.
+    QuicSocketAddress self_address;
+    std::unique_ptr<QuicPacketWriter> writer =
+        CreateWriterForStandbyPath(route.host, &self_address);
+    if (writer == nullptr) {
+      failed_standby_hosts_.push_back(route.host);
+      continue;
+    }
+    std::cout << "[quic_client_base] Validate standby path " << route.iface
+              << "(" << route.host << ")" << std::endl;
+    session()->ValidatePath(
+        std::make_unique<PathMigrationContext>(
+            std::move(writer), self_address, session_->peer_address()),
+        std::make_unique<StandbyPathValidationResultDelegate>(this));
+    return;
+  }
+}
+
+void QuicClientBase::OnStandbyPathValidationFailure(
+    const QuicSocketAddress& self_address) {
+  failed_standby_hosts_.push_back(self_address.host());
+  network_helper_->CleanUpUDPSocket(self_address);
+}
+
+bool QuicClientBase::MigrateToStandbyPath(const QuicIpAddress& new_host) {
+  auto it = std::find_if(validated_paths_.begin(), validated_paths_.end(),
+                         [&new_host](const auto& context) {
+                           return context->self_address().host() == new_host;
+                         });
+  if (it == validated_paths_.end()) {
+    return false;
+  }
+  auto migration_context = std::unique_ptr<PathMigrationContext>(
+      static_cast<PathMigrationContext*>(it->release()));
+  validated_paths_.erase(it);
+
+  if (!session()->MigratePath(migration_context->self_address(),
+                              migration_context->peer_address(),
+                              migration_context->WriterToUse(),
+                              /*owns_writer=*/false)) {
+    network_helper_->CleanUpUDPSocket(migration_context->self_address());
+    return false;
+  }
+  // Hand the ownership of the standby writer to the client, as after a
+  // regular path validation.
+  set_writer(migration_context->ReleaseWriter());
+  network_helper_->ActivateUDPSocket(migration_context->self_address());
+  set_bind_to_address(new_host);
+  return true;
+}
+
+void QuicClientBase::PruneStandbyPaths() {
+  for (auto it = validated_paths_.begin(); it != validated_paths_.end();) {
+    const QuicIpAddress host = (*it)->self_address().host();
+    const bool usable =
+        host != current_path_ip_ &&
+        std::any_of(default_routes_.begin(), default_routes_.end(),
+                    [&host](const DefaultRoute& route) {
+                      return route.host == host;
+                    });
+    if (usable) {
+      ++it;
+      continue;
+    }
+    network_helper_->CleanUpUDPSocket((*it)->self_address());
+    it = validated_paths_.erase(it);
+  }
+}
+
 void QuicClientBase::ValidateNewNetwork(const QuicIpAddress& host) {
   std::unique_ptr<QuicPacketWriter> writer =
       CreateWriterForNewNetwork(host, local_port_);
@@ -676,4 +974,158 @@ void QuicClientBase::ValidateNewNetwork(const QuicIpAddress& host) {
       std::move(result_delegate));
 }
 
+// [SD] True once |session| processed a packet from the server, i.e. its
+// network works.
+bool HasHeardFromServer(QuicSession* session) {
+  return session->connection()->connected() &&
+         session->connection()->GetStats().packets_processed > 0;
+}
+
+std::vector<QuicClientBase::DefaultRoute>
+QuicClientBase::GetUsableDefaultRoutes() const {
+  std::vector<DefaultRoute> routes;
+  if (route_table_synced_) {
+    routes = default_routes_;
+  } else if (!network_helper_->GetDefaultRoutes(&routes)) {
+    DefaultRoute route;
+    if (ReadDefaultRouteFromProc(&route)) {
+      routes.push_back(route);
+    }
+  }
+  std::stable_sort(routes.begin(), routes.end(),
+                   [](const DefaultRoute& a, const DefaultRoute& b) {
+                     return a.metric < b.metric;
+                   });
+  std::vector<DefaultRoute> usable_routes;
+  for (const DefaultRoute& route : routes) {
+    if (!route.host.IsInitialized() ||
+        std::any_of(usable_routes.begin(), usable_routes.end(),
+                    [&route](const DefaultRoute& usable_route) {
+                      return usable_route.host == route.host;
+                    })) {
+      continue;
+    }
+    usable_routes.push_back(route);
+  }
+  return usable_routes;
+}
+
+void QuicClientBase::MaybeRaceNextRoute() {
+  if (race_attempts_.empty() && race_routes_.empty()) {
+    return;
+  }
+  // The first connection the server answers wins, the session on a tie.
+  if (connected() && HasHeardFromServer(session())) {
+    CancelRace();
+    return;
+  }
+  for (size_t i = 0; i < race_attempts_.size(); ++i) {
+    if (HasHeardFromServer(race_attempts_[i].session.get())) {
+      TakeOverRaceAttempt(i);
+      CancelRace();
+      return;
+    }
+  }
+
+  const QuicTime now = helper_->GetClock()->ApproximateNow();
+  if (!race_routes_.empty() && (!connected() || now >= next_race_time_)) {
+    const DefaultRoute route = race_routes_.front();
+    race_routes_.erase(race_routes_.begin());
+    next_race_time_ = now + race_delay_;
+    StartRaceAttempt(route);
+  }
+  if (connected()) {
+    return;
+  }
+  // The session failed, e.g. its network is gone. A live attempt takes its
+  // place while the race goes on.
+  for (size_t i = 0; i < race_attempts_.size(); ++i) {
+    if (race_attempts_[i].session->connection()->connected()) {
+      TakeOverRaceAttempt(i);
+      return;
+    }
+  }
+}
+
+bool QuicClientBase::StartRaceAttempt(const DefaultRoute& route) {
+  RaceAttempt attempt;
+  // A standby socket, so that the session keeps the latest socket while the
+  // race goes on.
+  std::unique_ptr<QuicPacketWriter> writer =
+      CreateWriterForStandbyPath(route.host, &attempt.self_address);
+  if (writer == nullptr) {
+    return false;
+  }
+  std::cout << "[quic_client_base] Race a connection attempt on "
+            << route.iface << "(" << route.host << ")" << std::endl;
+  attempt.route = route;
+  attempt.writer = std::move(writer);
+  attempt.session = CreateQuicClientSession(
+      supported_versions(),
+      new QuicConnection(GetNextConnectionId(), QuicSocketAddress(),
+                         server_address(), helper(), alarm_factory(),
+                         attempt.writer.get(),
+                         /* owns_writer= */ false, Perspective::IS_CLIENT,
+                         supported_versions()));
+  QuicConnection* connection = attempt.session->connection();
+  if (connection_debug_visitor_ != nullptr) {
+    connection->set_debug_visitor(connection_debug_visitor_);
+  }
+  connection->set_client_connection_id(GetClientConnectionId());
+  if (initial_max_packet_length_ != 0) {
+    connection->SetMaxPacketLength(initial_max_packet_length_);
+  }
+  // InitializeSession() starts |session_|, so the attempt stands in for it
+  // meanwhile. The client base visitor is only set on takeover, handover
+  // handling acts on |session_|.
+  session_.swap(attempt.session);
+  InitializeSession();
+  session_.swap(attempt.session);
+  race_attempts_.push_back(std::move(attempt));
+  return true;
+}
+
+void QuicClientBase::TakeOverRaceAttempt(size_t index) {
+  RaceAttempt attempt = std::move(race_attempts_[index]);
+  race_attempts_.erase(race_attempts_.begin() + index);
+  std::cout << "[quic_client_base] Connection attempt on "
+            << attempt.route.iface << "(" << attempt.route.host
+            << ") takes over" << std::endl;
+  if (connected()) {
+    session()->connection()->CloseConnection(
+        QUIC_PEER_GOING_AWAY, "Lost the connection race",
+        ConnectionCloseBehavior::SEND_CONNECTION_CLOSE_PACKET);
+  }
+  UpdateStats();
+  // The old writer outlives the old session, as in StartConnect().
+  session_ = std::move(attempt.session);
+  set_writer(attempt.writer.release());
+  network_helper_->CleanUpUDPSocket(session_self_address_);
+  // The attempt ran on a standby socket, which only now becomes the latest
+  // one that the client address and port changes refer to.
+  network_helper_->ActivateUDPSocket(attempt.self_address);
+  session_self_address_ = attempt.self_address;
+  ++num_sessions_replaced_;
+
+  set_bind_to_address(attempt.route.host);
+  current_path_ip_ = attempt.route.host;
+  current_path_gateway_ = attempt.route.gateway;
+  QuicConnection* connection = session()->connection();
+  connection->set_client_base_visitor(this);
+  SetNetworkGateway(attempt.route.host, attempt.route.gateway);
+}
+
+void QuicClientBase::CancelRace() {
+  for (RaceAttempt& attempt : race_attempts_) {
+    if (attempt.session->connection()->connected()) {
+      attempt.session->connection()->CloseConnection(
+          QUIC_PEER_GOING_AWAY, "Lost the connection race",
+          ConnectionCloseBehavior::SEND_CONNECTION_CLOSE_PACKET);
+    }
+    network_helper_->CleanUpUDPSocket(attempt.self_address);
+  }
+  race_attempts_.clear();
+  race_routes_.clear();
+}
+
 }  // namespace quic
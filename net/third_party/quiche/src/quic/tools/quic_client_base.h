@@ -10,6 +10,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/strings/string_view.h"
@@ -18,6 +19,7 @@
 #include "quic/core/http/quic_spdy_client_session.h"
 #include "quic/core/http/quic_spdy_client_stream.h"
 #include "quic/core/quic_config.h"
+#include "quic/core/quic_transport_metrics.h"
 #include "quic/platform/api/quic_socket_address.h"
 
 namespace quic {
@@ -32,9 +34,12 @@ class SessionCache;
 // Subclasses derived from this class are responsible for creating the
 // actual QuicSession instance, as well as defining functions that
 // create and run the underlying network transport.
-class QuicClientBase : public QuicClientBaseVisitorInterface 
+class QuicClientBase : public QuicClientBaseVisitorInterface,
+                       public QuicTransportMetricsSampler::Delegate
 {
  public:
+  struct DefaultRoute;
+
   // An interface to various network events that the QuicClient will need to
   // interact with.
   class NetworkHelper {
@@ -59,6 +64,52 @@ class QuicClientBase : public QuicClientBaseVisitorInterface
 
     // Creates a packet writer to be used for the next connection.
     virtual QuicPacketWriter* CreateQuicPacketWriter() = 0;
+
+    // [SD] Starts following kernel route and address changes. The helper
+    // reports the resulting default routes through
+    // QuicClientBase::OnDefaultRoutesChanged(). Returns false if route
+    // monitoring is not supported, in which case the client reads
+    // /proc/net/route on every lookup.
+    virtual bool StartRouteMonitor() { return false; }
+
+    // [SD] Fills |routes| with the current default routes and returns true if
+    // the helper provides its own route table. Consulted by route lookups
+    // while the route table is not monitored. Returns false by default, in
+    // which case /proc/net/route is read.
+    virtual bool GetDefaultRoutes(std::vector<DefaultRoute>* /*routes*/) const {
+      return false;
+    }
+
+    // [SD] Unregisters and closes the UDP socket bound to |self_address|, if
+    // any. Used to drop standby paths that are no longer usable.
+    virtual void CleanUpUDPSocket(const QuicSocketAddress& /*self_address*/) {}
+
+    // [SD] Like CreateUDPSocketAndBind(), for a socket the session does not
+    // use yet, e.g. a standby path. The socket does not become the latest
+    // one and CleanUpAllUDPSockets() leaves it open, it is closed by
+    // CleanUpUDPSocket(). Returns a writer on it and sets |self_address|, or
+    // returns nullptr if standby sockets are not supported or the socket
+    // could not be bound.
+    virtual QuicPacketWriter* CreateStandbyUDPSocket(
+        QuicSocketAddress /*server_address*/,
+        QuicIpAddress /*bind_to_address*/,
+        int /*bind_to_port*/,
+        QuicSocketAddress* /*self_address*/) {
+      return nullptr;
+    }
+
+    // [SD] Makes the socket bound to |self_address| the latest one, once the
+    // session moved to it. It is then closed by CleanUpAllUDPSockets().
+    virtual void ActivateUDPSocket(const QuicSocketAddress& /*self_address*/) {}
+  };
+
+  // [SD] A default route, and the address of its output interface.
+  struct DefaultRoute {
+    std::string iface;
+    QuicIpAddress gateway;
+    // Uninitialized if the interface has no IPv4 address yet.
+    QuicIpAddress host;
+    uint32_t metric = 0;
   };
 
   QuicClientBase(const QuicServerId& server_id,
@@ -76,12 +127,48 @@ class QuicClientBase : public QuicClientBaseVisitorInterface
 
   // QuicClientBaseVisitorInterface methods:
   int OnNetworkUnreachable() override;
+  QuicIpAddress GetNetworkGateway(
+      const QuicIpAddress& self_host) const override;
+
+  // [SD] Replaces the known default routes. Called by the network helper when
+  // the kernel reports a route or address change. If connection migration is
+  // active and the best default route moved to another network, migration
+  // starts right away instead of waiting for the HDT/RLT alarms.
+  void OnDefaultRoutesChanged(std::vector<DefaultRoute> routes);
 
   // Initializes the client to create a connection. Should be called exactly
   // once before calling StartConnect or Connect. Returns true if the
   // initialization succeeds, false otherwise.
   virtual bool Initialize();
 
+  // [SD] Replaces a connection that could not be migrated with a new one.
+  // The connection attempt on the preferred default route starts right away.
+  // While the server has answered none of them, another attempt starts on
+  // the next default route every race delay, and the first attempt the
+  // server answers is kept (happy eyeballs, RFC 8305). Returns true if
+  // connected.
+  bool Reconnect();
+
+  // [SD] Delay between the connection attempts of Reconnect(). Zero disables
+  // racing.
+  void set_race_delay(QuicTime::Delta race_delay) { race_delay_ = race_delay; }
+
+  // [SD] Number of times a connection attempt on another default route took
+  // over from the session. Requests open on the session at that moment are
+  // closed with it and have to be sent again.
+  int num_sessions_replaced() const { return num_sessions_replaced_; }
+
+  // [SD] Returns the session of the connection attempt bound to
+  // |self_address|, or session() if there is none.
+  QuicSession* GetSessionForSelfAddress(const QuicSocketAddress& self_address);
+
+  // [SD] Samples the transport metrics of the session every |interval| on
+  // this client's event loop, see QuicTransportMetricsSampler.
+  void StartTransportMetrics(QuicTime::Delta interval);
+
+  // QuicTransportMetricsSampler::Delegate
+  void SampleConnections(QuicTransportMetricsSampler* sampler) override;
+
   // "Connect" to the QUIC server, including performing synchronous crypto
   // handshake.
   bool Connect();
@@ -242,6 +329,12 @@ class QuicClientBase : public QuicClientBaseVisitorInterface
 
   int local_port() const { return local_port_; }
 
+  // [SD] If true, Initialize() asks the network helper to monitor route
+  // changes. Must be set before Initialize().
+  void set_enable_route_monitor(bool enable_route_monitor) {
+    enable_route_monitor_ = enable_route_monitor;
+  }
+
   const QuicSocketAddress& server_address() const { return server_address_; }
 
   void set_server_address(const QuicSocketAddress& server_address) {
@@ -284,6 +377,24 @@ class QuicClientBase : public QuicClientBaseVisitorInterface
   validated_paths() const {
     return validated_paths_;
   }
+
+  // [SD] If true, the preferred default route other than the current one is
+  // validated ahead of time and kept as a standby path, so that a handover to
+  // it migrates without waiting for a PATH_CHALLENGE round trip. There is one
+  // standby path at a time: the connection keeps the validated state and the
+  // peer connection ID of a single alternative path, and validating another
+  // one would replace them. Requires the route monitor.
+  void set_enable_standby_paths(bool enable_standby_paths) {
+    enable_standby_paths_ = enable_standby_paths;
+  }
+
+  // [SD] Starts validating the preferred default route if there is no standby
+  // path. Does nothing while a path validation or a handover is in progress.
+  void MaybeValidateStandbyPaths();
+
+  // [SD] Called when the validation of the standby path on |self_address|
+  // failed or was cancelled.
+  void OnStandbyPathValidationFailure(const QuicSocketAddress& self_address);
     
   int ho_count = 0;
   uint64_t last_psn = 0;
@@ -339,20 +450,79 @@ class QuicClientBase : public QuicClientBaseVisitorInterface
   // Subclasses may need to explicitly clear the session on destruction
   // if they create it with objects that will be destroyed before this is.
   // You probably want to call this if you override CreateQuicSpdyClientSession.
-  void ResetSession() { session_.reset(); }
+  // [SD] Sessions of connection attempts are cleared as well.
+  void ResetSession() {
+    race_attempts_.clear();
+    session_.reset();
+  }
 
   // Returns true if the corresponding of this client has active requests.
   virtual bool HasActiveRequests() = 0;
 
  private:
+  // [SD] A connection attempt of Reconnect() racing the session on another
+  // default route.
+  struct RaceAttempt {
+    DefaultRoute route;
+    QuicSocketAddress self_address;
+    // Declared before |session| so that it outlives it.
+    std::unique_ptr<QuicPacketWriter> writer;
+    std::unique_ptr<QuicSession> session;
+  };
+
   // Returns true and set |version| if client can reconnect with a different
   // version.
   bool CanReconnectWithDifferentVersion(ParsedQuicVersion* version) const;
 
+  // [SD] Returns the default routes whose interface has an address, one per
+  // address, the preferred one first.
+  std::vector<DefaultRoute> GetUsableDefaultRoutes() const;
+
+  // [SD] Runs the connection race of Reconnect() after every event loop
+  // iteration: ends it once the server answers, and starts the attempt on
+  // the next default route when the race delay passed or the session failed.
+  void MaybeRaceNextRoute();
+
+  // [SD] Starts a connection attempt on |route|. Returns false if no socket
+  // could be bound on it.
+  bool StartRaceAttempt(const DefaultRoute& route);
+
+  // [SD] Closes the session and makes the connection attempt at |index| the
+  // session.
+  void TakeOverRaceAttempt(size_t index);
+
+  // [SD] Closes the connection attempts that did not take over and ends the
+  // race.
+  void CancelRace();
+
   std::unique_ptr<QuicPacketWriter> CreateWriterForNewNetwork(
       const QuicIpAddress& new_host,
       int port);
 
+  // [SD] Opens a standby socket on |host| for a standby path and returns its
+  // writer. Sets |self_address| to the address of the socket.
+  std::unique_ptr<QuicPacketWriter> CreateWriterForStandbyPath(
+      const QuicIpAddress& host,
+      QuicSocketAddress* self_address);
+
+  // [SD] Finds the default route with the lowest metric, from the monitored
+  // route table if available and from /proc/net/route otherwise.
+  bool LookupDefaultRoute(DefaultRoute* route) const;
+
+  // [SD] Records |gateway| as the default gateway of the network that
+  // |self_host| is on. Together they identify the network in the path state
+  // cache of the sent packet manager.
+  void SetNetworkGateway(const QuicIpAddress& self_host,
+                         const QuicIpAddress& gateway);
+
+  // [SD] Migrates to the standby path on |new_host| if one has been validated.
+  // Returns false if there is none or the migration failed.
+  bool MigrateToStandbyPath(const QuicIpAddress& new_host);
+
+  // [SD] Closes the standby paths whose host is no longer the address of a
+  // default route, or is the current path.
+  void PruneStandbyPaths();
+
   // |server_id_| is a tuple (hostname, port, is_https) of the server.
   QuicServerId server_id_;
 
@@ -430,6 +600,38 @@ class QuicClientBase : public QuicClientBaseVisitorInterface
 
   // [SD] store addresses.
   QuicIpAddress fromip_, toip_, current_path_gateway_, current_path_ip_;
+
+  // [SD] Self host and default gateway of every network a lookup found. Kept
+  // here rather than in the connection, which would have to allocate its
+  // handover controller for them.
+  std::vector<std::pair<QuicIpAddress, QuicIpAddress>> network_gateways_;
+
+  // [SD] Default routes reported by the network helper.
+  std::vector<DefaultRoute> default_routes_;
+  // True once the network helper reported the route table at least once.
+  bool route_table_synced_;
+  bool enable_route_monitor_;
+  bool route_monitor_started_;
+
+  // [SD] Standby paths are kept in |validated_paths_|.
+  bool enable_standby_paths_;
+  // Hosts whose standby validation failed since the last route change. They
+  // are not retried until the routes change again.
+  std::vector<QuicIpAddress> failed_standby_hosts_;
+
+  // [SD] Connection race of Reconnect().
+  QuicTime::Delta race_delay_;
+  // Routes left to race on, the next one first.
+  std::vector<DefaultRoute> race_routes_;
+  QuicTime next_race_time_;
+  // Address of the socket the session was started on.
+  QuicSocketAddress session_self_address_;
+  int num_sessions_replaced_;
+  // [SD] Set by StartTransportMetrics().
+  std::unique_ptr<QuicTransportMetricsSampler> metrics_sampler_;
+  // Declared last so that the attempts are destroyed before |helper_| and
+  // |alarm_factory_|.
+  std::vector<RaceAttempt> race_attempts_;
 };
 
 }  // namespace quic
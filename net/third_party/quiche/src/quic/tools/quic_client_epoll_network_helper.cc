@@ -5,12 +5,20 @@
 #include "quic/tools/quic_client_epoll_network_helper.h"
 
 #include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
+
+#include <algorithm>
 #include <iostream>
+#include <vector>
 
 #include "quic/core/crypto/quic_random.h"
 #include "quic/core/http/spdy_utils.h"
@@ -29,17 +37,42 @@ namespace quic {
 
 namespace {
 const int kEpollFlags = EPOLLIN | EPOLLOUT | EPOLLET;
+
+// Large enough for a full rtnetlink dump chunk.
+const size_t kRouteBufferSize = 8192;
+
+// Largest datagram UDP_GRO hands to recvmsg().
+const size_t kMaxCoalescedDatagramSize = 64 * 1024;
+
+// Room for the control messages QuicUdpSocketApi enables on the socket
+// (dropped packet count, self IP, receive timestamp) plus the UDP_GRO one.
+const size_t kCoalescedControlBufferSize =
+    kDefaultUdpPacketControlBufferSize + CMSG_SPACE(sizeof(int));
+
+// Asks the kernel to coalesce back-to-back datagrams of the same flow into
+// one read. Returns false if the kernel does not support UDP_GRO.
+bool EnableUdpGro(int fd) {
+#if defined(UDP_GRO)
+  int enable = 1;
+  return setsockopt(fd, IPPROTO_UDP, UDP_GRO, &enable, sizeof(enable)) == 0;
+#else
+  (void)fd;
+  return false;
+#endif
+}
 }  // namespace
 
 QuicClientEpollNetworkHelper::QuicClientEpollNetworkHelper(
     QuicEpollServer* epoll_server,
     QuicClientBase* client)
     : epoll_server_(epoll_server),
+      active_fd_(-1),
       packets_dropped_(0),
       overflow_supported_(false),
       packet_reader_(new QuicPacketReader()),
       client_(client),
-      max_reads_per_epoll_loop_(std::numeric_limits<int>::max()) {}
+      max_reads_per_epoll_loop_(std::numeric_limits<int>::max()),
+      route_fd_(-1) {}
 
 QuicClientEpollNetworkHelper::~QuicClientEpollNetworkHelper() {
   if (client_->connected()) {
@@ -49,6 +82,14 @@ QuicClientEpollNetworkHelper::~QuicClientEpollNetworkHelper() {
   }
 
   CleanUpAllUDPSockets();
+  while (!standby_fds_.empty()) {
+    CleanUpUDPSocket(*standby_fds_.begin());
+  }
+
+  if (route_fd_ > -1) {
+    epoll_server_->UnregisterFD(route_fd_);
+    close(route_fd_);
+  }
 }
 
 std::string QuicClientEpollNetworkHelper::Name() const {
@@ -61,10 +102,49 @@ bool QuicClientEpollNetworkHelper::CreateUDPSocketAndBind(
     int bind_to_port) {
   epoll_server_->set_timeout_in_us(50 * 1000);
 
-  int fd = CreateUDPSocket(server_address, &overflow_supported_);
+  int fd = CreateAndBindUDPSocket(server_address, bind_to_address,
+                                  bind_to_port);
   if (fd < 0) {
     return false;
   }
+  active_fd_ = fd;
+  return true;
+}
+
+QuicPacketWriter* QuicClientEpollNetworkHelper::CreateStandbyUDPSocket(
+    QuicSocketAddress server_address,
+    QuicIpAddress bind_to_address,
+    int bind_to_port,
+    QuicSocketAddress* self_address) {
+  int fd = CreateAndBindUDPSocket(server_address, bind_to_address,
+                                  bind_to_port);
+  if (fd < 0) {
+    return nullptr;
+  }
+  standby_fds_.insert(fd);
+  *self_address = fd_address_map_[fd];
+  return new QuicDefaultPacketWriter(fd);
+}
+
+void QuicClientEpollNetworkHelper::ActivateUDPSocket(
+    const QuicSocketAddress& self_address) {
+  for (const std::pair<int, QuicSocketAddress> fd_address : fd_address_map_) {
+    if (fd_address.second == self_address) {
+      standby_fds_.erase(fd_address.first);
+      active_fd_ = fd_address.first;
+      return;
+    }
+  }
+}
+
+int QuicClientEpollNetworkHelper::CreateAndBindUDPSocket(
+    QuicSocketAddress server_address,
+    QuicIpAddress bind_to_address,
+    int bind_to_port) {
+  int fd = CreateUDPSocket(server_address, &overflow_supported_);
+  if (fd < 0) {
+    return -1;
+  }
 
   QuicSocketAddress client_address;
   if (bind_to_address.IsInitialized()) {
@@ -99,7 +179,8 @@ bool QuicClientEpollNetworkHelper::CreateUDPSocketAndBind(
                     << " bind_to_address:" << bind_to_address
                     << ", bind_to_port:" << bind_to_port
                     << ", client_address:" << client_address;
-    return false;
+    close(fd);
+    return -1;
   }
 
 
@@ -110,7 +191,7 @@ bool QuicClientEpollNetworkHelper::CreateUDPSocketAndBind(
   if(connect(fd, (struct sockaddr *)&testaddr, sizeof(testaddr)) < 0) {
     perror("[quic_client_epoll_network_helper] Fail connect()");
     close(fd);
-    return false; 
+    return -1;
   }
 
   if (client_address.FromSocket(fd) != 0) {
@@ -127,23 +208,45 @@ bool QuicClientEpollNetworkHelper::CreateUDPSocketAndBind(
   getsockname(fd, (struct sockaddr*)&testaddr, &slen);
   //std::cout << "[quic_client_epoll_network_helper] Client address: " << inet_ntoa(testaddr.sin_addr) << std::endl;
     
-  return true;
+  return fd;
 }
 
 void QuicClientEpollNetworkHelper::CleanUpUDPSocket(int fd) {
   CleanUpUDPSocketImpl(fd);
   fd_address_map_.erase(fd);
+  standby_fds_.erase(fd);
+  if (fd == active_fd_) {
+    active_fd_ = -1;
+  }
+}
+
+void QuicClientEpollNetworkHelper::CleanUpUDPSocket(
+    const QuicSocketAddress& self_address) {
+  for (const std::pair<int, QuicSocketAddress> fd_address : fd_address_map_) {
+    if (fd_address.second == self_address) {
+      CleanUpUDPSocket(fd_address.first);
+      return;
+    }
+  }
 }
 
 void QuicClientEpollNetworkHelper::CleanUpAllUDPSockets() {
-  for (std::pair<int, QuicSocketAddress> fd_address : fd_address_map_) {
-    CleanUpUDPSocketImpl(fd_address.first);
+  // [SD] Standby sockets are still held by standby paths or connection
+  // attempts, which close them with CleanUpUDPSocket().
+  for (auto it = fd_address_map_.begin(); it != fd_address_map_.end();) {
+    if (standby_fds_.count(it->first) > 0) {
+      ++it;
+      continue;
+    }
+    CleanUpUDPSocketImpl(it->first);
+    it = fd_address_map_.erase(it);
   }
-  fd_address_map_.clear();
+  active_fd_ = -1;
 }
 
 void QuicClientEpollNetworkHelper::CleanUpUDPSocketImpl(int fd) {
   if (fd > -1) {
+    gro_fds_.erase(fd);
     epoll_server_->UnregisterFD(fd);
     int rc = close(fd);
     QUICHE_DCHECK_EQ(0, rc);
@@ -167,15 +270,33 @@ void QuicClientEpollNetworkHelper::OnShutdown(QuicEpollServer* /*eps*/,
                                               int /*fd*/) {}
 
 void QuicClientEpollNetworkHelper::OnEvent(int fd, QuicEpollEvent* event) {
+  if (fd == route_fd_) {
+    if (event->in_events & EPOLLIN) {
+      ReadRouteMessages();
+    }
+    return;
+  }
   if (event->in_events & EPOLLIN) {
     QUIC_DVLOG(1) << "Read packets on EPOLLIN";
     int times_to_read = max_reads_per_epoll_loop_;
     bool more_to_read = true;
     QuicPacketCount packets_dropped = 0;
+    // [SD] Several sockets can be open at once (old path, standby paths), so
+    // use the port of the socket that is readable, not of the latest one.
+    auto fd_address = fd_address_map_.find(fd);
+    const QuicSocketAddress self_address =
+        fd_address != fd_address_map_.end() ? fd_address->second
+                                            : GetLatestClientAddress();
+    const int port = self_address.port();
     while (client_->connected() && more_to_read && times_to_read > 0) {
-      more_to_read = packet_reader_->ReadAndDispatchPackets(
-          fd, GetLatestClientAddress().port(), *client_->helper()->GetClock(),
-          this, overflow_supported_ ? &packets_dropped : nullptr);
+      if (gro_fds_.count(fd) > 0) {
+        more_to_read = ReadCoalescedPackets(
+            fd, self_address, overflow_supported_ ? &packets_dropped : nullptr);
+      } else {
+        more_to_read = packet_reader_->ReadAndDispatchPackets(
+            fd, port, *client_->helper()->GetClock(), this,
+            overflow_supported_ ? &packets_dropped : nullptr);
+      }
       --times_to_read;
     }
     if (packets_dropped_ < packets_dropped) {
@@ -197,36 +318,357 @@ void QuicClientEpollNetworkHelper::OnEvent(int fd, QuicEpollEvent* event) {
   }
 }
 
+bool QuicClientEpollNetworkHelper::StartRouteMonitor() {
+  if (route_fd_ > -1) {
+    return true;
+  }
+
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_ROUTE);
+  if (fd < 0) {
+    QUIC_LOG(WARNING) << "Failed to open rtnetlink socket: "
+                      << strerror(errno);
+    return false;
+  }
+
+  sockaddr_nl addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_IPV4_ROUTE | RTMGRP_IPV4_IFADDR;
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    QUIC_LOG(WARNING) << "Failed to bind rtnetlink socket: "
+                      << strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  // Subscribe before dumping so that no change between the two is missed.
+  route_fd_ = fd;
+  if (!DumpRouteTable()) {
+    close(route_fd_);
+    route_fd_ = -1;
+    return false;
+  }
+  epoll_server_->RegisterFD(route_fd_, this, EPOLLIN | EPOLLET);
+  ReadRouteMessages();
+  ReportDefaultRoutes();
+  return true;
+}
+
+bool QuicClientEpollNetworkHelper::DumpRouteTable() {
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd < 0) {
+    return false;
+  }
+
+  iface_addresses_.clear();
+  default_gateways_.clear();
+
+  bool success = true;
+  uint32_t seq = 0;
+  for (uint16_t type : {RTM_GETADDR, RTM_GETROUTE}) {
+    struct {
+      nlmsghdr header;
+      rtgenmsg message;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(rtgenmsg));
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++seq;
+    request.message.rtgen_family = AF_INET;
+    if (send(fd, &request, request.header.nlmsg_len, 0) < 0) {
+      success = false;
+      break;
+    }
+
+    alignas(nlmsghdr) char buffer[kRouteBufferSize];
+    bool done = false;
+    while (!done) {
+      ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+      if (length < 0 && errno == EINTR) {
+        continue;
+      }
+      if (length <= 0) {
+        success = false;
+        break;
+      }
+      done = ProcessRouteMessages(buffer, static_cast<int>(length));
+    }
+    if (!success) {
+      break;
+    }
+  }
+  close(fd);
+
+  if (!success) {
+    QUIC_LOG(WARNING) << "Failed to dump the route table: " << strerror(errno);
+  }
+  return success;
+}
+
+void QuicClientEpollNetworkHelper::ReadRouteMessages() {
+  alignas(nlmsghdr) char buffer[kRouteBufferSize];
+  bool changed = false;
+  while (true) {
+    ssize_t length = recv(route_fd_, buffer, sizeof(buffer), 0);
+    if (length < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == ENOBUFS) {
+        // The kernel dropped notifications, the table has to be rebuilt.
+        QUIC_LOG(WARNING) << "rtnetlink overrun, dumping the route table again";
+        changed |= DumpRouteTable();
+        continue;
+      }
+      break;
+    }
+    if (length == 0) {
+      break;
+    }
+    ProcessRouteMessages(buffer, static_cast<int>(length));
+    changed = true;
+  }
+  if (changed) {
+    ReportDefaultRoutes();
+  }
+}
+
+bool QuicClientEpollNetworkHelper::ProcessRouteMessages(char* buffer,
+                                                        int length) {
+  bool done = false;
+  for (nlmsghdr* header = reinterpret_cast<nlmsghdr*>(buffer);
+       length >= 0 && NLMSG_OK(header, static_cast<uint32_t>(length));
+       header = NLMSG_NEXT(header, length)) {
+    switch (header->nlmsg_type) {
+      case NLMSG_DONE:
+      case NLMSG_ERROR:
+        done = true;
+        break;
+      case RTM_NEWADDR:
+      case RTM_DELADDR: {
+        ifaddrmsg* ifa = reinterpret_cast<ifaddrmsg*>(NLMSG_DATA(header));
+        if (ifa->ifa_family != AF_INET || (ifa->ifa_flags & IFA_F_SECONDARY)) {
+          break;
+        }
+        QuicIpAddress address;
+        int attr_length = IFA_PAYLOAD(header);
+        for (rtattr* attr = IFA_RTA(ifa); RTA_OK(attr, attr_length);
+             attr = RTA_NEXT(attr, attr_length)) {
+          // IFA_LOCAL is the local address on point-to-point links, where
+          // IFA_ADDRESS is the peer.
+          if (attr->rta_type == IFA_LOCAL ||
+              (attr->rta_type == IFA_ADDRESS && !address.IsInitialized())) {
+            address = QuicIpAddress(
+                *reinterpret_cast<const in_addr*>(RTA_DATA(attr)));
+          }
+        }
+        if (!address.IsInitialized()) {
+          break;
+        }
+        if (header->nlmsg_type == RTM_NEWADDR) {
+          iface_addresses_[ifa->ifa_index] = address;
+        } else {
+          auto it = iface_addresses_.find(ifa->ifa_index);
+          if (it != iface_addresses_.end() && it->second == address) {
+            iface_addresses_.erase(it);
+            // The kernel flushes the routes through the interface without
+            // sending RTM_DELROUTE, so drop them here as well.
+            for (auto route = default_gateways_.begin();
+                 route != default_gateways_.end();) {
+              if (route->first.first == static_cast<int>(ifa->ifa_index)) {
+                route = default_gateways_.erase(route);
+              } else {
+                ++route;
+              }
+            }
+          }
+        }
+        break;
+      }
+      case RTM_NEWROUTE:
+      case RTM_DELROUTE: {
+        rtmsg* rtm = reinterpret_cast<rtmsg*>(NLMSG_DATA(header));
+        if (rtm->rtm_family != AF_INET || rtm->rtm_dst_len != 0 ||
+            rtm->rtm_table != RT_TABLE_MAIN || rtm->rtm_type != RTN_UNICAST) {
+          break;
+        }
+        QuicIpAddress gateway;
+        int oif = 0;
+        uint32_t metric = 0;
+        int attr_length = RTM_PAYLOAD(header);
+        for (rtattr* attr = RTM_RTA(rtm); RTA_OK(attr, attr_length);
+             attr = RTA_NEXT(attr, attr_length)) {
+          switch (attr->rta_type) {
+            case RTA_GATEWAY:
+              gateway = QuicIpAddress(
+                  *reinterpret_cast<const in_addr*>(RTA_DATA(attr)));
+              break;
+            case RTA_OIF:
+              oif = *reinterpret_cast<const int*>(RTA_DATA(attr));
+              break;
+            case RTA_PRIORITY:
+              metric = *reinterpret_cast<const uint32_t*>(RTA_DATA(attr));
+              break;
+          }
+        }
+        // Same filter as RTF_UP|RTF_GATEWAY in /proc/net/route.
+        if (!gateway.IsInitialized() || oif == 0) {
+          break;
+        }
+        if (header->nlmsg_type == RTM_NEWROUTE) {
+          default_gateways_[std::make_pair(oif, metric)] = gateway;
+        } else {
+          default_gateways_.erase(std::make_pair(oif, metric));
+        }
+        break;
+      }
+    }
+  }
+  return done;
+}
+
+void QuicClientEpollNetworkHelper::ReportDefaultRoutes() {
+  std::vector<QuicClientBase::DefaultRoute> routes;
+  for (const auto& entry : default_gateways_) {
+    QuicClientBase::DefaultRoute route;
+    char name[IF_NAMESIZE];
+    if (if_indextoname(entry.first.first, name) != nullptr) {
+      route.iface = name;
+    }
+    route.gateway = entry.second;
+    route.metric = entry.first.second;
+    auto it = iface_addresses_.find(entry.first.first);
+    if (it != iface_addresses_.end()) {
+      route.host = it->second;
+    }
+    routes.push_back(route);
+  }
+  client_->OnDefaultRoutesChanged(std::move(routes));
+}
+
 QuicPacketWriter* QuicClientEpollNetworkHelper::CreateQuicPacketWriter() {
   return new QuicDefaultPacketWriter(GetLatestFD());
 }
 
 void QuicClientEpollNetworkHelper::SetClientPort(int port) {
-  fd_address_map_.back().second =
+  fd_address_map_[active_fd_] =
       QuicSocketAddress(GetLatestClientAddress().host(), port);
 }
 
 QuicSocketAddress QuicClientEpollNetworkHelper::GetLatestClientAddress() const {
-  if (fd_address_map_.empty()) {
+  auto it = fd_address_map_.find(active_fd_);
+  if (it == fd_address_map_.end()) {
     return QuicSocketAddress();
   }
 
-  return fd_address_map_.back().second;
+  return it->second;
 }
 
 int QuicClientEpollNetworkHelper::GetLatestFD() const {
-  if (fd_address_map_.empty()) {
-    return -1;
+  return active_fd_;
+}
+
+bool QuicClientEpollNetworkHelper::ReadCoalescedPackets(
+    int fd,
+    const QuicSocketAddress& self_address,
+    QuicPacketCount* packets_dropped) {
+  iovec iov = {gro_buffer_.get(), kMaxCoalescedDatagramSize};
+  sockaddr_storage raw_peer_address;
+  alignas(cmsghdr) char control_buffer[kCoalescedControlBufferSize];
+  msghdr hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.msg_name = &raw_peer_address;
+  hdr.msg_namelen = sizeof(raw_peer_address);
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+  hdr.msg_control = control_buffer;
+  hdr.msg_controllen = sizeof(control_buffer);
+
+  int bytes_read = recvmsg(fd, &hdr, 0);
+  if (bytes_read < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      QUIC_LOG_FIRST_N(ERROR, 100)
+          << "Error reading packets: " << strerror(errno);
+    }
+    return false;
+  }
+  if (hdr.msg_flags & MSG_CTRUNC) {
+    // The segment size may be among the lost control messages, and splitting
+    // a train at the wrong size fails the decryption of all its packets.
+    QUIC_BUG(quic_bug_coalesced_control_truncated)
+        << "Control buffer too small. size:" << sizeof(control_buffer);
+    return true;
+  }
+  if (hdr.msg_flags & MSG_TRUNC) {
+    QUIC_LOG_FIRST_N(WARNING, 100) << "Received truncated datagram";
+    return true;
   }
 
-  return fd_address_map_.back().first;
+  // Without a UDP_GRO control message the datagram is a single packet.
+  int segment_size = bytes_read;
+  QuicIpAddress self_ip = self_address.host();
+  const QuicClock* clock = client_->helper()->GetClock();
+  QuicTime receive_time = clock->Now();
+  for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+#if defined(UDP_GRO)
+    if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+      memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+      continue;
+    }
+#endif
+    if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
+      in_pktinfo info;
+      memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+      self_ip = QuicIpAddress(info.ipi_addr);
+    } else if (cmsg->cmsg_level == IPPROTO_IPV6 &&
+               cmsg->cmsg_type == IPV6_PKTINFO) {
+      in6_pktinfo info;
+      memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+      self_ip = QuicIpAddress(info.ipi6_addr);
+    } else if (cmsg->cmsg_level == SOL_SOCKET &&
+               cmsg->cmsg_type == SO_TIMESTAMPING) {
+      // The first of the three timespecs is the software timestamp.
+      timespec ts;
+      memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+      receive_time = clock->ConvertWallTimeToQuicTime(
+          QuicWallTime::FromUNIXMicroseconds(
+              static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 +
+              ts.tv_nsec / 1000));
+    } else if (packets_dropped != nullptr && cmsg->cmsg_level == SOL_SOCKET &&
+               cmsg->cmsg_type == SO_RXQ_OVFL) {
+      uint32_t dropped;
+      memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+      *packets_dropped = dropped;
+    }
+  }
+  if (segment_size <= 0) {
+    segment_size = bytes_read;
+  }
+
+  // Processing a packet may migrate the connection and close |fd|, but the
+  // rest of the datagram stays valid in |gro_buffer_|.
+  const QuicSocketAddress packet_self_address(self_ip, self_address.port());
+  const QuicSocketAddress peer_address(raw_peer_address);
+  for (int offset = 0; offset < bytes_read && client_->connected();
+       offset += segment_size) {
+    QuicReceivedPacket packet(gro_buffer_.get() + offset,
+                              std::min(segment_size, bytes_read - offset),
+                              receive_time, /*owns_buffer=*/false);
+    ProcessPacket(packet_self_address, peer_address, packet);
+  }
+  return true;
 }
 
 void QuicClientEpollNetworkHelper::ProcessPacket(
     const QuicSocketAddress& self_address,
     const QuicSocketAddress& peer_address,
     const QuicReceivedPacket& packet) {
-  client_->session()->ProcessUdpPacket(self_address, peer_address, packet);
+  // [SD] Sockets of connection attempts racing the session deliver to them.
+  client_->GetSessionForSelfAddress(self_address)
+      ->ProcessUdpPacket(self_address, peer_address, packet);
 }
 
 int QuicClientEpollNetworkHelper::CreateUDPSocket(
@@ -242,6 +684,15 @@ int QuicClientEpollNetworkHelper::CreateUDPSocket(
 
   *overflow_supported = api.EnableDroppedPacketCount(fd);
   api.EnableReceiveTimestamp(fd);
+
+  // [SD] A bulk download arrives in trains of full-sized packets, which
+  // UDP_GRO hands over in one read. Kernels without it keep recvmmsg().
+  if (EnableUdpGro(fd)) {
+    gro_fds_.insert(fd);
+    if (gro_buffer_ == nullptr) {
+      gro_buffer_.reset(new char[kMaxCoalescedDatagramSize]);
+    }
+  }
   return fd;
 }
 }  // namespace quic
@@ -9,8 +9,11 @@
 #define QUICHE_QUIC_TOOLS_QUIC_CLIENT_EPOLL_NETWORK_HELPER_H_
 
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
+#include <utility>
 
 #include "quic/core/http/quic_client_push_promise_index.h"
 #include "quic/core/quic_config.h"
@@ -68,6 +71,14 @@ class QuicClientEpollNetworkHelper : public QuicClientBase::NetworkHelper,
   void CleanUpAllUDPSockets() override;
   QuicSocketAddress GetLatestClientAddress() const override;
   QuicPacketWriter* CreateQuicPacketWriter() override;
+  bool StartRouteMonitor() override;
+  void CleanUpUDPSocket(const QuicSocketAddress& self_address) override;
+  QuicPacketWriter* CreateStandbyUDPSocket(
+      QuicSocketAddress server_address,
+      QuicIpAddress bind_to_address,
+      int bind_to_port,
+      QuicSocketAddress* self_address) override;
+  void ActivateUDPSocket(const QuicSocketAddress& self_address) override;
 
   // Accessors provided for convenience, not part of any interface.
 
@@ -79,7 +90,7 @@ class QuicClientEpollNetworkHelper : public QuicClientBase::NetworkHelper,
   }
 
   // If the client has at least one UDP socket, return the latest created one.
-  // Otherwise, return -1.
+  // Otherwise, return -1. [SD] Standby sockets only count once activated.
   int GetLatestFD() const;
 
   // Create socket for connection to |server_address| with default socket
@@ -106,6 +117,35 @@ class QuicClientEpollNetworkHelper : public QuicClientBase::NetworkHelper,
   // Actually clean up |fd|.
   void CleanUpUDPSocketImpl(int fd);
 
+  // [SD] Creates, binds and registers a socket for |server_address|. Returns
+  // its fd, or -1 on failure.
+  int CreateAndBindUDPSocket(QuicSocketAddress server_address,
+                             QuicIpAddress bind_to_address,
+                             int bind_to_port);
+
+  // [SD] Dumps the current IPv4 addresses and routes from the kernel into the
+  // route table. Returns false if the dump could not be completed.
+  bool DumpRouteTable();
+
+  // [SD] Reads and applies all pending messages on |route_fd_|.
+  void ReadRouteMessages();
+
+  // [SD] Applies the rtnetlink messages in |buffer| to the route table. Returns
+  // true if the end of a dump was reached.
+  bool ProcessRouteMessages(char* buffer, int length);
+
+  // [SD] Hands the current default routes to the client.
+  void ReportDefaultRoutes();
+
+  // [SD] Reads one datagram from |fd|, which the kernel may have coalesced
+  // from several packets with UDP_GRO, and processes each packet in it. The
+  // self IP and receive time come from the control messages, |self_address|
+  // supplies the port and the IP if IP_PKTINFO is missing. Returns false if
+  // nothing was read.
+  bool ReadCoalescedPackets(int fd,
+                            const QuicSocketAddress& self_address,
+                            QuicPacketCount* packets_dropped);
+
   // Listens for events on the client socket.
   QuicEpollServer* epoll_server_;
 
@@ -113,6 +153,14 @@ class QuicClientEpollNetworkHelper : public QuicClientBase::NetworkHelper,
   // map, the order of socket creation can be recorded.
   quiche::QuicheLinkedHashMap<int, QuicSocketAddress> fd_address_map_;
 
+  // [SD] Socket the session sends on, or -1. Standby sockets are created
+  // after it, so it is not necessarily the last one in |fd_address_map_|.
+  int active_fd_;
+
+  // [SD] Sockets of standby paths and connection attempts that are not
+  // active yet. CleanUpAllUDPSockets() leaves them open.
+  std::set<int> standby_fds_;
+
   // If overflow_supported_ is true, this will be the number of packets dropped
   // during the lifetime of the server.
   QuicPacketCount packets_dropped_;
@@ -125,9 +173,26 @@ class QuicClientEpollNetworkHelper : public QuicClientBase::NetworkHelper,
   // space than allowed on the stack.
   std::unique_ptr<QuicPacketReader> packet_reader_;
 
+  // [SD] Sockets UDP_GRO is enabled on. Their reads go through
+  // ReadCoalescedPackets() and |gro_buffer_| instead of |packet_reader_|,
+  // whose buffers only hold one packet each.
+  std::set<int> gro_fds_;
+  std::unique_ptr<char[]> gro_buffer_;
+
   QuicClientBase* client_;
 
   int max_reads_per_epoll_loop_;
+
+  // [SD] rtnetlink socket subscribed to IPv4 route and address changes, or -1
+  // if the route monitor is not running.
+  int route_fd_;
+
+  // [SD] IPv4 address of each interface, keyed by interface index.
+  std::map<int, QuicIpAddress> iface_addresses_;
+
+  // [SD] Gateways of the default routes in the main table, keyed by output
+  // interface index and metric.
+  std::map<std::pair<int, uint32_t>, QuicIpAddress> default_gateways_;
 };
 
 }  // namespace quic
@@ -0,0 +1,501 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// [SD] A response backend that serves the files of a response cache directory
+// straight from memory mappings. Unlike QuicMemoryCacheBackend, nothing but
+// the header block is read at startup, so startup time and memory do not grow
+// with the size of the corpus. Files that change on disk are picked up again
+// on the next request for them. Replace files by renaming a new version over
+// them: truncating a file in place pulls the pages from under responses that
+// are still being sent.
+
+#ifndef QUICHE_QUIC_TOOLS_QUIC_FILE_BACKEND_H_
+#define QUICHE_QUIC_TOOLS_QUIC_FILE_BACKEND_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "quic/platform/api/quic_bug_tracker.h"
+#include "quic/platform/api/quic_file_utils.h"
+#include "quic/platform/api/quic_logging.h"
+#include "quic/platform/api/quic_mutex.h"
+#include "quic/tools/quic_backend_response.h"
+#include "quic/tools/quic_simple_server_backend.h"
+#include "spdy/core/spdy_header_block.h"
+
+namespace quic {
+
+// The response cache directory is scanned again for new files at most this
+// often, when a request misses.
+const int64_t kFileBackendRescanIntervalMs = 1000;
+
+class QuicFileBackend : public QuicSimpleServerBackend {
+ public:
+  // A response file in the format read by QuicMemoryCacheBackend: an HTTP/1.1
+  // header block, an empty line and the body.
+  class Resource {
+   public:
+    Resource(const Resource&) = delete;
+    Resource& operator=(const Resource&) = delete;
+
+    ~Resource() { munmap(const_cast<char*>(data_), size_); }
+
+    // Maps |file_name| and finds its key and the start of its body. Returns
+    // nullptr if the file cannot be mapped or has no header block.
+    static std::shared_ptr<Resource> Map(const std::string& file_name,
+                                         const std::string& base) {
+      int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return nullptr;
+      }
+      struct stat file_stat;
+      if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        return nullptr;
+      }
+      void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE,
+                        fd, 0);
+      close(fd);
+      if (data == MAP_FAILED) {
+        QUIC_LOG(ERROR) << "Failed to map " << file_name;
+        return nullptr;
+      }
+      std::shared_ptr<Resource> resource(
+          new Resource(file_name, file_stat, static_cast<const char*>(data)));
+      if (!resource->ScanHeaders(base)) {
+        QUIC_LOG(ERROR) << "Headers invalid or empty, ignoring: " << file_name;
+        return nullptr;
+      }
+      return resource;
+    }
+
+    const std::string& file_name() const { return file_name_; }
+
+    // Host and path the resource is served for, e.g. "example.com/index.html".
+    const std::string& key() const { return key_; }
+
+    absl::string_view body() const {
+      return absl::string_view(data_ + body_offset_, size_ - body_offset_);
+    }
+
+    // Returns true if |file_stat| describes another version of the file.
+    bool IsStale(const struct stat& file_stat) const {
+      return file_stat.st_ino != inode_ ||
+             static_cast<size_t>(file_stat.st_size) != size_ ||
+             file_stat.st_mtim.tv_sec != mtime_.tv_sec ||
+             file_stat.st_mtim.tv_nsec != mtime_.tv_nsec;
+    }
+
+    // Returns the response headers, parsed on first use. The body is not part
+    // of the response; it stays in the mapping.
+    const QuicBackendResponse* response() const {
+      std::call_once(parse_once_, [this] { ParseHeaders(); });
+      return &response_;
+    }
+
+   private:
+    Resource(std::string file_name,
+             const struct stat& file_stat,
+             const char* data)
+        : file_name_(std::move(file_name)),
+          data_(data),
+          size_(file_stat.st_size),
+          inode_(file_stat.st_ino),
+          mtime_(file_stat.st_mtim),
+          body_offset_(0) {}
+
+    // Calls |visitor| with every line of the header block, without the line
+    // ending. Returns the offset of the body, or 0 if the block is not
+    // terminated by an empty line.
+    template <typename Visitor>
+    size_t ForEachHeaderLine(Visitor visitor) const {
+      size_t start = 0;
+      while (start < size_) {
+        const void* end = memchr(data_ + start, '\n', size_ - start);
+        if (end == nullptr) {
+          return 0;
+        }
+        const size_t pos = static_cast<const char*>(end) - data_;
+        size_t length = pos - start;
+        // Support both dos and unix line endings for convenience.
+        if (length > 0 && data_[pos - 1] == '\r') {
+          --length;
+        }
+        absl::string_view line(data_ + start, length);
+        start = pos + 1;
+        if (line.empty()) {
+          return start;
+        }
+        visitor(line);
+      }
+      return 0;
+    }
+
+    // Finds the body and the key, from X-Original-Url if present and from
+    // |base|, the path of the file below the cache directory, otherwise.
+    bool ScanHeaders(const std::string& base) {
+      key_ = base;
+      body_offset_ = ForEachHeaderLine([this](absl::string_view line) {
+        const absl::string_view kOriginalUrl = "x-original-url: ";
+        if (absl::StartsWithIgnoreCase(line, kOriginalUrl)) {
+          absl::string_view url = line.substr(kOriginalUrl.size());
+          for (absl::string_view scheme : {"https://", "http://"}) {
+            if (absl::StartsWith(url, scheme)) {
+              url.remove_prefix(scheme.size());
+            }
+          }
+          const size_t path_start = url.find('/');
+          if (path_start != absl::string_view::npos) {
+            key_ = GetKey(url.substr(0, path_start), url.substr(path_start));
+          } else {
+            key_ = GetKey(url, "");
+          }
+        }
+      });
+      return body_offset_ > 0;
+    }
+
+    void ParseHeaders() const {
+      spdy::Http2HeaderBlock headers;
+      ForEachHeaderLine([&headers](absl::string_view line) {
+        // Extract the status from the HTTP first line.
+        if (absl::StartsWith(line, "HTTP")) {
+          size_t pos = line.find(' ');
+          if (pos != absl::string_view::npos) {
+            headers[":status"] = line.substr(pos + 1, 3);
+          }
+          return;
+        }
+        // Headers are "key: value".
+        size_t pos = line.find(": ");
+        if (pos != absl::string_view::npos) {
+          headers.AppendValueOrAddHeader(
+              absl::AsciiStrToLower(line.substr(0, pos)),
+              line.substr(pos + 2));
+        }
+      });
+      // The connection header is prohibited in HTTP/2.
+      headers.erase("connection");
+      response_.set_headers(std::move(headers));
+    }
+
+    const std::string file_name_;
+    const char* const data_;
+    const size_t size_;
+    const ino_t inode_;
+    const timespec mtime_;
+    size_t body_offset_;
+    std::string key_;
+
+    mutable std::once_flag parse_once_;
+    mutable QuicBackendResponse response_;
+  };
+
+  QuicFileBackend() : initialized_(false) {}
+  QuicFileBackend(const QuicFileBackend&) = delete;
+  QuicFileBackend& operator=(const QuicFileBackend&) = delete;
+
+  // Indexes the files under |cache_directory|. Bodies are not read.
+  bool InitializeBackend(const std::string& cache_directory) override {
+    if (cache_directory.empty()) {
+      QUIC_BUG(quic_bug_file_backend_1)
+          << "cache_directory must not be empty.";
+      return false;
+    }
+    QUIC_LOG(INFO) << "Attempting to map response files from directory: "
+                   << cache_directory;
+    {
+      QuicWriterMutexLock lock(&mutex_);
+      cache_directory_ = cache_directory;
+    }
+    Rescan(/*force=*/true);
+    initialized_ = true;
+    QuicReaderMutexLock lock(&mutex_);
+    QUIC_LOG(INFO) << "Mapped " << resources_.size() << " response files";
+    return true;
+  }
+
+  bool IsBackendInitialized() const override { return initialized_; }
+
+  void FetchResponseFromBackend(
+      const spdy::Http2HeaderBlock& request_headers,
+      const std::string& /*request_body*/,
+      RequestHandler* request_handler) override {
+    std::shared_ptr<const Resource> resource;
+    auto authority = request_headers.find(":authority");
+    auto path = request_headers.find(":path");
+    if (authority != request_headers.end() && path != request_headers.end()) {
+      resource = GetResource(GetKey(authority->second, path->second));
+    }
+    std::list<QuicBackendResponse::ServerPushInfo> resources;
+    if (resource == nullptr) {
+      request_handler->OnResponseBackendComplete(nullptr, resources);
+      return;
+    }
+
+    const absl::string_view body = resource->body();
+    const QuicBackendResponse* response = resource->response();
+    uint64_t range_offset = 0;
+    size_t body_offset = 0;
+    QuicBackendResponse partial_response;
+    if (GetRangeOffset(request_headers, *response, &range_offset)) {
+      spdy::Http2HeaderBlock headers = response->headers().Clone();
+      SetRangeHeaders(range_offset, body.size(), &headers);
+      partial_response.set_headers(std::move(headers));
+      response = &partial_response;
+      body_offset = std::min<uint64_t>(range_offset, body.size());
+    }
+
+    bool streaming = false;
+    {
+      QuicWriterMutexLock lock(&mutex_);
+      auto it = streaming_handlers_.find(request_handler);
+      if (it != streaming_handlers_.end()) {
+        it->second.resource = resource;
+        it->second.body_offset = body_offset;
+        streaming = true;
+      }
+    }
+    if (streaming) {
+      request_handler->OnResponseBackendComplete(response, resources);
+      return;
+    }
+
+    // Streams that cannot write from the mapping get a copy of the body.
+    QuicBackendResponse copy;
+    copy.set_headers(response->headers().Clone());
+    copy.set_body(body.substr(body_offset));
+    request_handler->OnResponseBackendComplete(&copy, resources);
+  }
+
+  void CloseBackendResponseStream(
+      RequestHandler* /*request_handler*/) override {}
+
+  // Streams that write bodies straight from the mapping register while they
+  // are alive. They get a response without a body and pick the resource up
+  // with TakeStreamingResource().
+  void AddStreamingHandler(RequestHandler* handler) {
+    QuicWriterMutexLock lock(&mutex_);
+    streaming_handlers_[handler] = StreamingResource();
+  }
+
+  void RemoveStreamingHandler(RequestHandler* handler) {
+    QuicWriterMutexLock lock(&mutex_);
+    streaming_handlers_.erase(handler);
+  }
+
+  // Returns the resource last fetched by |handler|, and in |body_offset|
+  // where the body to send starts. The mapping stays valid while the returned
+  // pointer is held, even if the file is reloaded.
+  std::shared_ptr<const Resource> TakeStreamingResource(
+      RequestHandler* handler,
+      size_t* body_offset) {
+    QuicWriterMutexLock lock(&mutex_);
+    auto it = streaming_handlers_.find(handler);
+    if (it == streaming_handlers_.end()) {
+      return nullptr;
+    }
+    *body_offset = it->second.body_offset;
+    return std::move(it->second.resource);
+  }
+
+ private:
+  // A resource fetched for a streaming handler, and the offset its body is
+  // sent from.
+  struct StreamingResource {
+    std::shared_ptr<const Resource> resource;
+    size_t body_offset = 0;
+  };
+
+  // [SD] Returns true and sets |offset| if the request asks for the body of
+  // a 200 |response| from |offset| on, as clients do to resume a download
+  // after reconnecting. Only "bytes=N-" is supported; other ranges are
+  // ignored and the whole body is sent, which RFC 9110 allows.
+  static bool GetRangeOffset(const spdy::Http2HeaderBlock& request_headers,
+                             const QuicBackendResponse& response,
+                             uint64_t* offset) {
+    auto range = request_headers.find("range");
+    auto status = response.headers().find(":status");
+    if (range == request_headers.end() ||
+        status == response.headers().end() || status->second != "200") {
+      return false;
+    }
+    absl::string_view value = range->second;
+    return absl::ConsumePrefix(&value, "bytes=") &&
+           absl::ConsumeSuffix(&value, "-") && absl::SimpleAtoi(value, offset);
+  }
+
+  // [SD] Turns |headers| into those of a 206 response with the body from
+  // |offset| on, or of a 416 response if the body is shorter.
+  static void SetRangeHeaders(uint64_t offset,
+                              size_t body_size,
+                              spdy::Http2HeaderBlock* headers) {
+    if (offset >= body_size) {
+      (*headers)[":status"] = "416";
+      (*headers)["content-range"] = absl::StrCat("bytes */", body_size);
+      (*headers)["content-length"] = "0";
+      return;
+    }
+    (*headers)[":status"] = "206";
+    (*headers)["content-range"] =
+        absl::StrCat("bytes ", offset, "-", body_size - 1, "/", body_size);
+    (*headers)["content-length"] = absl::StrCat(body_size - offset);
+  }
+
+  // Returns the key of |path| on |host|. The port is not part of it, as in
+  // QuicMemoryCacheBackend::GetKey().
+  static std::string GetKey(absl::string_view host, absl::string_view path) {
+    const size_t port = host.find(':');
+    if (port != absl::string_view::npos) {
+      host = host.substr(0, port);
+    }
+    return absl::StrCat(host, path);
+  }
+
+  // Returns the resource for |key|, remapping its file if it changed on disk
+  // and looking for new files if there is none.
+  std::shared_ptr<const Resource> GetResource(const std::string& key) {
+    std::shared_ptr<const Resource> resource;
+    {
+      QuicReaderMutexLock lock(&mutex_);
+      auto it = resources_.find(key);
+      if (it != resources_.end()) {
+        resource = it->second;
+      }
+    }
+
+    if (resource == nullptr) {
+      Rescan(/*force=*/false);
+      QuicReaderMutexLock lock(&mutex_);
+      auto it = resources_.find(key);
+      return it == resources_.end() ? nullptr : it->second;
+    }
+
+    struct stat file_stat;
+    const bool exists = stat(resource->file_name().c_str(), &file_stat) == 0;
+    if (exists && !resource->IsStale(file_stat)) {
+      return resource;
+    }
+
+    // Streams still sending the old version keep its mapping alive.
+    QUIC_LOG(INFO) << "Reloading " << resource->file_name();
+    QuicWriterMutexLock lock(&mutex_);
+    Unindex(resource->file_name());
+    if (exists) {
+      Index(resource->file_name());
+    }
+    auto it = resources_.find(key);
+    return it == resources_.end() ? nullptr : it->second;
+  }
+
+  // Maps the files under the cache directory that are not mapped yet, at
+  // most once per kFileBackendRescanIntervalMs unless |force| is true. The
+  // directory is walked without holding |mutex_|, so workers serving mapped
+  // files are only held up while the new files are indexed.
+  void Rescan(bool force) QUIC_LOCKS_EXCLUDED(mutex_) {
+    std::string cache_directory;
+    {
+      // Claims the scan, so that concurrent misses do not walk the
+      // directory again.
+      QuicWriterMutexLock lock(&mutex_);
+      const auto now = std::chrono::steady_clock::now();
+      if (!force && now - last_scan_time_ <
+                        std::chrono::milliseconds(
+                            kFileBackendRescanIntervalMs)) {
+        return;
+      }
+      last_scan_time_ = now;
+      cache_directory = cache_directory_;
+    }
+
+    std::vector<std::string> new_files;
+    {
+      const std::vector<std::string> file_names =
+          ReadFileContents(cache_directory);
+      QuicReaderMutexLock lock(&mutex_);
+      for (const std::string& file_name : file_names) {
+        if (keys_.find(file_name) == keys_.end()) {
+          new_files.push_back(file_name);
+        }
+      }
+    }
+    if (new_files.empty()) {
+      return;
+    }
+
+    QuicWriterMutexLock lock(&mutex_);
+    for (const std::string& file_name : new_files) {
+      // Another scan may have indexed it in the meantime.
+      if (keys_.find(file_name) == keys_.end()) {
+        Index(file_name);
+      }
+    }
+  }
+
+  void Index(const std::string& file_name)
+      QUIC_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    std::string base = file_name.substr(cache_directory_.length());
+    if (!base.empty() && base[0] == '/') {
+      base.erase(0, 1);
+    }
+    std::shared_ptr<Resource> resource = Resource::Map(file_name, base);
+    if (resource == nullptr) {
+      return;
+    }
+    auto it = resources_.find(resource->key());
+    if (it != resources_.end() && it->second->file_name() != file_name) {
+      QUIC_LOG(WARNING) << file_name << " and " << it->second->file_name()
+                        << " are both responses for " << resource->key();
+      keys_.erase(it->second->file_name());
+    }
+    keys_[file_name] = resource->key();
+    resources_[resource->key()] = std::move(resource);
+  }
+
+  void Unindex(const std::string& file_name)
+      QUIC_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    auto it = keys_.find(file_name);
+    if (it == keys_.end()) {
+      return;
+    }
+    resources_.erase(it->second);
+    keys_.erase(it);
+  }
+
+  mutable QuicMutex mutex_;
+  std::string cache_directory_ QUIC_GUARDED_BY(mutex_);
+  // Mapped resources, keyed by host and path.
+  std::map<std::string, std::shared_ptr<const Resource>> resources_
+      QUIC_GUARDED_BY(mutex_);
+  // Keys of the mapped files, keyed by file name.
+  std::map<std::string, std::string> keys_ QUIC_GUARDED_BY(mutex_);
+  std::map<RequestHandler*, StreamingResource> streaming_handlers_
+      QUIC_GUARDED_BY(mutex_);
+  std::chrono::steady_clock::time_point last_scan_time_
+      QUIC_GUARDED_BY(mutex_);
+  bool initialized_;
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_TOOLS_QUIC_FILE_BACKEND_H_
@@ -0,0 +1,188 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// [SD] Dispatcher, session and stream that serve QuicFileBackend responses.
+// The stream writes the body from the backend's file mapping in chunks as the
+// connection drains, so a response never holds more than a chunk of its body
+// in the stream send buffer.
+
+#ifndef QUICHE_QUIC_TOOLS_QUIC_FILE_DISPATCHER_H_
+#define QUICHE_QUIC_TOOLS_QUIC_FILE_DISPATCHER_H_
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
+#include "quic/core/quic_connection.h"
+#include "quic/core/quic_types.h"
+#include "quic/tools/quic_file_backend.h"
+#include "quic/tools/quic_simple_dispatcher.h"
+#include "quic/tools/quic_simple_server_session.h"
+#include "quic/tools/quic_simple_server_stream.h"
+
+namespace quic {
+
+// [SD] Body bytes handed to a file server stream at a time. At namespace scope
+// since std::min() binds it by reference.
+const size_t kFileServerBodyChunkSize = 32 * 1024;
+
+class QuicFileServerStream : public QuicSimpleServerStream {
+ public:
+  QuicFileServerStream(QuicStreamId id,
+                       QuicSpdySession* session,
+                       StreamType type,
+                       QuicFileBackend* backend)
+      : QuicSimpleServerStream(id, session, type, backend),
+        backend_(backend),
+        body_offset_(0) {
+    backend_->AddStreamingHandler(this);
+  }
+
+  QuicFileServerStream(PendingStream* pending,
+                       QuicSpdySession* session,
+                       QuicFileBackend* backend)
+      : QuicSimpleServerStream(pending, session, backend),
+        backend_(backend),
+        body_offset_(0) {
+    backend_->AddStreamingHandler(this);
+  }
+
+  QuicFileServerStream(const QuicFileServerStream&) = delete;
+  QuicFileServerStream& operator=(const QuicFileServerStream&) = delete;
+
+  ~QuicFileServerStream() override { backend_->RemoveStreamingHandler(this); }
+
+  void OnResponseBackendComplete(
+      const QuicBackendResponse* response,
+      std::list<QuicBackendResponse::ServerPushInfo> resources) override {
+    resource_ = backend_->TakeStreamingResource(this, &body_offset_);
+    if (response == nullptr || resource_ == nullptr) {
+      QuicSimpleServerStream::OnResponseBackendComplete(response,
+                                                        std::move(resources));
+      return;
+    }
+    // A range request starts past the beginning of the body.
+    const bool fin = body_offset_ >= resource_->body().size();
+    WriteHeaders(response->headers().Clone(), fin, nullptr);
+    if (fin) {
+      resource_.reset();
+      return;
+    }
+    WriteBodyChunks();
+  }
+
+  void OnCanWrite() override {
+    QuicSimpleServerStream::OnCanWrite();
+    WriteBodyChunks();
+  }
+
+ private:
+  // Hands the body to the stream a chunk at a time, until the stream buffers
+  // data it could not send yet.
+  void WriteBodyChunks() {
+    while (resource_ != nullptr && !HasBufferedData() &&
+           !write_side_closed()) {
+      const absl::string_view body = resource_->body();
+      const size_t length =
+          std::min(kFileServerBodyChunkSize, body.size() - body_offset_);
+      const bool fin = body_offset_ + length == body.size();
+      WriteOrBufferBody(body.substr(body_offset_, length), fin);
+      body_offset_ += length;
+      if (fin) {
+        resource_.reset();
+      }
+    }
+  }
+
+  QuicFileBackend* backend_;  // Not owned.
+  // The resource whose body is being sent. Holding it keeps the mapping
+  // alive if the file is reloaded meanwhile.
+  std::shared_ptr<const QuicFileBackend::Resource> resource_;
+  size_t body_offset_;
+};
+
+class QuicFileServerSession : public QuicSimpleServerSession {
+ public:
+  QuicFileServerSession(const QuicConfig& config,
+                        const ParsedQuicVersionVector& supported_versions,
+                        QuicConnection* connection,
+                        QuicSession::Visitor* visitor,
+                        QuicCryptoServerStreamBase::Helper* helper,
+                        const QuicCryptoServerConfig* crypto_config,
+                        QuicCompressedCertsCache* compressed_certs_cache,
+                        QuicFileBackend* backend)
+      : QuicSimpleServerSession(config, supported_versions, connection,
+                                visitor, helper, crypto_config,
+                                compressed_certs_cache, backend),
+        backend_(backend) {}
+
+ protected:
+  QuicSpdyStream* CreateIncomingStream(QuicStreamId id) override {
+    if (!ShouldCreateIncomingStream(id)) {
+      return nullptr;
+    }
+    QuicSpdyStream* stream =
+        new QuicFileServerStream(id, this, BIDIRECTIONAL, backend_);
+    ActivateStream(absl::WrapUnique(stream));
+    return stream;
+  }
+
+  QuicSpdyStream* CreateIncomingStream(PendingStream* pending) override {
+    QuicSpdyStream* stream = new QuicFileServerStream(pending, this, backend_);
+    ActivateStream(absl::WrapUnique(stream));
+    return stream;
+  }
+
+ private:
+  QuicFileBackend* backend_;  // Not owned.
+};
+
+class QuicFileDispatcher : public QuicSimpleDispatcher {
+ public:
+  QuicFileDispatcher(
+      const QuicConfig* config,
+      const QuicCryptoServerConfig* crypto_config,
+      QuicVersionManager* version_manager,
+      std::unique_ptr<QuicConnectionHelperInterface> helper,
+      std::unique_ptr<QuicCryptoServerStreamBase::Helper> session_helper,
+      std::unique_ptr<QuicAlarmFactory> alarm_factory,
+      QuicFileBackend* backend,
+      uint8_t expected_server_connection_id_length)
+      : QuicSimpleDispatcher(config, crypto_config, version_manager,
+                             std::move(helper), std::move(session_helper),
+                             std::move(alarm_factory), backend,
+                             expected_server_connection_id_length),
+        backend_(backend) {}
+
+ protected:
+  std::unique_ptr<QuicSession> CreateQuicSession(
+      QuicConnectionId connection_id,
+      const QuicSocketAddress& self_address,
+      const QuicSocketAddress& peer_address,
+      absl::string_view /*alpn*/,
+      const ParsedQuicVersion& version,
+      const ParsedClientHello& /*parsed_chlo*/) override {
+    // The QuicServerSessionBase takes ownership of |connection| below.
+    QuicConnection* connection = new QuicConnection(
+        connection_id, self_address, peer_address, helper(), alarm_factory(),
+        writer(), /* owns_writer= */ false, Perspective::IS_SERVER,
+        ParsedQuicVersionVector{version});
+
+    auto session = std::make_unique<QuicFileServerSession>(
+        config(), GetSupportedVersions(), connection, this, session_helper(),
+        crypto_config(), compressed_certs_cache(), backend_);
+    session->Initialize();
+    return session;
+  }
+
+ private:
+  QuicFileBackend* backend_;  // Not owned.
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_TOOLS_QUIC_FILE_DISPATCHER_H_
@@ -0,0 +1,746 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// [SD] An in-process handover simulator. The toy client and a
+// QuicSimpleDispatcher run on a simulated clock and talk over simulated
+// interfaces, so handover experiments need neither a second NIC nor root
+// privileges, and every run is reproducible from its seed.
+
+#ifndef QUICHE_QUIC_TOOLS_QUIC_HANDOVER_SIMULATOR_H_
+#define QUICHE_QUIC_TOOLS_QUIC_HANDOVER_SIMULATOR_H_
+
+#include <errno.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "quic/core/crypto/crypto_handshake.h"
+#include "quic/core/crypto/quic_client_session_cache.h"
+#include "quic/core/crypto/quic_crypto_server_config.h"
+#include "quic/core/quic_alarm_factory.h"
+#include "quic/core/quic_connection.h"
+#include "quic/core/quic_packet_writer.h"
+#include "quic/core/quic_packets.h"
+#include "quic/core/quic_server_id.h"
+#include "quic/core/quic_time.h"
+#include "quic/core/quic_version_manager.h"
+#include "quic/core/quic_versions.h"
+#include "quic/test_tools/crypto_test_utils.h"
+#include "quic/test_tools/simple_random.h"
+#include "quic/test_tools/simulator/actor.h"
+#include "quic/test_tools/simulator/simulator.h"
+#include "quic/tools/fake_proof_verifier.h"
+#include "quic/tools/quic_client_base.h"
+#include "quic/tools/quic_memory_cache_backend.h"
+#include "quic/tools/quic_simple_crypto_server_stream_helper.h"
+#include "quic/tools/quic_simple_dispatcher.h"
+#include "quic/tools/quic_spdy_client_base.h"
+#include "spdy/core/spdy_header_block.h"
+
+namespace quic {
+
+class SimulatedNetworkHelper;
+
+// Connection helper and alarm factory handed to the client and the dispatcher,
+// which take ownership of theirs. Both forward to the simulator.
+class SimulatedConnectionHelper : public QuicConnectionHelperInterface {
+ public:
+  explicit SimulatedConnectionHelper(simulator::Simulator* simulator)
+      : simulator_(simulator) {}
+
+  const QuicClock* GetClock() const override { return simulator_->GetClock(); }
+  QuicRandom* GetRandomGenerator() override {
+    return simulator_->GetRandomGenerator();
+  }
+  QuicBufferAllocator* GetStreamSendBufferAllocator() override {
+    return simulator_->GetStreamSendBufferAllocator();
+  }
+
+ private:
+  simulator::Simulator* simulator_;  // Not owned.
+};
+
+class SimulatedAlarmFactory : public QuicAlarmFactory {
+ public:
+  explicit SimulatedAlarmFactory(simulator::Simulator* simulator)
+      : simulator_(simulator) {}
+
+  QuicAlarm* CreateAlarm(QuicAlarm::Delegate* delegate) override {
+    return simulator_->GetAlarmFactory()->CreateAlarm(delegate);
+  }
+  QuicArenaScopedPtr<QuicAlarm> CreateAlarm(
+      QuicArenaScopedPtr<QuicAlarm::Delegate> delegate,
+      QuicConnectionArena* arena) override {
+    return simulator_->GetAlarmFactory()->CreateAlarm(std::move(delegate),
+                                                      arena);
+  }
+
+ private:
+  simulator::Simulator* simulator_;  // Not owned.
+};
+
+// A client network interface. The link carries packets in both directions
+// while it is up. The default route through the interface exists while the
+// route is up; writes on an interface without a route fail with ENETUNREACH,
+// as they do on a real host.
+struct SimulatedInterface {
+  std::string name;
+  QuicIpAddress host;
+  QuicIpAddress gateway;
+  uint32_t metric = 0;
+  QuicTime::Delta one_way_delay = QuicTime::Delta::FromMilliseconds(10);
+  // Probability in [0, 1] that a packet is dropped on the link.
+  double loss_rate = 0;
+  bool link_up = true;
+  bool route_up = true;
+};
+
+// Carries packets between the client interfaces and the server. Packets are
+// delayed by the one-way delay of the client interface they use.
+class SimulatedNetwork : public simulator::Actor {
+ public:
+  SimulatedNetwork(simulator::Simulator* simulator,
+                   const QuicSocketAddress& server_address)
+      : Actor(simulator, "SimulatedNetwork"), server_address_(server_address) {}
+
+  void AddInterface(const SimulatedInterface& interface) {
+    interfaces_.push_back(interface);
+  }
+
+  void set_dispatcher(QuicDispatcher* dispatcher) { dispatcher_ = dispatcher; }
+  void set_client_helper(SimulatedNetworkHelper* client_helper) {
+    client_helper_ = client_helper;
+  }
+
+  const QuicSocketAddress& server_address() const { return server_address_; }
+
+  // Packets in flight on the link are lost when it goes down.
+  void SetLinkUp(const std::string& name, bool up) {
+    SimulatedInterface* interface = FindInterface(name);
+    if (interface != nullptr) {
+      interface->link_up = up;
+    }
+  }
+
+  // Adds or removes the default route through |name|.
+  inline void SetRouteUp(const std::string& name, bool up);
+
+  void GetDefaultRoutes(std::vector<QuicClientBase::DefaultRoute>* routes) {
+    for (const SimulatedInterface& interface : interfaces_) {
+      if (!interface.route_up) {
+        continue;
+      }
+      QuicClientBase::DefaultRoute route;
+      route.iface = interface.name;
+      route.gateway = interface.gateway;
+      route.host = interface.host;
+      route.metric = interface.metric;
+      routes->push_back(route);
+    }
+  }
+
+  // Returns the address of the interface with the best default route, the
+  // source address the kernel would pick for an unbound socket.
+  QuicIpAddress GetPreferredHost() const {
+    const SimulatedInterface* best = nullptr;
+    for (const SimulatedInterface& interface : interfaces_) {
+      if (interface.route_up &&
+          (best == nullptr || interface.metric < best->metric)) {
+        best = &interface;
+      }
+    }
+    return best == nullptr ? QuicIpAddress() : best->host;
+  }
+
+  WriteResult Send(const QuicSocketAddress& source,
+                   const QuicSocketAddress& destination,
+                   const char* buffer,
+                   size_t length) {
+    const bool from_server = source == server_address_;
+    SimulatedInterface* interface =
+        FindInterfaceByHost(from_server ? destination.host() : source.host());
+    if (interface == nullptr) {
+      return WriteResult(WRITE_STATUS_ERROR, EADDRNOTAVAIL);
+    }
+    if (!from_server && !interface->route_up) {
+      return WriteResult(WRITE_STATUS_ERROR, ENETUNREACH);
+    }
+    if (interface->link_up && !IsLost(*interface)) {
+      InFlightPacket packet;
+      packet.source = source;
+      packet.destination = destination;
+      packet.contents.assign(buffer, length);
+      const QuicTime delivery_time = clock_->Now() + interface->one_way_delay;
+      in_flight_.emplace(delivery_time, std::move(packet));
+      Schedule(in_flight_.begin()->first);
+    }
+    return WriteResult(WRITE_STATUS_OK, length);
+  }
+
+  // Actor method.
+  inline void Act() override;
+
+ private:
+  struct InFlightPacket {
+    QuicSocketAddress source;
+    QuicSocketAddress destination;
+    std::string contents;
+  };
+
+  SimulatedInterface* FindInterface(const std::string& name) {
+    for (SimulatedInterface& interface : interfaces_) {
+      if (interface.name == name) {
+        return &interface;
+      }
+    }
+    return nullptr;
+  }
+
+  SimulatedInterface* FindInterfaceByHost(const QuicIpAddress& host) {
+    for (SimulatedInterface& interface : interfaces_) {
+      if (interface.host == host) {
+        return &interface;
+      }
+    }
+    return nullptr;
+  }
+
+  bool IsLost(const SimulatedInterface& interface) {
+    if (interface.loss_rate <= 0) {
+      return false;
+    }
+    const uint64_t kLossResolution = 1000000;
+    return simulator_->GetRandomGenerator()->RandUint64() % kLossResolution <
+           interface.loss_rate * kLossResolution;
+  }
+
+  const QuicSocketAddress server_address_;
+  std::vector<SimulatedInterface> interfaces_;
+  // Ordered by delivery time, packets with the same time keep their order.
+  std::multimap<QuicTime, InFlightPacket> in_flight_;
+  QuicDispatcher* dispatcher_ = nullptr;              // Not owned.
+  SimulatedNetworkHelper* client_helper_ = nullptr;  // Not owned.
+};
+
+// A UDP socket bound to |self_address| on the simulated network.
+class SimulatedPacketWriter : public QuicPacketWriter {
+ public:
+  SimulatedPacketWriter(SimulatedNetwork* network,
+                        const QuicSocketAddress& self_address)
+      : network_(network), self_address_(self_address) {}
+
+  WriteResult WritePacket(const char* buffer,
+                          size_t buf_len,
+                          const QuicIpAddress& /*self_address*/,
+                          const QuicSocketAddress& peer_address,
+                          PerPacketOptions* /*options*/) override {
+    return network_->Send(self_address_, peer_address, buffer, buf_len);
+  }
+  bool IsWriteBlocked() const override { return false; }
+  void SetWritable() override {}
+  QuicByteCount GetMaxPacketSize(
+      const QuicSocketAddress& /*peer_address*/) const override {
+    return kMaxOutgoingPacketSize;
+  }
+  bool SupportsReleaseTime() const override { return false; }
+  bool IsBatchMode() const override { return false; }
+  QuicPacketBuffer GetNextWriteLocation(
+      const QuicIpAddress& /*self_address*/,
+      const QuicSocketAddress& /*peer_address*/) override {
+    return {nullptr, nullptr};
+  }
+  WriteResult Flush() override { return WriteResult(WRITE_STATUS_OK, 0); }
+
+ private:
+  SimulatedNetwork* network_;  // Not owned.
+  const QuicSocketAddress self_address_;
+};
+
+// NetworkHelper of the simulated client. Sockets are bookkeeping only; the
+// route table comes from the simulated network, either pushed through
+// QuicClientBase::OnDefaultRoutesChanged() when the client monitors routes, or
+// read on every lookup otherwise.
+class SimulatedNetworkHelper : public QuicClientBase::NetworkHelper {
+ public:
+  // Simulated time that passes in one RunEventLoop().
+  static const int64_t kEventLoopStepMs = 1;
+  // First ephemeral port handed out.
+  static const uint16_t kFirstEphemeralPort = 40000;
+
+  SimulatedNetworkHelper(simulator::Simulator* simulator,
+                         SimulatedNetwork* network,
+                         QuicClientBase* client)
+      : simulator_(simulator), network_(network), client_(client) {
+    network_->set_client_helper(this);
+  }
+
+  ~SimulatedNetworkHelper() override { network_->set_client_helper(nullptr); }
+
+  // QuicClientBase::NetworkHelper methods.
+  void RunEventLoop() override {
+    simulator_->RunFor(QuicTime::Delta::FromMilliseconds(kEventLoopStepMs));
+  }
+
+  bool CreateUDPSocketAndBind(QuicSocketAddress /*server_address*/,
+                              QuicIpAddress bind_to_address,
+                              int bind_to_port) override {
+    QuicSocketAddress self_address;
+    if (!Bind(bind_to_address, bind_to_port, &self_address)) {
+      return false;
+    }
+    sockets_.push_back(self_address);
+    return true;
+  }
+
+  void CleanUpAllUDPSockets() override { sockets_.clear(); }
+
+  void CleanUpUDPSocket(const QuicSocketAddress& self_address) override {
+    for (std::vector<QuicSocketAddress>* sockets :
+         {&sockets_, &standby_sockets_}) {
+      auto it = std::find(sockets->begin(), sockets->end(), self_address);
+      if (it != sockets->end()) {
+        sockets->erase(it);
+        return;
+      }
+    }
+  }
+
+  QuicPacketWriter* CreateStandbyUDPSocket(
+      QuicSocketAddress /*server_address*/,
+      QuicIpAddress bind_to_address,
+      int bind_to_port,
+      QuicSocketAddress* self_address) override {
+    if (!Bind(bind_to_address, bind_to_port, self_address)) {
+      return nullptr;
+    }
+    standby_sockets_.push_back(*self_address);
+    return new SimulatedPacketWriter(network_, *self_address);
+  }
+
+  void ActivateUDPSocket(const QuicSocketAddress& self_address) override {
+    auto it = std::find(standby_sockets_.begin(), standby_sockets_.end(),
+                        self_address);
+    if (it != standby_sockets_.end()) {
+      standby_sockets_.erase(it);
+    }
+    it = std::find(sockets_.begin(), sockets_.end(), self_address);
+    if (it != sockets_.end()) {
+      sockets_.erase(it);
+    }
+    sockets_.push_back(self_address);
+  }
+
+  QuicSocketAddress GetLatestClientAddress() const override {
+    return sockets_.empty() ? QuicSocketAddress() : sockets_.back();
+  }
+
+  QuicPacketWriter* CreateQuicPacketWriter() override {
+    return new SimulatedPacketWriter(network_, GetLatestClientAddress());
+  }
+
+  bool StartRouteMonitor() override {
+    monitor_routes_ = true;
+    OnRoutesChanged();
+    return true;
+  }
+
+  bool GetDefaultRoutes(
+      std::vector<QuicClientBase::DefaultRoute>* routes) const override {
+    network_->GetDefaultRoutes(routes);
+    return true;
+  }
+
+  // Called by the network when a default route is added or removed.
+  void OnRoutesChanged() {
+    if (!monitor_routes_) {
+      return;
+    }
+    std::vector<QuicClientBase::DefaultRoute> routes;
+    network_->GetDefaultRoutes(&routes);
+    client_->OnDefaultRoutesChanged(std::move(routes));
+  }
+
+  // Called by the network for every packet sent to a client address.
+  void DeliverPacket(const QuicSocketAddress& self_address,
+                     const QuicSocketAddress& peer_address,
+                     const QuicReceivedPacket& packet) {
+    const bool bound =
+        std::find(sockets_.begin(), sockets_.end(), self_address) !=
+            sockets_.end() ||
+        std::find(standby_sockets_.begin(), standby_sockets_.end(),
+                  self_address) != standby_sockets_.end();
+    if (!bound || client_->session() == nullptr) {
+      return;
+    }
+    client_->GetSessionForSelfAddress(self_address)
+        ->ProcessUdpPacket(self_address, peer_address, packet);
+  }
+
+ private:
+  // Picks the address a socket bound to |bind_to_address| and |bind_to_port|
+  // gets. Returns false if there is no network to bind to.
+  bool Bind(QuicIpAddress bind_to_address,
+            int bind_to_port,
+            QuicSocketAddress* self_address) {
+    const QuicIpAddress host = bind_to_address.IsInitialized()
+                                   ? bind_to_address
+                                   : network_->GetPreferredHost();
+    if (!host.IsInitialized()) {
+      return false;
+    }
+    const uint16_t port = bind_to_port != 0
+                              ? static_cast<uint16_t>(bind_to_port)
+                              : next_ephemeral_port_++;
+    *self_address = QuicSocketAddress(host, port);
+    return true;
+  }
+
+  simulator::Simulator* simulator_;  // Not owned.
+  SimulatedNetwork* network_;        // Not owned.
+  QuicClientBase* client_;           // Not owned.
+  // The latest socket last.
+  std::vector<QuicSocketAddress> sockets_;
+  // Sockets of standby paths and connection attempts, see
+  // QuicClientBase::NetworkHelper::CreateStandbyUDPSocket().
+  std::vector<QuicSocketAddress> standby_sockets_;
+  uint16_t next_ephemeral_port_ = kFirstEphemeralPort;
+  bool monitor_routes_ = false;
+};
+
+void SimulatedNetwork::SetRouteUp(const std::string& name, bool up) {
+  SimulatedInterface* interface = FindInterface(name);
+  if (interface == nullptr || interface->route_up == up) {
+    return;
+  }
+  interface->route_up = up;
+  if (client_helper_ != nullptr) {
+    client_helper_->OnRoutesChanged();
+  }
+}
+
+void SimulatedNetwork::Act() {
+  const QuicTime now = clock_->Now();
+  while (!in_flight_.empty() && in_flight_.begin()->first <= now) {
+    // Delivery may send more packets, so take the packet out first.
+    InFlightPacket packet = std::move(in_flight_.begin()->second);
+    in_flight_.erase(in_flight_.begin());
+    const bool to_server = packet.destination == server_address_;
+    const SimulatedInterface* interface = FindInterfaceByHost(
+        to_server ? packet.source.host() : packet.destination.host());
+    if (interface == nullptr || !interface->link_up) {
+      continue;
+    }
+    QuicReceivedPacket received(packet.contents.data(), packet.contents.size(),
+                                now);
+    if (to_server) {
+      if (dispatcher_ != nullptr) {
+        dispatcher_->ProcessPacket(packet.destination, packet.source,
+                                   received);
+      }
+    } else if (client_helper_ != nullptr) {
+      client_helper_->DeliverPacket(packet.destination, packet.source,
+                                    received);
+    }
+  }
+  if (!in_flight_.empty()) {
+    Schedule(in_flight_.begin()->first);
+  }
+}
+
+// A QuicSpdyClientBase on the simulated network. It keeps the sessions of the
+// server, so a new connection resumes in 0-RTT like the toy client.
+class SimulatedQuicClient : public QuicSpdyClientBase {
+ public:
+  SimulatedQuicClient(simulator::Simulator* simulator,
+                      SimulatedNetwork* network,
+                      const QuicServerId& server_id,
+                      const ParsedQuicVersionVector& supported_versions,
+                      const QuicConfig& config)
+      : QuicSpdyClientBase(
+            server_id,
+            supported_versions,
+            config,
+            new SimulatedConnectionHelper(simulator),
+            new SimulatedAlarmFactory(simulator),
+            std::make_unique<SimulatedNetworkHelper>(simulator, network, this),
+            std::make_unique<FakeProofVerifier>(),
+            std::make_unique<QuicClientSessionCache>()) {
+    set_server_address(network->server_address());
+  }
+  SimulatedQuicClient(const SimulatedQuicClient&) = delete;
+  SimulatedQuicClient& operator=(const SimulatedQuicClient&) = delete;
+};
+
+// Takes the link of |interface| down at |link_down_time| and removes its
+// default route |l2l3_delay| later, the way a handover between access
+// networks is seen by the host.
+class SimulatedHandover : public simulator::Actor {
+ public:
+  SimulatedHandover(simulator::Simulator* simulator,
+                    SimulatedNetwork* network,
+                    std::string interface,
+                    QuicTime link_down_time,
+                    QuicTime::Delta l2l3_delay)
+      : Actor(simulator, "SimulatedHandover"),
+        network_(network),
+        interface_(std::move(interface)),
+        route_down_time_(link_down_time + l2l3_delay) {
+    Schedule(link_down_time);
+  }
+
+  void Act() override {
+    if (!link_down_) {
+      network_->SetLinkUp(interface_, false);
+      link_down_ = true;
+      // Zero L2-L3 delay removes the route at the same instant.
+      Schedule(route_down_time_);
+      return;
+    }
+    network_->SetRouteUp(interface_, false);
+  }
+
+ private:
+  SimulatedNetwork* network_;  // Not owned.
+  const std::string interface_;
+  const QuicTime route_down_time_;
+  bool link_down_ = false;
+};
+
+// Samples the stream bytes received by the client and records how long data
+// stops arriving.
+class HandoverProgressProbe : public simulator::Actor {
+ public:
+  static const int64_t kSampleIntervalMs = 1;
+
+  HandoverProgressProbe(simulator::Simulator* simulator,
+                        QuicClientBase* client,
+                        QuicTime handover_time)
+      : Actor(simulator, "HandoverProgressProbe"),
+        client_(client),
+        handover_time_(handover_time),
+        last_progress_(clock_->Now()) {
+    Schedule(clock_->Now());
+  }
+
+  // Must be called when the client replaced its session, whose byte count
+  // starts from zero again.
+  void OnNewSession() { session_bytes_ = 0; }
+
+  void Act() override {
+    if (client_->session() != nullptr) {
+      const QuicByteCount bytes =
+          client_->session()->connection()->GetStats().stream_bytes_received;
+      if (bytes > session_bytes_) {
+        session_bytes_ = bytes;
+        const QuicTime now = clock_->Now();
+        max_stall_ = std::max(max_stall_, now - last_progress_);
+        last_progress_ = now;
+        if (now > handover_time_ &&
+            !first_progress_after_handover_.IsInitialized()) {
+          first_progress_after_handover_ = now;
+        }
+      }
+    }
+    Schedule(clock_->Now() +
+             QuicTime::Delta::FromMilliseconds(kSampleIntervalMs));
+  }
+
+  QuicTime::Delta max_stall() const { return max_stall_; }
+
+  // Returns the time from the handover until data arrived again, or infinite
+  // if it never did.
+  QuicTime::Delta handover_delay() const {
+    if (!first_progress_after_handover_.IsInitialized()) {
+      return QuicTime::Delta::Infinite();
+    }
+    return first_progress_after_handover_ - handover_time_;
+  }
+
+ private:
+  QuicClientBase* client_;  // Not owned.
+  const QuicTime handover_time_;
+  QuicTime last_progress_;
+  QuicTime first_progress_after_handover_ = QuicTime::Zero();
+  QuicTime::Delta max_stall_ = QuicTime::Delta::Zero();
+  QuicByteCount session_bytes_ = 0;
+};
+
+// Runs a single download with one handover from iface1 to iface2.
+class QuicHandoverSimulation {
+ public:
+  struct Config {
+    // Handle the handover with connection migration, or with a new
+    // connection once the old one fails.
+    bool use_migration = true;
+    // Push route changes to the client instead of having it poll on HDT/RLT.
+    bool monitor_routes = true;
+    QuicTime::Delta rtt = QuicTime::Delta::FromMilliseconds(40);
+    // Link loss, relative to the start of the request.
+    QuicTime::Delta handover_time = QuicTime::Delta::FromMilliseconds(200);
+    // From link loss to the removal of the default route.
+    QuicTime::Delta l2l3_delay = QuicTime::Delta::Zero();
+    QuicTime::Delta rlt_interval = QuicTime::Delta::FromMilliseconds(10);
+    QuicByteCount file_size = 1000000;
+    double loss_rate = 0;
+    uint64_t seed = 1;
+  };
+
+  struct Result {
+    bool success = false;
+    // False if the download was done before the handover.
+    bool handover_during_request = false;
+    QuicTime::Delta handover_delay = QuicTime::Delta::Zero();
+    QuicTime::Delta total_time = QuicTime::Delta::Zero();
+    QuicTime::Delta max_stall = QuicTime::Delta::Zero();
+  };
+
+  // Gives up on a download after this much simulated time.
+  static const int64_t kRunTimeoutSecs = 120;
+
+  static Result Run(const Config& config) {
+    const char kHost[] = "www.example.org";
+    const char kPath[] = "/file";
+    const char kSourceAddressTokenSecret[] = "secret";
+
+    test::SimpleRandom random;
+    random.set_seed(config.seed);
+    simulator::Simulator simulator(&random);
+
+    QuicIpAddress server_host;
+    server_host.FromString("10.0.0.1");
+    SimulatedNetwork network(&simulator, QuicSocketAddress(server_host, 443));
+    network.AddInterface(MakeInterface("iface1", "192.168.1.2", "192.168.1.1",
+                                       100, config));
+    network.AddInterface(MakeInterface("iface2", "192.168.2.2", "192.168.2.1",
+                                       600, config));
+
+    QuicMemoryCacheBackend backend;
+    backend.AddSimpleResponse(kHost, kPath, 200,
+                              std::string(config.file_size, 'M'));
+
+    const ParsedQuicVersionVector versions = {
+        CurrentSupportedHttp3Versions().front()};
+    QuicConfig server_config;
+    server_config.SetInitialStreamFlowControlWindowToSend(64 * 1024);
+    server_config.SetInitialSessionFlowControlWindowToSend(1024 * 1024);
+    QuicCryptoServerConfig crypto_config(
+        kSourceAddressTokenSecret, &random,
+        crypto_test_utils::ProofSourceForTesting(),
+        KeyExchangeSource::Default());
+    std::unique_ptr<CryptoHandshakeMessage> scfg(crypto_config.AddDefaultConfig(
+        &random, simulator.GetClock(),
+        QuicCryptoServerConfig::ConfigOptions()));
+    QuicVersionManager version_manager(versions);
+    QuicSimpleDispatcher dispatcher(
+        &server_config, &crypto_config, &version_manager,
+        std::make_unique<SimulatedConnectionHelper>(&simulator),
+        std::make_unique<QuicSimpleCryptoServerStreamHelper>(),
+        std::make_unique<SimulatedAlarmFactory>(&simulator), &backend,
+        kQuicDefaultConnectionIdLength);
+    dispatcher.InitializeWithWriter(
+        new SimulatedPacketWriter(&network, network.server_address()));
+    network.set_dispatcher(&dispatcher);
+
+    SimulatedQuicClient client(&simulator, &network,
+                               QuicServerId(kHost, 443, false), versions,
+                               QuicConfig());
+    client.set_enable_route_monitor(config.monitor_routes);
+    client.set_store_response(true);
+
+    Result result;
+    if (!client.Initialize() || !client.Connect()) {
+      return result;
+    }
+    PrepareConnection(&client, config);
+
+    spdy::Http2HeaderBlock header_block;
+    header_block[":method"] = "GET";
+    header_block[":scheme"] = "https";
+    header_block[":authority"] = kHost;
+    header_block[":path"] = kPath;
+
+    const QuicClock* clock = simulator.GetClock();
+    const QuicTime start = clock->Now();
+    const QuicTime deadline =
+        start + QuicTime::Delta::FromSeconds(kRunTimeoutSecs);
+    SimulatedHandover handover(&simulator, &network, "iface1",
+                               start + config.handover_time,
+                               config.l2l3_delay);
+    HandoverProgressProbe probe(&simulator, &client,
+                                start + config.handover_time);
+    while (clock->Now() < deadline) {
+      const int sessions_replaced = client.num_sessions_replaced();
+      client.SendRequestAndWaitForResponse(header_block, "", /*fin=*/true);
+      if (client.num_sessions_replaced() != sessions_replaced) {
+        // A connection attempt on the other route won the race of the
+        // reconnect below while the request was open.
+        probe.OnNewSession();
+        PrepareConnection(&client, config);
+        continue;
+      }
+      if (client.connected()) {
+        result.success = client.latest_response_code() == 200 &&
+                         client.latest_response_body().size() ==
+                             config.file_size;
+        break;
+      }
+      // The connection did not survive the handover: reconnect, racing the
+      // default routes, and request the file again, like the toy client
+      // does. The memory cache backend has no range requests, so the whole
+      // file is sent again.
+      if (!client.Reconnect()) {
+        if (!client.initialized()) {
+          break;
+        }
+        continue;
+      }
+      probe.OnNewSession();
+      PrepareConnection(&client, config);
+    }
+
+    const QuicTime end = clock->Now();
+    result.total_time = end - start;
+    result.handover_during_request = end > start + config.handover_time;
+    result.handover_delay = result.handover_during_request
+                                ? probe.handover_delay()
+                                : QuicTime::Delta::Zero();
+    result.max_stall = probe.max_stall();
+    if (client.initialized()) {
+      client.Disconnect();
+    }
+    return result;
+  }
+
+ private:
+  static SimulatedInterface MakeInterface(const std::string& name,
+                                          const std::string& host,
+                                          const std::string& gateway,
+                                          uint32_t metric,
+                                          const Config& config) {
+    SimulatedInterface interface;
+    interface.name = name;
+    interface.host.FromString(host);
+    interface.gateway.FromString(gateway);
+    interface.metric = metric;
+    interface.one_way_delay = config.rtt * 0.5;
+    interface.loss_rate = config.loss_rate;
+    return interface;
+  }
+
+  static void PrepareConnection(QuicClientBase* client, const Config& config) {
+    QuicConnection* connection = client->session()->connection();
+    connection->InitHandoverValue();
+    connection->SetActiveCM(config.use_migration);
+    connection->SetRltInterval(config.rlt_interval.ToMilliseconds());
+  }
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_TOOLS_QUIC_HANDOVER_SIMULATOR_H_
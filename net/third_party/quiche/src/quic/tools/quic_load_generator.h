@@ -0,0 +1,508 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// [SD] A load generator for the server. Thousands of QuicClients share the
+// epoll servers of a few worker threads and keep a mix of requests in flight,
+// and handovers are triggered per connection by validating a path from
+// another local address or port and moving to it, so neither routing tables
+// nor root are touched.
+
+#ifndef QUICHE_QUIC_TOOLS_QUIC_LOAD_GENERATOR_H_
+#define QUICHE_QUIC_TOOLS_QUIC_LOAD_GENERATOR_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "third_party/boringssl/src/include/openssl/ssl.h"
+#include "quic/core/crypto/proof_verifier.h"
+#include "quic/core/crypto/quic_client_session_cache.h"
+#include "quic/core/crypto/transport_parameters.h"
+#include "quic/core/quic_config.h"
+#include "quic/core/quic_connection.h"
+#include "quic/core/quic_epoll_clock.h"
+#include "quic/core/quic_server_id.h"
+#include "quic/core/quic_time.h"
+#include "quic/core/quic_types.h"
+#include "quic/core/quic_versions.h"
+#include "quic/platform/api/quic_epoll.h"
+#include "quic/platform/api/quic_ip_address.h"
+#include "quic/platform/api/quic_logging.h"
+#include "quic/platform/api/quic_socket_address.h"
+#include "quic/tools/quic_client.h"
+#include "quic/tools/quic_spdy_client_base.h"
+#include "spdy/core/spdy_header_block.h"
+
+namespace quic {
+
+class QuicLoadGenerator {
+ public:
+  struct Config {
+    QuicSocketAddress server_address;
+    QuicServerId server_id;
+    // :authority of the requests.
+    std::string authority;
+    ParsedQuicVersionVector versions;
+    QuicConfig quic_config;
+    // Called on the worker threads, once per client.
+    std::function<std::unique_ptr<ProofVerifier>()> create_proof_verifier;
+    // If true, each connection keeps its session cache across restarts and
+    // reconnects in 0-RTT.
+    bool enable_zerortt = false;
+
+    int num_connections = 0;
+    int num_threads = 1;
+    // Requests each connection keeps in flight.
+    int streams_per_connection = 1;
+    // Paths to request and their weights.
+    std::vector<std::pair<std::string, int>> request_mix;
+    QuicTime::Delta duration = QuicTime::Delta::Zero();
+    // Connections are started evenly over this time.
+    QuicTime::Delta ramp_up = QuicTime::Delta::Zero();
+    // Mean time between the handovers of a connection. Zero disables them.
+    QuicTime::Delta migration_interval = QuicTime::Delta::Zero();
+    // Local addresses connections are spread over and migrate between. If
+    // empty, a handover only changes the local port.
+    std::vector<QuicIpAddress> local_addresses;
+    uint64_t seed = 0;
+  };
+
+  struct Result {
+    void Merge(const Result& other) {
+      requests_succeeded += other.requests_succeeded;
+      requests_failed += other.requests_failed;
+      bytes_received += other.bytes_received;
+      latencies.insert(latencies.end(), other.latencies.begin(),
+                       other.latencies.end());
+      zero_rtt_handshake_times.insert(zero_rtt_handshake_times.end(),
+                                      other.zero_rtt_handshake_times.begin(),
+                                      other.zero_rtt_handshake_times.end());
+      one_rtt_handshake_times.insert(one_rtt_handshake_times.end(),
+                                     other.one_rtt_handshake_times.begin(),
+                                     other.one_rtt_handshake_times.end());
+      connect_failures += other.connect_failures;
+      connections_closed += other.connections_closed;
+      migrations_attempted += other.migrations_attempted;
+      migrations_succeeded += other.migrations_succeeded;
+      duration = std::max(duration, other.duration);
+    }
+
+    int64_t requests_succeeded = 0;
+    int64_t requests_failed = 0;
+    uint64_t bytes_received = 0;
+    // Time from sending a request to its complete response.
+    std::vector<QuicTime::Delta> latencies;
+    // Time from starting a connection to being able to send on it, for
+    // connections whose early data the server accepted, and for the others,
+    // which could only send once the handshake completed. Connections that
+    // close before the handshake completes are in neither.
+    std::vector<QuicTime::Delta> zero_rtt_handshake_times;
+    std::vector<QuicTime::Delta> one_rtt_handshake_times;
+    // Connections that closed before the handshake completed.
+    int64_t connect_failures = 0;
+    // Connections that closed after the handshake. They are started again.
+    int64_t connections_closed = 0;
+    // A migration validates the new path with a PATH_CHALLENGE before moving
+    // the connection to it. It succeeds when a response completes after the
+    // connection moved, and fails when the validation fails or the
+    // connection closes first. Only one migration per connection is pending
+    // at a time.
+    int64_t migrations_attempted = 0;
+    int64_t migrations_succeeded = 0;
+    QuicTime::Delta duration = QuicTime::Delta::Zero();
+  };
+
+  // Runs the load of |config| and returns the results of all workers.
+  // Connection i runs on worker i % num_threads.
+  static Result Run(const Config& config) {
+    std::vector<Result> results(config.num_threads);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < config.num_threads; ++i) {
+      threads.emplace_back(
+          [&config, &results, i] { results[i] = Worker(config, i).Run(); });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    Result result;
+    for (const Result& worker_result : results) {
+      result.Merge(worker_result);
+    }
+    return result;
+  }
+
+ private:
+  // Drives the connections of one thread on its own epoll server. Nothing is
+  // shared with the other workers but |config_|, which is read only.
+  class Worker {
+   public:
+    Worker(const Config& config, int index)
+        : config_(config),
+          index_(index),
+          clock_(&epoll_server_),
+          generator_(config.seed + index) {
+      std::vector<int> weights;
+      for (const auto& request : config_.request_mix) {
+        weights.push_back(request.second);
+      }
+      request_distribution_ =
+          std::discrete_distribution<size_t>(weights.begin(), weights.end());
+      epoll_server_.set_timeout_in_us(kEventLoopTimeoutUs);
+    }
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    Result Run() {
+      const QuicTime start = clock_.Now();
+      const QuicTime deadline = start + config_.duration;
+      for (int i = index_; i < config_.num_connections;
+           i += config_.num_threads) {
+        auto connection = std::make_unique<Connection>();
+        connection->index = i;
+        if (config_.enable_zerortt) {
+          connection->session_cache =
+              std::make_unique<QuicClientSessionCache>();
+        }
+        connection->start_time =
+            start + config_.ramp_up *
+                        (static_cast<double>(i) / config_.num_connections);
+        connections_.push_back(std::move(connection));
+      }
+
+      while (clock_.Now() < deadline) {
+        epoll_server_.WaitForEventsAndExecuteCallbacks();
+        const QuicTime now = clock_.Now();
+        for (const auto& connection : connections_) {
+          Drive(connection.get(), now);
+        }
+      }
+      // Requests still in flight at the deadline are not counted.
+      for (const auto& connection : connections_) {
+        connection->requests.clear();
+        connection->client.reset();
+      }
+      result_.duration = clock_.Now() - start;
+      return std::move(result_);
+    }
+
+   private:
+    // Longest wait for events, so that connections are driven on time.
+    static constexpr int64_t kEventLoopTimeoutUs = 5000;
+    // Delay before a closed connection is started again.
+    static constexpr int64_t kRestartDelayMs = 100;
+
+    struct Connection {
+      int index = 0;
+      // Kept across restarts, so that they resume in 0-RTT. Declared before
+      // |client| so that it outlives it.
+      std::unique_ptr<QuicClientSessionCache> session_cache;
+      std::unique_ptr<QuicClient> client;
+      QuicTime start_time = QuicTime::Zero();
+      // When the connection could first send, until the handshake completed.
+      QuicTime established_time = QuicTime::Zero();
+      QuicTime next_migration_time = QuicTime::Zero();
+      bool established = false;
+      bool handshake_complete = false;
+      bool migration_pending = false;
+      // Start of the pending migration and its socket, and the socket it
+      // moves away from until one of the two is closed.
+      QuicTime migration_time = QuicTime::Zero();
+      QuicSocketAddress migration_address;
+      QuicSocketAddress migration_from;
+      size_t next_address = 0;
+      // Send time of the requests in flight, by stream.
+      std::map<QuicStreamId, QuicTime> requests;
+    };
+
+    // Hands the session cache of a Connection to each of its clients, which
+    // own the cache they are given.
+    class ForwardingSessionCache : public SessionCache {
+     public:
+      explicit ForwardingSessionCache(SessionCache* cache) : cache_(cache) {}
+
+      void Insert(const QuicServerId& server_id,
+                  bssl::UniquePtr<SSL_SESSION> session,
+                  const TransportParameters& params,
+                  const ApplicationState* application_state) override {
+        cache_->Insert(server_id, std::move(session), params,
+                       application_state);
+      }
+
+      std::unique_ptr<QuicResumptionState> Lookup(
+          const QuicServerId& server_id,
+          QuicWallTime now,
+          const SSL_CTX* ctx) override {
+        return cache_->Lookup(server_id, now, ctx);
+      }
+
+      void ClearEarlyData(const QuicServerId& server_id) override {
+        cache_->ClearEarlyData(server_id);
+      }
+
+      void OnNewTokenReceived(const QuicServerId& server_id,
+                              absl::string_view token) override {
+        cache_->OnNewTokenReceived(server_id, token);
+      }
+
+      void RemoveExpiredEntries(QuicWallTime now) override {
+        cache_->RemoveExpiredEntries(now);
+      }
+
+      void Clear() override { cache_->Clear(); }
+
+     private:
+      SessionCache* cache_;
+    };
+
+    class ResponseListener : public QuicSpdyClientBase::ResponseListener {
+     public:
+      ResponseListener(Worker* worker, Connection* connection)
+          : worker_(worker), connection_(connection) {}
+
+      void OnCompleteResponse(QuicStreamId id,
+                              const spdy::Http2HeaderBlock& response_headers,
+                              const std::string& response_body) override {
+        worker_->OnResponse(connection_, id, response_headers,
+                            response_body.size());
+      }
+
+     private:
+      Worker* worker_;
+      Connection* connection_;
+    };
+
+    void Drive(Connection* connection, QuicTime now) {
+      if (connection->client == nullptr) {
+        if (now >= connection->start_time) {
+          Start(connection, now);
+        }
+        return;
+      }
+      QuicClient* client = connection->client.get();
+      if (!client->connected()) {
+        // Streams were closed with the connection and counted as failed.
+        if (connection->established) {
+          result_.connections_closed++;
+        } else {
+          result_.connect_failures++;
+        }
+        connection->requests.clear();
+        connection->client.reset();
+        connection->start_time =
+            now + QuicTime::Delta::FromMilliseconds(kRestartDelayMs);
+        return;
+      }
+      if (!connection->established) {
+        if (!client->session()->IsEncryptionEstablished()) {
+          return;
+        }
+        connection->established = true;
+        connection->established_time = now;
+        connection->next_migration_time = now + NextMigrationDelay();
+      }
+      if (!connection->handshake_complete &&
+          client->session()->OneRttKeysAvailable()) {
+        connection->handshake_complete = true;
+        // A client that resumed in 0-RTT sent before the handshake completed,
+        // unless the server rejected its early data.
+        if (client->EarlyDataAccepted()) {
+          result_.zero_rtt_handshake_times.push_back(
+              connection->established_time - connection->start_time);
+        } else {
+          result_.one_rtt_handshake_times.push_back(now -
+                                                    connection->start_time);
+        }
+      }
+
+      CheckMigration(connection);
+      if (config_.migration_interval > QuicTime::Delta::Zero() &&
+          now >= connection->next_migration_time) {
+        if (!connection->migration_pending) {
+          Migrate(connection, now);
+        }
+        connection->next_migration_time = now + NextMigrationDelay();
+      }
+
+      while (static_cast<int>(connection->requests.size()) <
+                 config_.streams_per_connection &&
+             client->connected() &&
+             client->client_session()
+                 ->CanOpenNextOutgoingBidirectionalStream()) {
+        QuicSpdyClientStream* stream = client->CreateClientStream();
+        if (stream == nullptr) {
+          break;
+        }
+        connection->requests[stream->id()] = now;
+        stream->SendRequest(NextRequest(), "", /*fin=*/true);
+      }
+    }
+
+    void Start(Connection* connection, QuicTime now) {
+      std::unique_ptr<SessionCache> session_cache;
+      if (connection->session_cache != nullptr) {
+        session_cache = std::make_unique<ForwardingSessionCache>(
+            connection->session_cache.get());
+      }
+      auto client = std::make_unique<QuicClient>(
+          config_.server_address, config_.server_id, config_.versions,
+          config_.quic_config, &epoll_server_,
+          config_.create_proof_verifier(), std::move(session_cache));
+      // Thousands of clients must not each watch the routing table, and
+      // handovers are driven by Migrate() instead.
+      client->set_enable_route_monitor(false);
+      if (!config_.local_addresses.empty()) {
+        connection->next_address =
+            connection->index % config_.local_addresses.size();
+        client->set_bind_to_address(
+            config_.local_addresses[connection->next_address]);
+      }
+      client->set_response_listener(
+          std::make_unique<ResponseListener>(this, connection));
+      connection->established = false;
+      connection->handshake_complete = false;
+      // A migration still pending on the previous client failed with it.
+      connection->migration_pending = false;
+      connection->migration_from = QuicSocketAddress();
+      connection->start_time = now;
+      const bool initialized = client->Initialize();
+      // Binding a socket resets the event loop timeout.
+      epoll_server_.set_timeout_in_us(kEventLoopTimeoutUs);
+      if (!initialized) {
+        result_.connect_failures++;
+        connection->start_time =
+            now + QuicTime::Delta::FromMilliseconds(kRestartDelayMs);
+        return;
+      }
+      client->StartConnect();
+      connection->client = std::move(client);
+    }
+
+    // Validates a path from the next local address, or from a new port if
+    // there is only one, and moves |connection| to it once the server
+    // answered the PATH_CHALLENGE.
+    void Migrate(Connection* connection, QuicTime now) {
+      QuicClient* client = connection->client.get();
+      QuicConnection* quic_connection = client->session()->connection();
+      if (!VersionHasIetfQuicFrames(quic_connection->transport_version()) ||
+          !quic_connection->use_path_validator()) {
+        QUIC_LOG_FIRST_N(WARNING, 1)
+            << "Path validation is not supported, no migrations";
+        return;
+      }
+      result_.migrations_attempted++;
+      QuicIpAddress host;
+      if (config_.local_addresses.size() > 1) {
+        connection->next_address =
+            (connection->next_address + 1) % config_.local_addresses.size();
+        host = config_.local_addresses[connection->next_address];
+      } else {
+        host = client->network_helper()->GetLatestClientAddress().host();
+      }
+      const QuicSocketAddress from =
+          client->network_helper()->GetLatestClientAddress();
+      const bool started = client->ValidateAndMigrateSocket(host);
+      epoll_server_.set_timeout_in_us(kEventLoopTimeoutUs);
+      if (!started) {
+        return;
+      }
+      connection->migration_pending = true;
+      connection->migration_time = now;
+      connection->migration_address =
+          client->network_helper()->GetLatestClientAddress();
+      connection->migration_from = from;
+    }
+
+    // Closes the socket the last migration of |connection| left behind: the
+    // old one once the connection moved, or the new one if the validation
+    // failed.
+    void CheckMigration(Connection* connection) {
+      if (!connection->migration_from.IsInitialized()) {
+        return;
+      }
+      QuicClient* client = connection->client.get();
+      QuicConnection* quic_connection = client->session()->connection();
+      if (quic_connection->self_address() == connection->migration_address) {
+        client->network_helper()->CleanUpUDPSocket(connection->migration_from);
+        connection->migration_from = QuicSocketAddress();
+        return;
+      }
+      if (quic_connection->HasPendingPathValidation()) {
+        return;
+      }
+      connection->migration_pending = false;
+      client->network_helper()->CleanUpUDPSocket(
+          connection->migration_address);
+      client->network_helper()->ActivateUDPSocket(connection->migration_from);
+      connection->migration_from = QuicSocketAddress();
+    }
+
+    QuicTime::Delta NextMigrationDelay() {
+      // Spread over half to one and a half intervals, so that connections
+      // started together do not migrate together.
+      std::uniform_real_distribution<double> jitter(0.5, 1.5);
+      return config_.migration_interval * jitter(generator_);
+    }
+
+    spdy::Http2HeaderBlock NextRequest() {
+      spdy::Http2HeaderBlock headers;
+      headers[":method"] = "GET";
+      headers[":scheme"] = "https";
+      headers[":authority"] = config_.authority;
+      headers[":path"] =
+          config_.request_mix[request_distribution_(generator_)].first;
+      return headers;
+    }
+
+    void OnResponse(Connection* connection,
+                    QuicStreamId id,
+                    const spdy::Http2HeaderBlock& response_headers,
+                    size_t body_size) {
+      auto it = connection->requests.find(id);
+      if (it == connection->requests.end()) {
+        return;
+      }
+      const QuicTime::Delta latency = clock_.Now() - it->second;
+      connection->requests.erase(it);
+      auto status = response_headers.find(":status");
+      if (status == response_headers.end() || status->second != "200") {
+        result_.requests_failed++;
+        return;
+      }
+      result_.requests_succeeded++;
+      result_.bytes_received += body_size;
+      result_.latencies.push_back(latency);
+      // Only a response that completed on the new path, after the
+      // migration started, shows that the migration worked.
+      if (connection->migration_pending &&
+          clock_.Now() > connection->migration_time &&
+          connection->client->session()->connection()->self_address() ==
+              connection->migration_address) {
+        connection->migration_pending = false;
+        result_.migrations_succeeded++;
+      }
+    }
+
+    const Config& config_;
+    const int index_;
+    // Declared before the connections, whose clients use it.
+    QuicEpollServer epoll_server_;
+    QuicEpollClock clock_;
+    std::mt19937_64 generator_;
+    std::discrete_distribution<size_t> request_distribution_;
+    std::vector<std::unique_ptr<Connection>> connections_;
+    Result result_;
+  };
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_TOOLS_QUIC_LOAD_GENERATOR_H_
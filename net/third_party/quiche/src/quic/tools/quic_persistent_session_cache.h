@@ -0,0 +1,314 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// [SD] A client session cache that outlives the process. A client that is
+// started again, e.g. by quic_nc.sh after the network went away, resumes the
+// TLS session of the previous run and sends its first request in 0-RTT
+// instead of waiting for a full handshake.
+
+#ifndef QUICHE_QUIC_TOOLS_QUIC_PERSISTENT_SESSION_CACHE_H_
+#define QUICHE_QUIC_TOOLS_QUIC_PERSISTENT_SESSION_CACHE_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "third_party/boringssl/src/include/openssl/ssl.h"
+#include "quic/core/crypto/quic_client_session_cache.h"
+#include "quic/core/crypto/transport_parameters.h"
+#include "quic/core/quic_server_id.h"
+#include "quic/core/quic_time.h"
+#include "quic/core/quic_versions.h"
+#include "quic/platform/api/quic_logging.h"
+
+namespace quic {
+
+// Sessions are held by a QuicClientSessionCache. Every change is also written
+// to a file, one line per server with the latest session ticket, the
+// transport parameters and application state it may be resumed with in
+// 0-RTT, and the last NEW_TOKEN token. The file is replaced by a rename, so a
+// client that dies while saving leaves the previous version.
+class QuicPersistentSessionCache : public SessionCache {
+ public:
+  // Loads the entries saved in |file_name|, if any. Transport parameters are
+  // saved in the encoding of |version|.
+  QuicPersistentSessionCache(std::string file_name, ParsedQuicVersion version)
+      : file_name_(std::move(file_name)), version_(version) {
+    Load();
+  }
+
+  QuicPersistentSessionCache(const QuicPersistentSessionCache&) = delete;
+  QuicPersistentSessionCache& operator=(const QuicPersistentSessionCache&) =
+      delete;
+
+  ~QuicPersistentSessionCache() override = default;
+
+  // SessionCache methods.
+  void Insert(const QuicServerId& server_id,
+              bssl::UniquePtr<SSL_SESSION> session,
+              const TransportParameters& params,
+              const ApplicationState* application_state) override {
+    Entry entry;
+    if (Serialize(session.get(), params, application_state, &entry)) {
+      entry.token = entries_[server_id].token;
+      entries_[server_id] = std::move(entry);
+    } else {
+      entries_.erase(server_id);
+    }
+    Save();
+    cache_.Insert(server_id, std::move(session), params, application_state);
+  }
+
+  std::unique_ptr<QuicResumptionState> Lookup(const QuicServerId& server_id,
+                                              QuicWallTime now,
+                                              const SSL_CTX* ctx) override {
+    // Saved sessions can only be parsed with the SSL_CTX of the connection,
+    // so they reach |cache_| on their first lookup.
+    auto it = entries_.find(server_id);
+    if (it != entries_.end() && !it->second.in_cache) {
+      it->second.in_cache = true;
+      if (!AddToCache(server_id, it->second, ctx)) {
+        entries_.erase(it);
+        Save();
+      }
+    }
+    return cache_.Lookup(server_id, now, ctx);
+  }
+
+  // The server rejected 0-RTT, so the saved parameters are stale. The
+  // session stays in |cache_| for resumption without early data, the saved
+  // entry is dropped until the server sends a new ticket.
+  void ClearEarlyData(const QuicServerId& server_id) override {
+    cache_.ClearEarlyData(server_id);
+    if (entries_.erase(server_id) > 0) {
+      Save();
+    }
+  }
+
+  void OnNewTokenReceived(const QuicServerId& server_id,
+                          absl::string_view token) override {
+    cache_.OnNewTokenReceived(server_id, token);
+    auto it = entries_.find(server_id);
+    if (it != entries_.end()) {
+      it->second.token = std::string(token);
+      Save();
+    }
+  }
+
+  void RemoveExpiredEntries(QuicWallTime now) override {
+    cache_.RemoveExpiredEntries(now);
+    bool removed = false;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (it->second.expiry_time <= now.ToUNIXSeconds()) {
+        it = entries_.erase(it);
+        removed = true;
+      } else {
+        ++it;
+      }
+    }
+    if (removed) {
+      Save();
+    }
+  }
+
+  void Clear() override {
+    cache_.Clear();
+    entries_.clear();
+    Save();
+  }
+
+ private:
+  // A saved session, serialized as in the file.
+  struct Entry {
+    std::string session;
+    std::string params;
+    bool has_application_state = false;
+    std::string application_state;
+    std::string token;
+    // UNIX time in seconds after which the session cannot be resumed.
+    uint64_t expiry_time = 0;
+    // True once the entry was handed to |cache_|.
+    bool in_cache = true;
+  };
+
+  bool Serialize(const SSL_SESSION* session,
+                 const TransportParameters& params,
+                 const ApplicationState* application_state,
+                 Entry* entry) const {
+    uint8_t* session_data = nullptr;
+    size_t session_length = 0;
+    if (session == nullptr ||
+        !SSL_SESSION_to_bytes(session, &session_data, &session_length)) {
+      return false;
+    }
+    entry->session.assign(reinterpret_cast<const char*>(session_data),
+                          session_length);
+    OPENSSL_free(session_data);
+    entry->expiry_time =
+        SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session);
+
+    std::vector<uint8_t> serialized_params;
+    if (!SerializeTransportParameters(version_, params, &serialized_params)) {
+      QUIC_LOG(WARNING) << "Failed to serialize transport parameters, the "
+                           "session is not saved";
+      return false;
+    }
+    entry->params.assign(serialized_params.begin(), serialized_params.end());
+    entry->has_application_state = application_state != nullptr;
+    if (application_state != nullptr) {
+      entry->application_state.assign(application_state->begin(),
+                                      application_state->end());
+    }
+    return true;
+  }
+
+  // Parses |entry| with |ctx| and inserts it into |cache_|. Returns false if
+  // the entry cannot be parsed.
+  bool AddToCache(const QuicServerId& server_id,
+                  const Entry& entry,
+                  const SSL_CTX* ctx) {
+    bssl::UniquePtr<SSL_SESSION> session(SSL_SESSION_from_bytes(
+        reinterpret_cast<const uint8_t*>(entry.session.data()),
+        entry.session.size(), ctx));
+    if (session == nullptr) {
+      QUIC_LOG(WARNING) << "Dropping unreadable session for "
+                        << server_id.ToHostPortString();
+      return false;
+    }
+    TransportParameters params;
+    std::string error_details;
+    if (!ParseTransportParameters(
+            version_, Perspective::IS_SERVER,
+            reinterpret_cast<const uint8_t*>(entry.params.data()),
+            entry.params.size(), &params, &error_details)) {
+      QUIC_LOG(WARNING) << "Dropping session for "
+                        << server_id.ToHostPortString()
+                        << " with unreadable transport parameters: "
+                        << error_details;
+      return false;
+    }
+    const ApplicationState application_state(entry.application_state.begin(),
+                                             entry.application_state.end());
+    cache_.Insert(server_id, std::move(session), params,
+                  entry.has_application_state ? &application_state : nullptr);
+    if (!entry.token.empty()) {
+      cache_.OnNewTokenReceived(server_id, entry.token);
+    }
+    return true;
+  }
+
+  // Reads the file, skipping malformed and expired lines. Each line is
+  // "host port privacy_mode expiry_time session params application_state
+  // token", binary fields in base64 and a missing application state as "-".
+  void Load() {
+    std::ifstream file(file_name_);
+    if (!file.is_open()) {
+      return;
+    }
+    const uint64_t now = static_cast<uint64_t>(std::time(nullptr));
+    std::string line;
+    while (std::getline(file, line)) {
+      std::vector<absl::string_view> fields = absl::StrSplit(line, ' ');
+      uint32_t port = 0;
+      Entry entry;
+      entry.in_cache = false;
+      if (fields.size() != 8 || !absl::SimpleAtoi(fields[1], &port) ||
+          port > 0xffff || (fields[2] != "0" && fields[2] != "1") ||
+          !absl::SimpleAtoi(fields[3], &entry.expiry_time) ||
+          !absl::Base64Unescape(fields[4], &entry.session) ||
+          !absl::Base64Unescape(fields[5], &entry.params) ||
+          !absl::Base64Unescape(fields[7], &entry.token)) {
+        QUIC_LOG(WARNING) << "Ignoring malformed line in " << file_name_;
+        continue;
+      }
+      entry.has_application_state = fields[6] != "-";
+      if (entry.has_application_state &&
+          !absl::Base64Unescape(fields[6], &entry.application_state)) {
+        QUIC_LOG(WARNING) << "Ignoring malformed line in " << file_name_;
+        continue;
+      }
+      if (entry.expiry_time <= now) {
+        continue;
+      }
+      entries_[QuicServerId(std::string(fields[0]),
+                            static_cast<uint16_t>(port), fields[2] == "1")] =
+          std::move(entry);
+    }
+  }
+
+  void Save() const {
+    std::string contents;
+    for (const auto& it : entries_) {
+      const Entry& entry = it.second;
+      absl::StrAppend(
+          &contents, it.first.host(), " ", it.first.port(), " ",
+          it.first.privacy_mode_enabled() ? 1 : 0, " ", entry.expiry_time, " ",
+          absl::Base64Escape(entry.session), " ",
+          absl::Base64Escape(entry.params), " ",
+          entry.has_application_state
+              ? absl::Base64Escape(entry.application_state)
+              : "-",
+          " ", absl::Base64Escape(entry.token), "\n");
+    }
+
+    // Session tickets and tokens let anyone resume the sessions, so only the
+    // owner may read the file. A temp file left by an earlier run may have
+    // been created with other permissions.
+    const std::string temp_file_name = file_name_ + ".tmp";
+    const int fd = open(temp_file_name.c_str(),
+                        O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0600);
+    if (fd < 0) {
+      QUIC_LOG(ERROR) << "Failed to open " << temp_file_name;
+      return;
+    }
+    bool ok = fchmod(fd, 0600) == 0;
+    for (size_t offset = 0; ok && offset < contents.size();) {
+      const ssize_t written =
+          write(fd, contents.data() + offset, contents.size() - offset);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      ok = written > 0;
+      if (ok) {
+        offset += written;
+      }
+    }
+    if (close(fd) != 0) {
+      ok = false;
+    }
+    if (!ok) {
+      QUIC_LOG(ERROR) << "Failed to write " << temp_file_name;
+      unlink(temp_file_name.c_str());
+      return;
+    }
+    if (rename(temp_file_name.c_str(), file_name_.c_str()) != 0) {
+      QUIC_LOG(ERROR) << "Failed to replace " << file_name_;
+    }
+  }
+
+  const std::string file_name_;
+  const ParsedQuicVersion version_;
+  QuicClientSessionCache cache_;
+  std::map<QuicServerId, Entry> entries_;
+};
+
+}  // namespace quic
+
+#endif  // QUICHE_QUIC_TOOLS_QUIC_PERSISTENT_SESSION_CACHE_H_
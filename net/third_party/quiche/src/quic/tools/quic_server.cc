@@ -14,6 +14,7 @@
 #include <cstdint>
 #include <memory>
 
+#include "quic/core/batch_writer/quic_gso_batch_writer.h"
 #include "quic/core/crypto/crypto_handshake.h"
 #include "quic/core/crypto/quic_random.h"
 #include "quic/core/quic_clock.h"
@@ -23,11 +24,14 @@
 #include "quic/core/quic_dispatcher.h"
 #include "quic/core/quic_epoll_alarm_factory.h"
 #include "quic/core/quic_epoll_connection_helper.h"
+#include "quic/core/quic_linux_socket_utils.h"
 #include "quic/core/quic_packet_reader.h"
 #include "quic/core/quic_packets.h"
 #include "quic/platform/api/quic_flags.h"
 #include "quic/platform/api/quic_logging.h"
 #include "net/quic/platform/impl/quic_epoll_clock.h"
+#include "quic/tools/quic_file_backend.h"
+#include "quic/tools/quic_file_dispatcher.h"
 #include "quic/tools/quic_simple_crypto_server_stream_helper.h"
 #include "quic/tools/quic_simple_dispatcher.h"
 #include "quic/tools/quic_simple_server_backend.h"
@@ -81,7 +85,13 @@ QuicServer::QuicServer(
       packet_reader_(new QuicPacketReader()),
       quic_simple_server_backend_(quic_simple_server_backend),
       expected_server_connection_id_length_(
-          expected_server_connection_id_length) {
+          expected_server_connection_id_length),
+      worker_steering_(nullptr),
+      worker_id_(0),
+      use_gso_(false),
+      enable_multipath_(false),
+      transport_metrics_interval_(QuicTime::Delta::Zero()),
+      file_backend_(nullptr) {
   QUICHE_DCHECK(quic_simple_server_backend_);
   Initialize();
 }
@@ -125,6 +135,17 @@ bool QuicServer::CreateUDPSocketAndListen(const QuicSocketAddress& address) {
   overflow_supported_ = socket_api.EnableDroppedPacketCount(fd_);
   socket_api.EnableReceiveTimestamp(fd_);
 
+  // [SD] Workers bind to the same address and the kernel shards clients
+  // between them.
+  if (worker_steering_ != nullptr) {
+    int reuse_port = 1;
+    if (setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &reuse_port,
+                   sizeof(reuse_port)) != 0) {
+      QUIC_LOG(ERROR) << "Failed to set SO_REUSEPORT: " << strerror(errno);
+      return false;
+    }
+  }
+
   sockaddr_storage addr = address.generic_address();
   int rc = bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
   if (rc < 0) {
@@ -145,6 +166,15 @@ bool QuicServer::CreateUDPSocketAndListen(const QuicSocketAddress& address) {
   epoll_server_.RegisterFD(fd_, this, kEpollFlags);
   dispatcher_.reset(CreateQuicDispatcher());
   dispatcher_->InitializeWithWriter(CreateWriter(fd_));
+  dispatcher_->SetEnableMultipath(enable_multipath_);
+  if (worker_steering_ != nullptr) {
+    dispatcher_->SetWorkerSteering(worker_steering_, worker_id_);
+    epoll_server_.RegisterFD(worker_steering_->wakeup_fd(worker_id_), this,
+                             EPOLLIN);
+  }
+  if (transport_metrics_interval_ > QuicTime::Delta::Zero()) {
+    dispatcher_->StartTransportMetrics(transport_metrics_interval_);
+  }
 
   return true;
 }
@@ -153,12 +183,48 @@ void QuicServer::SetMquicCwnd(int cwnd_size) {
   dispatcher_->SetMquicCwnd(cwnd_size);
 }
 
+bool QuicServer::SetWorker(QuicWorkerSteering* worker_steering,
+                           int worker_id) {
+  QUICHE_DCHECK(dispatcher_ == nullptr);
+  worker_steering_ = worker_steering;
+  worker_id_ = worker_id;
+  return true;
+}
+
+bool QuicServer::SetFileBackend(QuicFileBackend* backend) {
+  QUICHE_DCHECK(dispatcher_ == nullptr);
+  file_backend_ = backend;
+  return true;
+}
+
 QuicPacketWriter* QuicServer::CreateWriter(int fd) {
+  // [SD] Back-to-back packets of a connection leave in one sendmsg() as a GSO
+  // super-packet. Kernels without UDP_SEGMENT fail the probe and get one
+  // sendmsg() per packet.
+  if (use_gso_) {
+    if (QuicLinuxSocketUtils::GetUDPSegmentSize(fd) >= 0) {
+      QUIC_LOG(INFO) << "Sending with UDP GSO batches";
+      return new QuicGsoBatchWriter(fd);
+    }
+    QUIC_LOG(WARNING) << "UDP GSO is not supported, sending packet by packet";
+  }
   return new QuicDefaultPacketWriter(fd);
 }
 
 QuicDispatcher* QuicServer::CreateQuicDispatcher() {
   QuicEpollAlarmFactory alarm_factory(&epoll_server_);
+  if (file_backend_ != nullptr) {
+    return new QuicFileDispatcher(
+        &config_, &crypto_config_, &version_manager_,
+        std::unique_ptr<QuicEpollConnectionHelper>(
+            new QuicEpollConnectionHelper(&epoll_server_,
+                                          QuicAllocator::BUFFER_POOL)),
+        std::unique_ptr<QuicCryptoServerStreamBase::Helper>(
+            new QuicSimpleCryptoServerStreamHelper()),
+        std::unique_ptr<QuicEpollAlarmFactory>(
+            new QuicEpollAlarmFactory(&epoll_server_)),
+        file_backend_, expected_server_connection_id_length_);
+  }
   return new QuicSimpleDispatcher(
       &config_, &crypto_config_, &version_manager_,
       std::unique_ptr<QuicEpollConnectionHelper>(new QuicEpollConnectionHelper(
@@ -194,9 +260,19 @@ void QuicServer::Shutdown() {
 }
 
 void QuicServer::OnEvent(int fd, QuicEpollEvent* event) {
-  QUICHE_DCHECK_EQ(fd, fd_);
   event->out_ready_mask = 0;
 
+  // [SD] Packets other workers received for our connections.
+  if (worker_steering_ != nullptr &&
+      fd == worker_steering_->wakeup_fd(worker_id_)) {
+    worker_steering_->Drain(
+        worker_id_, [this](const QuicWorkerSteering::ForwardedPacket& packet) {
+          dispatcher_->ProcessForwardedPacket(packet);
+        });
+    return;
+  }
+  QUICHE_DCHECK_EQ(fd, fd_);
+
   if (event->in_events & EPOLLIN) {
     QUIC_DVLOG(1) << "EPOLLIN";
 
@@ -21,6 +21,7 @@
 #include "quic/core/quic_packet_writer.h"
 #include "quic/core/quic_udp_socket.h"
 #include "quic/core/quic_version_manager.h"
+#include "quic/core/quic_worker_steering.h"
 #include "quic/platform/api/quic_epoll.h"
 #include "quic/platform/api/quic_socket_address.h"
 #include "quic/tools/quic_simple_server_backend.h"
@@ -69,6 +70,20 @@ class QuicServer : public QuicSpdyServerBase,
 
   void SetMquicCwnd(int measure_nc) override;
 
+  bool SetWorker(QuicWorkerSteering* worker_steering, int worker_id) override;
+
+  void SetUseGso(bool use_gso) override { use_gso_ = use_gso; }
+
+  void SetEnableMultipath(bool enable_multipath) override {
+    enable_multipath_ = enable_multipath;
+  }
+
+  void SetTransportMetricsInterval(QuicTime::Delta interval) override {
+    transport_metrics_interval_ = interval;
+  }
+
+  bool SetFileBackend(QuicFileBackend* backend) override;
+
   // From EpollCallbackInterface
   void OnRegistration(QuicEpollServer* /*eps*/,
                       int /*fd*/,
@@ -166,6 +181,26 @@ class QuicServer : public QuicSpdyServerBase,
 
   // Connection ID length expected to be read on incoming IETF short headers.
   uint8_t expected_server_connection_id_length_;
+
+  // [SD] Shared by the workers of a multi-core server, not owned. The
+  // listening socket then uses SO_REUSEPORT.
+  QuicWorkerSteering* worker_steering_;
+  int worker_id_;
+
+  // [SD] If true, CreateWriter() returns a GSO batch writer when the kernel
+  // supports UDP_SEGMENT.
+  bool use_gso_;
+
+  // [SD] Passed to the dispatcher, see QuicDispatcher::SetEnableMultipath().
+  bool enable_multipath_;
+
+  // [SD] Zero unless metrics are sampled, see
+  // QuicDispatcher::StartTransportMetrics().
+  QuicTime::Delta transport_metrics_interval_;
+
+  // [SD] If set, the dispatcher creates streams that send bodies from the
+  // file mappings of this backend. Not owned.
+  QuicFileBackend* file_backend_;
 };
 
 }  // namespace quic
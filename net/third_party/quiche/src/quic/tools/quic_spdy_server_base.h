@@ -8,10 +8,14 @@
 #ifndef QUICHE_QUIC_TOOLS_QUIC_SPDY_SERVER_BASE_H_
 #define QUICHE_QUIC_TOOLS_QUIC_SPDY_SERVER_BASE_H_
 
+#include "quic/core/quic_time.h"
 #include "quic/platform/api/quic_socket_address.h"
 
 namespace quic {
 
+class QuicFileBackend;
+class QuicWorkerSteering;
+
 // Base class for service instances to be used with QuicToyServer.
 class QuicSpdyServerBase {
  public:
@@ -26,6 +30,34 @@ class QuicSpdyServerBase {
 
   // [SD] Set measure method
   virtual void SetMquicCwnd(int cwnd_size) = 0;
+
+  // [SD] Makes this server worker |worker_id| of a multi-core server, whose
+  // workers share |worker_steering|. Must be called before
+  // CreateUDPSocketAndListen(). Returns false if the server cannot run as a
+  // worker.
+  virtual bool SetWorker(QuicWorkerSteering* /*worker_steering*/,
+                         int /*worker_id*/) {
+    return false;
+  }
+
+  // [SD] Sends with UDP_SEGMENT (GSO) batches if the kernel supports it. Must
+  // be called before CreateUDPSocketAndListen().
+  virtual void SetUseGso(bool /*use_gso*/) {}
+
+  // [SD] Keeps sending on the path a client migrates away from until it
+  // degrades. Must be called before CreateUDPSocketAndListen().
+  virtual void SetEnableMultipath(bool /*enable_multipath*/) {}
+
+  // [SD] Samples the transport metrics of all connections every |interval|
+  // into the TransportMetricsExporter. Must be called before
+  // CreateUDPSocketAndListen().
+  virtual void SetTransportMetricsInterval(QuicTime::Delta /*interval*/) {}
+
+  // [SD] Streams response bodies from the file mappings of |backend|, which
+  // must be the backend the server was created with. Must be called before
+  // CreateUDPSocketAndListen(). Returns false if the server cannot stream
+  // them, in which case responses carry a copy of the body.
+  virtual bool SetFileBackend(QuicFileBackend* /*backend*/) { return false; }
 };
 
 }  // namespace quic
@@ -42,9 +42,11 @@
 
 #include "quic/tools/quic_toy_client.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <random>
 #include <string>
 #include <utility>
 #include <vector>
@@ -62,19 +64,28 @@
 #include <sys/ioctl.h>
 
 #include "absl/strings/escaping.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "quic/core/crypto/quic_client_session_cache.h"
+#include "quic/core/quic_handover_trace.h"
 #include "quic/core/quic_packets.h"
 #include "quic/core/quic_server_id.h"
+#include "quic/core/quic_transport_metrics.h"
 #include "quic/core/quic_utils.h"
 #include "quic/core/quic_versions.h"
 #include "quic/platform/api/quic_default_proof_providers.h"
+#include "quic/platform/api/quic_epoll.h"
+#include "quic/platform/api/quic_file_utils.h"
 #include "quic/platform/api/quic_ip_address.h"
 #include "quic/platform/api/quic_socket_address.h"
 #include "quic/platform/api/quic_system_event_loop.h"
 #include "quic/platform/api/quic_logging.h"
 #include "quic/tools/fake_proof_verifier.h"
+#include "quic/tools/quic_load_generator.h"
+#include "quic/tools/quic_name_lookup.h"
+#include "quic/tools/quic_persistent_session_cache.h"
 #include "quic/tools/quic_url.h"
 #include "common/quiche_text_utils.h"
 
@@ -227,10 +238,18 @@ DEFINE_QUIC_COMMAND_LINE_FLAG(
     "If true, watcher enable to change the address.");
 
 DEFINE_QUIC_COMMAND_LINE_FLAG(
-    bool,
-    enable_tracker,
-    false,
-    "If true, PSN tracker enable to change the address.");
+    std::string,
+    transport_metrics,
+    "",
+    "If set, the congestion window, bytes in flight, RTT, bandwidth "
+    "estimate, pacing rate, loss counters and bytes received of the "
+    "connection are sampled to this file in the binary format read by "
+    "trace_decoder.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(int32_t,
+                              transport_metrics_interval_ms,
+                              10,
+                              "Sampling interval of --transport_metrics.");
 
 DEFINE_QUIC_COMMAND_LINE_FLAG(
     bool,
@@ -243,11 +262,110 @@ DEFINE_QUIC_COMMAND_LINE_FLAG(std::string,
                               "time",
                               "Set handover timing to psn.");
 
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    enable_route_monitor,
+    true,
+    "If true, handover is detected from rtnetlink route changes, and the "
+    "routing table lookup timer is only used as a fallback.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    enable_standby_paths,
+    false,
+    "If true, the other default routes are validated ahead of time so that "
+    "connection migration does not wait for path validation.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    handover_trace,
+    "",
+    "If set, handover and transport events are recorded to this file in the "
+    "binary format read by trace_decoder.");
+
 DEFINE_QUIC_COMMAND_LINE_FLAG(
     bool,
     enable_zerortt,
     false,
-    "If true, handover is processed using zero-rtt.");
+    "If true, sessions are cached so that reconnecting after a handover "
+    "resumes the session and sends requests in 0-RTT.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    session_cache_file,
+    "",
+    "With --enable_zerortt, the file sessions are saved to, so that the next "
+    "run of the client also resumes in 0-RTT.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    race_delay_ms,
+    250,
+    "On reconnect, the delay after which a connection is also attempted on "
+    "the next default route while the server has not answered, in ms. 0 "
+    "disables racing.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    load_connections,
+    0,
+    "If positive, the URL is not fetched. Instead this many concurrent "
+    "connections keep requests in flight to the server for "
+    "--load_duration_s, and throughput, latency, handshake time and "
+    "migration success are reported.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    load_threads,
+    4,
+    "Threads the --load_connections are spread over, each with its own "
+    "event loop.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(int32_t,
+                              load_streams_per_connection,
+                              1,
+                              "Requests each load connection keeps in flight.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(int32_t,
+                              load_duration_s,
+                              10,
+                              "Duration of the load test, in seconds.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    load_ramp_up_ms,
+    1000,
+    "Time over which the load connections are started, in msec.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    load_request_mix,
+    "",
+    "Comma separated \"path:weight\" pairs the load requests are drawn "
+    "from, e.g. \"/index.html:8,/index1200k.html:1\". If empty, the files "
+    "under --load_corpus_dir are requested with equal weights, or the path "
+    "of the URL if that is empty too.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    load_corpus_dir,
+    "",
+    "Directory mirroring the files served, each file is requested by its "
+    "path under the directory.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    load_migration_interval_ms,
+    0,
+    "Mean time between the handovers of each load connection, in msec. 0 "
+    "disables them.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    load_migration_addresses,
+    "",
+    "Comma separated local addresses the load connections are spread over "
+    "and migrate between. If empty, a handover changes the local port.");
 
 DEFINE_QUIC_COMMAND_LINE_FLAG(
     int32_t,
@@ -332,43 +450,64 @@ std::unique_ptr<ClientProofSource> CreateTestClientProofSource(
   return proof_source;
 }
 
-}  // namespace
+// [SD] Returns the |percent| percentile of |samples| in msec, sorting them.
+double Percentile(std::vector<QuicTime::Delta>* samples, int percent) {
+  if (samples->empty()) {
+    return 0;
+  }
+  std::sort(samples->begin(), samples->end());
+  size_t index = (samples->size() - 1) * percent / 100;
+  return (*samples)[index].ToMicroseconds() / 1000.0;
+}
 
-QuicToyClient::QuicToyClient(ClientFactory* client_factory)
-    : client_factory_(client_factory) {}
+// [SD] Parses the "path:weight,..." of --load_request_mix into |mix|.
+bool ParseRequestMix(const std::string& value,
+                     std::vector<std::pair<std::string, int>>* mix) {
+  for (absl::string_view entry : absl::StrSplit(value, ',')) {
+    std::vector<absl::string_view> fields = absl::StrSplit(entry, ':');
+    int weight = 0;
+    if (fields.size() != 2 || fields[0].empty() ||
+        !absl::SimpleAtoi(fields[1], &weight) || weight < 0) {
+      return false;
+    }
+    mix->emplace_back(std::string(fields[0]), weight);
+  }
+  return true;
+}
 
-uint64_t start_, end_;
+// [SD] Keeps the body size of the last stream closed on the client, complete
+// or not, so that a GET resumed on a new connection skips only the bytes its
+// previous attempt received.
+class BodySizeListener : public QuicSpdyClientBase::ResponseListener {
+ public:
+  void OnCompleteResponse(QuicStreamId /*id*/,
+                          const spdy::Http2HeaderBlock& /*response_headers*/,
+                          const std::string& response_body) override {
+    body_size_ = response_body.size();
+  }
 
-void Tracker(std::shared_ptr<QuicClientBase> client, int* thread_kill) {
-  while(!client->session()->connection()->IsHandshakeComplete());
-  //std::cout << "[quic_toy_client] tracker operating..." << std::endl;
+  // Called before each attempt. If its stream is never created, e.g.
+  // because the connection failed first, the size stays 0.
+  void Reset() { body_size_ = 0; }
 
-  std::fstream writer;
-  writer.open("ho_track.txt", std::ios::app);
-  uint64_t prev_psn = 0;
-  uint64_t before_ho_psn = 0;
-  uint64_t start = client->timeStamp();
-  bool ho_check = false;
-  while(*thread_kill == 0) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    if(client->connected() && client->session()->connection()->GetLargestReceivedPacket().IsInitialized()) {
-      if(!ho_check && client->session()->connection()->GetLargestReceivedPacket().ToUint64() < prev_psn) {
-        before_ho_psn = prev_psn;
-        ho_check = true;
-      }
+  size_t body_size() const { return body_size_; }
 
-      writer << client->timeStamp() - start << '\t' << client->session()->connection()->GetLargestReceivedPacket().ToUint64() + before_ho_psn << std::endl;
-      prev_psn = client->session()->connection()->GetLargestReceivedPacket().ToUint64();
-    }
-  }
+ private:
+  size_t body_size_ = 0;
+};
 
-  writer.close();
-  std::cout << "[quic_toy_client] tracker terminates.." << std::endl;
-}
+}  // namespace
+
+QuicToyClient::QuicToyClient(ClientFactory* client_factory)
+    : client_factory_(client_factory) {}
+
+uint64_t start_, end_;
 
 void NetworkChange(std::shared_ptr<QuicClientBase> client, NetworkChangeConfig conf) {
   // [SD] wait for established connection
-  while(!client->session()->connection()->IsHandshakeConfirmed());
+  while(!client->session()->connection()->IsHandshakeConfirmed()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
 
   uint64_t cur_psn;
   for(int i=0; i<conf.ho_num; i++) {
@@ -379,6 +518,7 @@ void NetworkChange(std::shared_ptr<QuicClientBase> client, NetworkChangeConfig c
       }
       // [SD] handover occur based on received packet number
       while(cur_psn < (uint64_t)conf.ho_interval*(i+1)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
         cur_psn = client->session()->connection()->ack_frame().largest_acked.ToUint64() + client->last_psn;
       }
       std::cout << "[quic_toy_client] Start handover after " << cur_psn << " packets from request start" << std::endl;
@@ -396,12 +536,6 @@ void NetworkChange(std::shared_ptr<QuicClientBase> client, NetworkChangeConfig c
       std::cout << "[quic_toy_client] Start handover after " << client->timeStamp() - start_ << " msec from request start" << std::endl;
     }
 
-    if(conf.ho_case == "psn") {
-      client->session()->connection()->SetStartPsn(cur_psn);
-    } else {
-      cur_psn = client->session()->connection()->ack_frame().largest_acked.ToUint64();
-    }
-
     client->nc_start_ = client->timeStamp();
 
     std::string cmd;
@@ -479,6 +613,140 @@ int QuicToyClient::Simulate(std::vector<std::string> urls) {
   return 0;
 }
 
+int QuicToyClient::LoadTest(const QuicUrl& url,
+                            const std::string& host,
+                            uint16_t port,
+                            int address_family_for_lookup,
+                            const ParsedQuicVersionVector& versions,
+                            const QuicConfig& config) {
+  QuicLoadGenerator::Config load;
+  load.server_address = tools::LookupAddress(address_family_for_lookup, host,
+                                             absl::StrCat(port));
+  if (!load.server_address.IsInitialized()) {
+    std::cerr << "Failed to resolve " << host << "." << std::endl;
+    return 1;
+  }
+  load.server_id = QuicServerId(url.host(), port, false);
+  load.authority = url.HostPort();
+  load.versions = versions;
+  load.quic_config = config;
+  load.create_proof_verifier = [&url]() -> std::unique_ptr<ProofVerifier> {
+    if (GetQuicFlag(FLAGS_disable_certificate_verification)) {
+      return std::make_unique<FakeProofVerifier>();
+    }
+    return CreateDefaultProofVerifier(url.host());
+  };
+  load.enable_zerortt = GetQuicFlag(FLAGS_enable_zerortt);
+  load.num_connections = GetQuicFlag(FLAGS_load_connections);
+  load.num_threads = std::max(
+      1, std::min(GetQuicFlag(FLAGS_load_threads), load.num_connections));
+  load.streams_per_connection =
+      std::max(1, GetQuicFlag(FLAGS_load_streams_per_connection));
+  load.duration =
+      QuicTime::Delta::FromSeconds(GetQuicFlag(FLAGS_load_duration_s));
+  load.ramp_up =
+      QuicTime::Delta::FromMilliseconds(GetQuicFlag(FLAGS_load_ramp_up_ms));
+  load.migration_interval = QuicTime::Delta::FromMilliseconds(
+      GetQuicFlag(FLAGS_load_migration_interval_ms));
+  load.seed = std::random_device()();
+
+  const std::string request_mix = GetQuicFlag(FLAGS_load_request_mix);
+  const std::string corpus_dir = GetQuicFlag(FLAGS_load_corpus_dir);
+  if (!request_mix.empty()) {
+    if (!ParseRequestMix(request_mix, &load.request_mix)) {
+      std::cerr << "--load_request_mix must be \"path:weight,...\"."
+                << std::endl;
+      return 1;
+    }
+  } else if (!corpus_dir.empty()) {
+    for (const std::string& file_name : ReadFileContents(corpus_dir)) {
+      std::string path = file_name.substr(corpus_dir.length());
+      if (path.empty() || path[0] != '/') {
+        path.insert(0, "/");
+      }
+      load.request_mix.emplace_back(path, 1);
+    }
+  } else {
+    load.request_mix.emplace_back(url.PathParamsQuery(), 1);
+  }
+  int total_weight = 0;
+  for (const auto& request : load.request_mix) {
+    total_weight += request.second;
+  }
+  if (total_weight <= 0) {
+    std::cerr << "No request to send." << std::endl;
+    return 1;
+  }
+
+  const std::string addresses = GetQuicFlag(FLAGS_load_migration_addresses);
+  if (!addresses.empty()) {
+    for (absl::string_view address : absl::StrSplit(addresses, ',')) {
+      QuicIpAddress ip;
+      if (!ip.FromString(std::string(address))) {
+        std::cerr << "Invalid local address " << address << "." << std::endl;
+        return 1;
+      }
+      load.local_addresses.push_back(ip);
+    }
+  }
+
+  std::cout << "[quic_toy_client] Load test: " << load.num_connections
+            << " connections on " << load.num_threads << " threads, "
+            << load.streams_per_connection << " streams each, "
+            << load.request_mix.size() << " paths, "
+            << load.duration.ToSeconds() << " sec" << std::endl;
+  QuicLoadGenerator::Result result = QuicLoadGenerator::Run(load);
+
+  const double seconds = result.duration.ToMicroseconds() / 1e6;
+  const double throughput_mbps =
+      seconds > 0 ? result.bytes_received * 8 / seconds / 1e6 : 0;
+  const double requests_per_second =
+      seconds > 0 ? result.requests_succeeded / seconds : 0;
+  const double migration_success =
+      result.migrations_attempted > 0
+          ? 100.0 * result.migrations_succeeded / result.migrations_attempted
+          : 0;
+  std::cout << "[quic_toy_client]   requests: " << result.requests_succeeded
+            << " succeeded, " << result.requests_failed << " failed, "
+            << requests_per_second << " req/s, " << throughput_mbps
+            << " Mbit/s" << std::endl;
+  std::cout << "[quic_toy_client]   latency p50/p90/p99: "
+            << Percentile(&result.latencies, 50) << " / "
+            << Percentile(&result.latencies, 90) << " / "
+            << Percentile(&result.latencies, 99) << " msec" << std::endl;
+  std::cout << "[quic_toy_client]   handshake p50/p99: 0-RTT ("
+            << result.zero_rtt_handshake_times.size() << ") "
+            << Percentile(&result.zero_rtt_handshake_times, 50) << " / "
+            << Percentile(&result.zero_rtt_handshake_times, 99)
+            << " msec, 1-RTT (" << result.one_rtt_handshake_times.size()
+            << ") " << Percentile(&result.one_rtt_handshake_times, 50)
+            << " / " << Percentile(&result.one_rtt_handshake_times, 99)
+            << " msec, " << result.connect_failures << " failed, "
+            << result.connections_closed << " closed" << std::endl;
+  std::cout << "[quic_toy_client]   migrations: "
+            << result.migrations_succeeded << " / "
+            << result.migrations_attempted << " succeeded ("
+            << migration_success << "%)" << std::endl;
+
+  std::fstream writer;
+  writer.open("load_test.txt", std::ios::app);
+  writer << load.num_connections << '\t' << load.num_threads << '\t'
+         << load.streams_per_connection << '\t'
+         << load.migration_interval.ToMilliseconds() << '\t'
+         << result.requests_succeeded << '\t' << result.requests_failed
+         << '\t' << throughput_mbps << '\t'
+         << Percentile(&result.latencies, 50) << '\t'
+         << Percentile(&result.latencies, 90) << '\t'
+         << Percentile(&result.latencies, 99) << '\t'
+         << Percentile(&result.zero_rtt_handshake_times, 50) << '\t'
+         << Percentile(&result.one_rtt_handshake_times, 50) << '\t'
+         << result.connect_failures << '\t' << result.connections_closed
+         << '\t' << result.migrations_attempted << '\t'
+         << result.migrations_succeeded << std::endl;
+  writer.close();
+  return 0;
+}
+
 int QuicToyClient::SendRequestsAndPrintResponses(
     std::vector<std::string> urls) {
   QuicUrl url(urls[0], "https");
@@ -534,14 +802,20 @@ int QuicToyClient::SendRequestsAndPrintResponses(
 
   // [SD] zeroRTT 쓰도록 유도
   std::unique_ptr<quic::SessionCache> session_cache;
-  // if (num_requests > 1 && GetQuicFlag(FLAGS_one_connection_per_request)) {
-  //   session_cache = std::make_unique<QuicClientSessionCache>();
-  // }
-  
-  // zeroRTT도 옵션으로 할 수 있도록 설정
-  // if(GetQuicFlag(FLAGS_enable_zerortt)) {
-  //   session_cache = std::make_unique<QuicClientSessionCache>();
-  // }
+  if (GetQuicFlag(FLAGS_enable_zerortt)) {
+    // Transport parameters are saved in the encoding of the first TLS
+    // version, the only ones that resume with them.
+    auto tls_version =
+        std::find_if(versions.begin(), versions.end(),
+                     [](const ParsedQuicVersion& v) { return v.UsesTls(); });
+    if (!GetQuicFlag(FLAGS_session_cache_file).empty() &&
+        tls_version != versions.end()) {
+      session_cache = std::make_unique<QuicPersistentSessionCache>(
+          GetQuicFlag(FLAGS_session_cache_file), *tls_version);
+    } else {
+      session_cache = std::make_unique<QuicClientSessionCache>();
+    }
+  }
 
   QuicConfig config;
   std::string connection_options_string = GetQuicFlag(FLAGS_connection_options);
@@ -574,6 +848,12 @@ int QuicToyClient::SendRequestsAndPrintResponses(
     address_family_for_lookup = AF_INET6;
   }
 
+  // [SD] load mode, the clients are built by the load generator
+  if (GetQuicFlag(FLAGS_load_connections) > 0) {
+    return LoadTest(url, host, port, address_family_for_lookup, versions,
+                    config);
+  }
+
   // Build the client, and try to connect.
   // [SD] QuicSpdyClientBase로 만들었기때문에 quic_client_base를 상속한 quic_spdy_client_base가 만들어짐
 
@@ -590,6 +870,8 @@ int QuicToyClient::SendRequestsAndPrintResponses(
   }
 
   client->set_local_port(GetQuicFlag(FLAGS_local_port));
+  client->set_race_delay(QuicTime::Delta::FromMilliseconds(
+      GetQuicFlag(FLAGS_race_delay_ms)));
 
   if (!GetQuicFlag(FLAGS_default_client_cert).empty() &&
       !GetQuicFlag(FLAGS_default_client_cert_key).empty()) {
@@ -622,6 +904,27 @@ int QuicToyClient::SendRequestsAndPrintResponses(
   if (max_inbound_header_list_size > 0) {
     client->set_max_inbound_header_list_size(max_inbound_header_list_size);
   }
+  client->set_enable_route_monitor(GetQuicFlag(FLAGS_enable_route_monitor));
+  client->set_enable_standby_paths(GetQuicFlag(FLAGS_enable_standby_paths));
+  const std::string handover_trace = GetQuicFlag(FLAGS_handover_trace);
+  if (!handover_trace.empty() &&
+      !HandoverTracer::Get()->Start(handover_trace)) {
+    std::cerr << "Failed to open handover trace " << handover_trace
+              << std::endl;
+  }
+  // [SD] Sampled on the event loop of the client, which replaces the PSN
+  // tracker thread.
+  const std::string transport_metrics = GetQuicFlag(FLAGS_transport_metrics);
+  if (!transport_metrics.empty() &&
+      GetQuicFlag(FLAGS_transport_metrics_interval_ms) > 0) {
+    if (TransportMetricsExporter::Get()->Start(transport_metrics)) {
+      client->StartTransportMetrics(QuicTime::Delta::FromMilliseconds(
+          GetQuicFlag(FLAGS_transport_metrics_interval_ms)));
+    } else {
+      std::cerr << "Failed to open transport metrics " << transport_metrics
+                << std::endl;
+    }
+  }
   if (!client->Initialize()) {
     std::cerr << "Failed to initialize client." << std::endl;
     return 1;
@@ -698,13 +1001,6 @@ int QuicToyClient::SendRequestsAndPrintResponses(
   }
 
   start_ = client->timeStamp();
-  client->session()->connection()->SetStartTimeFramer(start_);
-
-  if(GetQuicFlag(FLAGS_enable_tracker)) {
-    tracker_thread_kill_ = 0;
-    std::thread trackerThread(Tracker, client, &tracker_thread_kill_);
-    trackerThread.detach();
-  }
 
   ho_start = ho_delay = total_success = 0;
   bool enable_cm = GetQuicFlag(FLAGS_enable_cm);
@@ -715,19 +1011,50 @@ int QuicToyClient::SendRequestsAndPrintResponses(
   uint64_t sum_req_delay = 0;
   uint64_t per_req_delay = 0;
   int32_t num_requests(GetQuicFlag(FLAGS_num_requests));
+  // Bytes of the current GET received before its connection was replaced,
+  // asked for again as a range.
+  size_t resume_offset = 0;
+  // Owned by the client, which may still close streams when it goes away.
+  auto body_size_listener = std::make_unique<BodySizeListener>();
+  BodySizeListener* attempt_body = body_size_listener.get();
+  client->set_response_listener(std::move(body_size_listener));
   for (int i = 0; i < num_requests; ++i) {
+    attempt_body->Reset();
+    spdy::Http2HeaderBlock request_headers = header_block.Clone();
+    if (resume_offset > 0) {
+      request_headers["range"] = absl::StrCat("bytes=", resume_offset, "-");
+    }
     writer << client->timeStamp() - start_ - per_req_delay << std::endl;
     sum_req_delay += client->timeStamp() - start_ - per_req_delay;
     std::cout << "[quic_toy_client] Start the request (" << i << ") .. - " << client->timeStamp() - start_ << " msec" << std::endl;
     per_req_delay = client->timeStamp() - start_;
-    client->SendRequestAndWaitForResponse(header_block, body, /*fin=*/true);
+    client->session()->connection()->TraceHandoverEvent(
+        HandoverTraceEvent::kRequestStart, 0, i);
+    const int num_sessions_replaced = client->num_sessions_replaced();
+    client->SendRequestAndWaitForResponse(request_headers, body,
+                                          /*fin=*/true);
+    if (client->session() != nullptr) {
+      client->session()->connection()->TraceHandoverEvent(
+          HandoverTraceEvent::kRequestEnd, 0, i);
+    }
+    if (client->num_sessions_replaced() != num_sessions_replaced) {
+      // A raced connection took over and the request went down with the
+      // previous one.
+      std::cout << "[quic_toy_client] Connection replaced, send the request "
+                   "again" << std::endl;
+      if (body.empty()) {
+        resume_offset += attempt_body->body_size();
+      }
+      num_requests++;
+      continue;
+    }
 
     //std::this_thread::sleep_for(std::chrono::milliseconds(20000));
 
     // Print request and response details.
     if (!GetQuicFlag(FLAGS_quiet)) {
       std::cout << "Request:" << std::endl;
-      std::cout << "headers:" << header_block.DebugString();
+      std::cout << "headers:" << request_headers.DebugString();
       if (!GetQuicFlag(FLAGS_body_hex).empty()) {
         // Print the user provided hex, rather than binary body.
         std::cout << "body:\n"
@@ -778,15 +1105,10 @@ int QuicToyClient::SendRequestsAndPrintResponses(
       //std::cout << "[quic_toy_client] ho_start time: " << ho_start << std::endl;
       if(client->session()->error() == 27 || client->session()->error() == 16 || client->session()->error() == 85) {
         std::cout << "[quic_toy_client] Network is unreachable or RTOS, so connect again" << std::endl;
-        client->Disconnect();
-
-        if (!client->Initialize()) {
-          std::cerr << "Failed to reinitialize client between requests."
-                    << std::endl;
-          return 1;
+        if (body.empty()) {
+          resume_offset += attempt_body->body_size();
         }
-
-        if (!client->Connect()) {
+        if (!client->Reconnect()) {
           std::cerr << "Failed to reconnect client between requests."
                               << std::endl;
           return 1;
@@ -816,6 +1138,7 @@ int QuicToyClient::SendRequestsAndPrintResponses(
       std::cout << "Request failed (" << response_code << ")." << std::endl;
       return 1;
     }
+    resume_offset = 0;
 
     // if(!enable_cm && i+1 != num_requests) {
     //   std::cout << "[quic_toy_client] Disconnecting client between requests." << std::endl;
@@ -889,9 +1212,9 @@ int QuicToyClient::SendRequestsAndPrintResponses(
 
   total_received_packets += preLa;
   std::cout << "[quic_toy_client] Total Delay : " << end_ - start_ <<  " msec / HO Delay : " << ho_delay << 
-    " msec / Total Sent ACK: " << client->session()->connection()->sent_ack_num << 
+    " msec / Total Sent ACK: " << client->session()->connection()->GetSentAckCount() << 
     " / Total Received Packets: " << total_received_packets << 
-    " / Num of Lookup : " << client->session()->connection()->counting_rt << std::endl;
+    " / Num of Lookup : " << client->session()->connection()->GetLookupCount() << std::endl;
   writer.open("measure_delay.txt", std::ios::app);
   //writer << ho_delay << '\t'<< '\t' << end_ - start_ << std::endl;
   writer << end_ - start_ << '\t' << total_received_packets << std::endl;
@@ -899,12 +1222,12 @@ int QuicToyClient::SendRequestsAndPrintResponses(
   writer.close();
 
   writer.open("sent_ack_num.txt", std::ios::app);
-  writer << client->session()->connection()->sent_ack_num << std::endl;
+  writer << client->session()->connection()->GetSentAckCount() << std::endl;
   writer.close();
 
 
   writer.open("ho_count.txt", std::ios::app);
-  writer << ho_delay << '\t' << client->session()->connection()->counting_rt << std::endl;
+  writer << ho_delay << '\t' << client->session()->connection()->GetLookupCount() << std::endl;
   client->ho_count = 0;
   writer.close();
 
@@ -933,14 +1256,12 @@ int QuicToyClient::SendRequestsAndPrintResponses(
   // QUIC_LOG_FIRST_N(WARNING, 1) << "Test man";
   // QUIC_DLOG(INFO) << "Hey";
 
-  if(GetQuicFlag(FLAGS_enable_tracker)) {
-    tracker_thread_kill_ = 1;
-  }
-
   client->Disconnect();
   if(ho_num > 0) {
     networkChangeThread.join();
   }
+  HandoverTracer::Get()->Stop();
+  TransportMetricsExporter::Get()->Stop();
   return 0;
 }
 
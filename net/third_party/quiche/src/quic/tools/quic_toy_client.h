@@ -9,6 +9,7 @@
 #define QUICHE_QUIC_TOOLS_QUIC_TOY_CLIENT_H_
 
 #include "quic/tools/quic_spdy_client_base.h"
+#include "quic/tools/quic_url.h"
 
 namespace quic {
 
@@ -43,9 +44,18 @@ class QuicToyClient {
   int SendRequestsAndPrintResponses(std::vector<std::string> urls);
   int Simulate(std::vector<std::string> urls);
 
+  // [SD] Runs the load of --load_connections against |host|:|port| and
+  // reports throughput, request latency, handshake time and migration
+  // success.
+  int LoadTest(const QuicUrl& url,
+               const std::string& host,
+               uint16_t port,
+               int address_family_for_lookup,
+               const ParsedQuicVersionVector& versions,
+               const QuicConfig& config);
+
  private:
   ClientFactory* client_factory_;  // Unowned.
-  int tracker_thread_kill_;
   uint64_t preLa = 0;
   //int64_t preBW, curBW;
 };
@@ -4,13 +4,35 @@
 
 #include "quic/tools/quic_toy_server.h"
 
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "quic/core/quic_connection.h"
+#include "quic/core/quic_default_packet_writer.h"
+#include "quic/core/quic_epoll_alarm_factory.h"
+#include "quic/core/quic_epoll_connection_helper.h"
+#include "quic/core/quic_handover_controller.h"
+#include "quic/core/quic_handover_trace.h"
+#include "quic/core/quic_transport_metrics.h"
 #include "quic/core/quic_versions.h"
+#include "quic/core/quic_worker_steering.h"
 #include "quic/platform/api/quic_default_proof_providers.h"
+#include "quic/platform/api/quic_epoll.h"
 #include "quic/platform/api/quic_flags.h"
+#include "quic/platform/api/quic_logging.h"
 #include "quic/platform/api/quic_socket_address.h"
+#include "quic/tools/quic_file_backend.h"
 #include "quic/tools/quic_memory_cache_backend.h"
 
 DEFINE_QUIC_COMMAND_LINE_FLAG(int32_t,
@@ -53,6 +75,71 @@ DEFINE_QUIC_COMMAND_LINE_FLAG(
     "QUIC versions to enable, e.g. \"h3-25,h3-27\". If not set, then all "
     "available versions are enabled.");
 
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    handover_trace,
+    "",
+    "If set, handover and transport events are recorded to this file in the "
+    "binary format read by trace_decoder.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    transport_metrics,
+    "",
+    "If set, the congestion window, bytes in flight, RTT, bandwidth "
+    "estimate, pacing rate and loss counters of every connection, and their "
+    "aggregate per worker, are sampled to this file in the binary format "
+    "read by trace_decoder.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(int32_t,
+                              transport_metrics_interval_ms,
+                              100,
+                              "Sampling interval of --transport_metrics.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    num_workers,
+    1,
+    "Number of worker threads, each with its own socket on --port and "
+    "dispatcher. Packets that reach the wrong worker after a client "
+    "migrated are forwarded to the worker that owns the connection.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(bool,
+                              pin_workers,
+                              true,
+                              "If true, worker N runs on core N.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    udp_gso,
+    true,
+    "If true, packets are sent in UDP GSO batches when the kernel supports "
+    "UDP_SEGMENT, otherwise one sendmsg() is used per packet.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    enable_multipath,
+    false,
+    "If true, after a client migrates the server keeps sending on the old "
+    "path, with its own congestion controller, until that path degrades.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    mmap_response_cache,
+    true,
+    "If true, the files of --quic_response_cache_dir are memory mapped and "
+    "their bodies streamed from the mapping instead of being read into "
+    "memory at startup. Files that change on disk are reloaded.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    benchmark_connection_memory,
+    "",
+    "If set to connection counts, e.g. \"10000,100000\", no server is "
+    "started. Instead that many server connections are created per count, "
+    "the way the dispatcher creates them, and the heap bytes per connection "
+    "are reported.");
+
 DEFINE_QUIC_COMMAND_LINE_FLAG(bool,
                               enable_webtransport,
                               false,
@@ -60,8 +147,111 @@ DEFINE_QUIC_COMMAND_LINE_FLAG(bool,
 
 namespace quic {
 
+namespace {
+
+// [SD] Pins the calling thread to |core|, modulo the number of cores.
+void PinToCore(int core) {
+  const unsigned int num_cores = std::thread::hardware_concurrency();
+  if (num_cores == 0) {
+    return;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(core % num_cores, &cpu_set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) !=
+      0) {
+    QUIC_LOG(WARNING) << "Failed to pin worker to core " << core;
+  }
+}
+
+// [SD] Heap bytes in use, including chunks that malloc mapped on their own.
+size_t HeapBytesInUse() {
+#if defined(__GLIBC__) && __GLIBC__ == 2 && __GLIBC_MINOR__ >= 33
+  const struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#else
+  const struct mallinfo info = mallinfo();
+  return static_cast<size_t>(static_cast<unsigned int>(info.uordblks)) +
+         static_cast<size_t>(static_cast<unsigned int>(info.hblkhd));
+#endif
+}
+
+// [SD] Creates |count| server connections with the helper, alarm factory and
+// shared writer that the dispatcher gives them, and returns the heap bytes
+// each one takes.
+double MeasureConnectionMemory(int count, const ParsedQuicVersion& version) {
+  QuicEpollServer epoll_server;
+  QuicEpollConnectionHelper helper(&epoll_server, QuicAllocator::BUFFER_POOL);
+  QuicEpollAlarmFactory alarm_factory(&epoll_server);
+  QuicDefaultPacketWriter writer(-1);
+  const QuicSocketAddress self_address(QuicIpAddress::Loopback6(), 443);
+  std::vector<std::unique_ptr<QuicConnection>> connections;
+  connections.reserve(count);
+
+  const size_t heap_before = HeapBytesInUse();
+  for (int i = 0; i < count; ++i) {
+    const uint64_t id = i + 1;
+    const QuicConnectionId connection_id(reinterpret_cast<const char*>(&id),
+                                         sizeof(id));
+    const QuicSocketAddress peer_address(
+        QuicIpAddress::Loopback6(), static_cast<uint16_t>(1024 + i % 60000));
+    connections.push_back(std::make_unique<QuicConnection>(
+        connection_id, self_address, peer_address, &helper, &alarm_factory,
+        &writer, /* owns_writer= */ false, Perspective::IS_SERVER,
+        ParsedQuicVersionVector{version}));
+  }
+  const size_t heap_after = HeapBytesInUse();
+  return static_cast<double>(heap_after - heap_before) / count;
+}
+
+// [SD] Runs MeasureConnectionMemory() for each count of
+// --benchmark_connection_memory.
+int BenchmarkConnectionMemory(const ParsedQuicVersion& version) {
+  std::vector<int> counts;
+  for (absl::string_view count_string : absl::StrSplit(
+           GetQuicFlag(FLAGS_benchmark_connection_memory), ',')) {
+    int count;
+    if (!absl::SimpleAtoi(count_string, &count) || count <= 0) {
+      std::cerr << "Invalid connection count: " << count_string << std::endl;
+      return 1;
+    }
+    counts.push_back(count);
+  }
+
+  std::cout << "[quic_toy_server] sizeof(QuicConnection): "
+            << sizeof(QuicConnection)
+            << " bytes, clients with connection migration add a "
+            << sizeof(HandoverController)
+            << " byte HandoverController and its three alarms" << std::endl;
+  std::fstream writer;
+  writer.open("benchmark_connection_memory.txt", std::ios::app);
+  for (int count : counts) {
+    const double bytes = MeasureConnectionMemory(count, version);
+    std::cout << "[quic_toy_server] " << count << " connections: " << bytes
+              << " bytes/connection" << std::endl;
+    writer << count << '\t' << sizeof(QuicConnection) << '\t' << bytes
+           << std::endl;
+  }
+  writer.close();
+  return 0;
+}
+
+}  // namespace
+
 std::unique_ptr<quic::QuicSimpleServerBackend>
 QuicToyServer::MemoryCacheBackendFactory::CreateBackend() {
+  // [SD] Dynamic responses and WebTransport need the memory cache.
+  if (GetQuicFlag(FLAGS_mmap_response_cache) &&
+      !GetQuicFlag(FLAGS_quic_response_cache_dir).empty() &&
+      !GetQuicFlag(FLAGS_generate_dynamic_responses) &&
+      !GetQuicFlag(FLAGS_enable_webtransport)) {
+    auto file_backend = std::make_unique<QuicFileBackend>();
+    file_backend->InitializeBackend(
+        GetQuicFlag(FLAGS_quic_response_cache_dir));
+    file_backend_ = file_backend.get();
+    return file_backend;
+  }
+  file_backend_ = nullptr;
   auto memory_cache_backend = std::make_unique<QuicMemoryCacheBackend>();
   if (GetQuicFlag(FLAGS_generate_dynamic_responses)) {
     memory_cache_backend->GenerateDynamicResponses();
@@ -104,17 +294,81 @@ int QuicToyServer::Start() {
   for (const auto& version : supported_versions) {
     QuicEnableVersion(version);
   }
-  auto proof_source = quic::CreateDefaultProofSource();
+  if (!GetQuicFlag(FLAGS_benchmark_connection_memory).empty()) {
+    return BenchmarkConnectionMemory(supported_versions.front());
+  }
   auto backend = backend_factory_->CreateBackend();
-  auto server = server_factory_->CreateServer(
-      backend.get(), std::move(proof_source), supported_versions);
 
-  if (!server->CreateUDPSocketAndListen(quic::QuicSocketAddress(
-          quic::QuicIpAddress::Any6(), GetQuicFlag(FLAGS_port)))) {
+  // [SD] One server per worker, all listening on the same port.
+  const int num_workers = GetQuicFlag(FLAGS_num_workers);
+  if (num_workers < 1 || num_workers > QuicWorkerSteering::kMaxWorkers) {
+    QUIC_LOG(ERROR) << "--num_workers must be between 1 and "
+                    << QuicWorkerSteering::kMaxWorkers;
     return 1;
   }
-  
-  server->HandleEventsForever();
+  std::unique_ptr<QuicWorkerSteering> worker_steering;
+  if (num_workers > 1) {
+    worker_steering = std::make_unique<QuicWorkerSteering>(num_workers);
+  }
+  const std::string transport_metrics = GetQuicFlag(FLAGS_transport_metrics);
+  if (!transport_metrics.empty() &&
+      (GetQuicFlag(FLAGS_transport_metrics_interval_ms) <= 0 ||
+       !TransportMetricsExporter::Get()->Start(transport_metrics))) {
+    QUIC_LOG(ERROR) << "Failed to start transport metrics to "
+                    << transport_metrics;
+    return 1;
+  }
+  std::vector<std::unique_ptr<QuicSpdyServerBase>> servers;
+  for (int i = 0; i < num_workers; ++i) {
+    auto server = server_factory_->CreateServer(
+        backend.get(), quic::CreateDefaultProofSource(), supported_versions);
+    if (worker_steering != nullptr &&
+        !server->SetWorker(worker_steering.get(), i)) {
+      QUIC_LOG(ERROR) << "This server does not support --num_workers";
+      return 1;
+    }
+    server->SetUseGso(GetQuicFlag(FLAGS_udp_gso));
+    server->SetEnableMultipath(GetQuicFlag(FLAGS_enable_multipath));
+    if (!transport_metrics.empty()) {
+      server->SetTransportMetricsInterval(QuicTime::Delta::FromMilliseconds(
+          GetQuicFlag(FLAGS_transport_metrics_interval_ms)));
+    }
+    if (backend_factory_->file_backend() != nullptr) {
+      server->SetFileBackend(backend_factory_->file_backend());
+    }
+    if (!server->CreateUDPSocketAndListen(quic::QuicSocketAddress(
+            quic::QuicIpAddress::Any6(), GetQuicFlag(FLAGS_port)))) {
+      return 1;
+    }
+    if (GetQuicFlag(FLAGS_mquic_cwnd) > 0) {
+      server->SetMquicCwnd(GetQuicFlag(FLAGS_mquic_cwnd));
+    }
+    servers.push_back(std::move(server));
+  }
+
+  const std::string handover_trace = GetQuicFlag(FLAGS_handover_trace);
+  if (!handover_trace.empty() &&
+      !HandoverTracer::Get()->Start(handover_trace)) {
+    return 1;
+  }
+  const bool pin_workers = GetQuicFlag(FLAGS_pin_workers) && num_workers > 1;
+  std::vector<std::thread> workers;
+  for (int i = 1; i < num_workers; ++i) {
+    QuicSpdyServerBase* server = servers[i].get();
+    workers.emplace_back([server, i, pin_workers] {
+      if (pin_workers) {
+        PinToCore(i);
+      }
+      server->HandleEventsForever();
+    });
+  }
+  if (pin_workers) {
+    PinToCore(0);
+  }
+  servers[0]->HandleEventsForever();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
   return 0;
 }
 
@@ -35,13 +35,22 @@ class QuicToyServer {
 
     // Creates a new backend.
     virtual std::unique_ptr<QuicSimpleServerBackend> CreateBackend() = 0;
+
+    // [SD] Returns the backend last created if it is a QuicFileBackend, so
+    // that servers can stream bodies from its file mappings, or nullptr.
+    virtual QuicFileBackend* file_backend() { return nullptr; }
   };
 
   // A factory for creating QuicMemoryCacheBackend instances, configured
-  // to load files from disk, if necessary.
+  // to load files from disk, if necessary. [SD] With --mmap_response_cache,
+  // files are served by a QuicFileBackend instead.
   class MemoryCacheBackendFactory : public BackendFactory {
    public:
     std::unique_ptr<quic::QuicSimpleServerBackend> CreateBackend() override;
+    QuicFileBackend* file_backend() override { return file_backend_; }
+
+   private:
+    QuicFileBackend* file_backend_ = nullptr;  // Not owned.
   };
 
   // Constructs a new toy server that will use |server_factory| to create the
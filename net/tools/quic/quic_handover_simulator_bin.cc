@@ -0,0 +1,336 @@
+// Copyright (c) 2023 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// [SD] Handover experiments that need no server and no second NIC. They are
+// kept out of quic_client because the simulator is built on quiche's
+// test_tools, which only testonly targets may link.
+//
+// Simulated handovers, with connection migration and with a new connection:
+//   quic_handover_simulator --simulate_handover_runs=1000
+//
+// Receive path cost of the handover detection timer:
+//   quic_handover_simulator --benchmark_hdt_packets=1000000
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "net/third_party/quiche/src/quic/core/quic_alarm.h"
+#include "net/third_party/quiche/src/quic/core/quic_epoll_alarm_factory.h"
+#include "net/third_party/quiche/src/quic/core/quic_handover_detector.h"
+#include "net/third_party/quiche/src/quic/core/quic_time.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_command_line_flags.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_epoll.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_system_event_loop.h"
+#include "net/third_party/quiche/src/quic/tools/quic_handover_simulator.h"
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    simulate_handover_runs,
+    0,
+    "If positive, this many handovers are run per mode against an "
+    "in-process server on a simulated network, with connection migration "
+    "and with a new connection, and the delay percentiles are reported.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    simulate_ho_time_ms,
+    "50-500",
+    "Range the link loss is drawn from, in msec after the request start.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    simulate_l2l3_delay_ms,
+    "0-200",
+    "Range the delay from link loss to default route removal is drawn "
+    "from, in msec.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    simulate_rtt_ms,
+    "40",
+    "Range the RTT of both simulated networks is drawn from, in msec.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    std::string,
+    simulate_file_size,
+    "1000000",
+    "Range the size of the downloaded file is drawn from, in bytes.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    simulate_rlt_interval_ms,
+    10,
+    "Routing table lookup interval of the simulated client, in msec.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    simulate_seed,
+    1,
+    "Seed of the first simulated run, the following runs use the next "
+    "seeds. The same seed gives the same run.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    bool,
+    enable_route_monitor,
+    true,
+    "If true, the simulated client learns route changes as they happen, "
+    "and the routing table lookup timer is only used as a fallback.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    benchmark_hdt_packets,
+    0,
+    "If positive, the receive path cost of the handover detection timer is "
+    "measured over this many packets, moving an epoll alarm per packet and "
+    "recording the packet time only, and the nsec per packet of both are "
+    "reported.");
+
+DEFINE_QUIC_COMMAND_LINE_FLAG(
+    int32_t,
+    benchmark_hdt_gap_us,
+    10,
+    "Packet inter-arrival time of --benchmark_hdt_packets, in usec.");
+
+namespace {
+
+using quic::QuicAlarm;
+using quic::QuicTime;
+
+// Parses "min-max" or a single value into |range|.
+bool ParseSimulationRange(const std::string& value,
+                          std::pair<int64_t, int64_t>* range) {
+  std::vector<std::string> bounds = absl::StrSplit(value, '-');
+  if (bounds.empty() || bounds.size() > 2 ||
+      !absl::SimpleAtoi(bounds.front(), &range->first) ||
+      !absl::SimpleAtoi(bounds.back(), &range->second)) {
+    return false;
+  }
+  return range->first <= range->second;
+}
+
+// Draws uniformly from |range| with the seed of the current run.
+int64_t DrawFromRange(const std::pair<int64_t, int64_t>& range,
+                      std::mt19937_64* generator) {
+  return std::uniform_int_distribution<int64_t>(range.first,
+                                                range.second)(*generator);
+}
+
+// Returns the |percent| percentile of |samples| in msec, sorting them.
+double Percentile(std::vector<QuicTime::Delta>* samples, int percent) {
+  if (samples->empty()) {
+    return 0;
+  }
+  std::sort(samples->begin(), samples->end());
+  size_t index = (samples->size() - 1) * percent / 100;
+  return (*samples)[index].ToMicroseconds() / 1000.0;
+}
+
+// The HDT benchmark never runs the event loop, so its alarms never fire.
+class NoopAlarmDelegate : public QuicAlarm::Delegate {
+ public:
+  quic::QuicConnectionContext* GetConnectionContext() override {
+    return nullptr;
+  }
+  void OnAlarm() override {}
+};
+
+// Feeds |num_packets| packet times, |gap| apart, to |on_packet| and returns
+// the nsec per packet it took.
+template <typename OnPacket>
+double TimePerPacket(int num_packets, QuicTime::Delta gap, OnPacket on_packet) {
+  QuicTime now = QuicTime::Zero() + QuicTime::Delta::FromSeconds(1);
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_packets; ++i) {
+    on_packet(now);
+    now = now + gap;
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         num_packets;
+}
+
+// Runs the handovers of --simulate_handover_runs on a simulated network, with
+// connection migration and with a new connection, and reports the handover
+// delay, total time and stall percentiles.
+int SimulateHandovers() {
+  std::pair<int64_t, int64_t> ho_time, l2l3_delay, rtt, file_size;
+  if (!ParseSimulationRange(GetQuicFlag(FLAGS_simulate_ho_time_ms),
+                            &ho_time) ||
+      !ParseSimulationRange(GetQuicFlag(FLAGS_simulate_l2l3_delay_ms),
+                            &l2l3_delay) ||
+      !ParseSimulationRange(GetQuicFlag(FLAGS_simulate_rtt_ms), &rtt) ||
+      !ParseSimulationRange(GetQuicFlag(FLAGS_simulate_file_size),
+                            &file_size)) {
+    std::cerr << "Simulation ranges must be \"min-max\" or a single value."
+              << std::endl;
+    return 1;
+  }
+  const int32_t num_runs = GetQuicFlag(FLAGS_simulate_handover_runs);
+  const int32_t seed = GetQuicFlag(FLAGS_simulate_seed);
+
+  std::fstream run_writer, summary_writer;
+  run_writer.open("simulate_handover_runs.txt", std::ios::app);
+  summary_writer.open("simulate_handover.txt", std::ios::app);
+  for (bool use_migration : {true, false}) {
+    const char* mode = use_migration ? "CM" : "NC";
+    std::vector<QuicTime::Delta> ho_delays, total_times, stalls;
+    int failures = 0;
+    for (int i = 0; i < num_runs; ++i) {
+      // Both modes draw the same scenarios from the same seeds.
+      std::mt19937_64 generator(seed + i);
+      quic::QuicHandoverSimulation::Config config;
+      config.use_migration = use_migration;
+      config.monitor_routes = GetQuicFlag(FLAGS_enable_route_monitor);
+      config.seed = seed + i;
+      config.handover_time =
+          QuicTime::Delta::FromMilliseconds(DrawFromRange(ho_time, &generator));
+      config.l2l3_delay = QuicTime::Delta::FromMilliseconds(
+          DrawFromRange(l2l3_delay, &generator));
+      config.rtt =
+          QuicTime::Delta::FromMilliseconds(DrawFromRange(rtt, &generator));
+      config.file_size = DrawFromRange(file_size, &generator);
+      config.rlt_interval = QuicTime::Delta::FromMilliseconds(
+          GetQuicFlag(FLAGS_simulate_rlt_interval_ms));
+
+      quic::QuicHandoverSimulation::Result result =
+          quic::QuicHandoverSimulation::Run(config);
+      run_writer << mode << '\t' << config.seed << '\t'
+                 << config.handover_time.ToMilliseconds() << '\t'
+                 << config.l2l3_delay.ToMilliseconds() << '\t'
+                 << config.rtt.ToMilliseconds() << '\t' << config.file_size
+                 << '\t' << result.success << '\t'
+                 << result.handover_delay.ToMilliseconds() << '\t'
+                 << result.total_time.ToMilliseconds() << '\t'
+                 << result.max_stall.ToMilliseconds() << std::endl;
+      if (!result.success) {
+        failures++;
+        continue;
+      }
+      // Downloads that finished before the link went down say nothing about
+      // the handover, but still count towards the total time.
+      if (result.handover_during_request) {
+        ho_delays.push_back(result.handover_delay);
+        stalls.push_back(result.max_stall);
+      }
+      total_times.push_back(result.total_time);
+    }
+
+    std::cout << "[quic_handover_simulator] " << mode << ": " << num_runs
+              << " runs, " << failures << " failed, " << ho_delays.size()
+              << " with handover" << std::endl;
+    summary_writer << mode << '\t' << num_runs << '\t' << failures;
+    const std::pair<const char*, std::vector<QuicTime::Delta>*> reports[] = {
+        {"ho_delay", &ho_delays}, {"total", &total_times}, {"stall", &stalls}};
+    for (const auto& report : reports) {
+      const char* name = report.first;
+      std::vector<QuicTime::Delta>* samples = report.second;
+      std::cout << "[quic_handover_simulator]   " << name
+                << " p50/p90/p99: " << Percentile(samples, 50) << " / "
+                << Percentile(samples, 90) << " / " << Percentile(samples, 99)
+                << " msec" << std::endl;
+      summary_writer << '\t' << Percentile(samples, 50) << '\t'
+                     << Percentile(samples, 90) << '\t'
+                     << Percentile(samples, 99);
+    }
+    summary_writer << std::endl;
+  }
+  run_writer.close();
+  summary_writer.close();
+  return 0;
+}
+
+// Measures the receive path cost of the handover detection timer for
+// --benchmark_hdt_packets, with a per-packet alarm update and with the lazy
+// re-arm of QuicConnection.
+int BenchmarkHandoverDetection() {
+  const int32_t num_packets = GetQuicFlag(FLAGS_benchmark_hdt_packets);
+  const QuicTime::Delta gap = QuicTime::Delta::FromMicroseconds(
+      GetQuicFlag(FLAGS_benchmark_hdt_gap_us));
+  // Timers of a connection on a 40 msec path.
+  const QuicTime::Delta pto_delay = QuicTime::Delta::FromMilliseconds(100);
+  const QuicTime::Delta granularity = QuicTime::Delta::FromMilliseconds(1);
+  // The other alarms of the connection share the epoll alarm map.
+  const int kOtherAlarms = 16;
+
+  quic::QuicEpollServer epoll_server;
+  quic::QuicEpollAlarmFactory alarm_factory(&epoll_server);
+  std::vector<std::unique_ptr<QuicAlarm>> other_alarms;
+  for (int i = 0; i < kOtherAlarms; ++i) {
+    other_alarms.emplace_back(
+        alarm_factory.CreateAlarm(new NoopAlarmDelegate()));
+    other_alarms.back()->Set(QuicTime::Zero() +
+                             QuicTime::Delta::FromSeconds(2 + i));
+  }
+  std::unique_ptr<QuicAlarm> hdt_alarm(
+      alarm_factory.CreateAlarm(new NoopAlarmDelegate()));
+
+  // Before: the alarm is moved to 3 * PTO after every packet.
+  const double update_ns =
+      TimePerPacket(num_packets, gap, [&](QuicTime now) {
+        hdt_alarm->Update(now + pto_delay * 3, granularity);
+      });
+  hdt_alarm->Cancel();
+
+  // After: the packet time is recorded and the alarm is only moved when it
+  // would have fired, as HandoverDetectionAlarmDelegate does.
+  quic::QuicHandoverDetector detector;
+  const double lazy_ns =
+      TimePerPacket(num_packets, gap, [&](QuicTime now) {
+        detector.OnPacketReceived(now);
+        if (!hdt_alarm->IsSet()) {
+          hdt_alarm->Set(now + detector.GetDetectionDelay(pto_delay, true));
+        } else if (hdt_alarm->deadline() <= now) {
+          hdt_alarm->Cancel();
+          hdt_alarm->Set(detector.last_activity_time() +
+                         detector.GetDetectionDelay(pto_delay, true));
+        }
+      });
+  hdt_alarm->Cancel();
+  const QuicTime::Delta adaptive_delay =
+      detector.GetDetectionDelay(pto_delay, true);
+
+  std::cout << "[quic_handover_simulator] HDT receive path, " << num_packets
+            << " packets " << gap.ToMicroseconds() << " usec apart: "
+            << update_ns << " nsec/packet with per-packet alarm update, "
+            << lazy_ns << " nsec/packet with lazy re-arm" << std::endl;
+  std::cout << "[quic_handover_simulator] HDT delay: "
+            << (pto_delay * 3).ToMilliseconds() << " msec fixed, "
+            << adaptive_delay.ToMilliseconds() << " msec adaptive"
+            << std::endl;
+  std::fstream writer;
+  writer.open("benchmark_hdt.txt", std::ios::app);
+  writer << num_packets << '\t' << gap.ToMicroseconds() << '\t' << update_ns
+         << '\t' << lazy_ns << '\t' << adaptive_delay.ToMilliseconds()
+         << std::endl;
+  writer.close();
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  QuicSystemEventLoop event_loop("quic_handover_simulator");
+  const char* usage =
+      "Usage: quic_handover_simulator --simulate_handover_runs=<N> | "
+      "--benchmark_hdt_packets=<N> [options]";
+  quic::QuicParseCommandLineFlags(usage, argc, argv);
+
+  if (GetQuicFlag(FLAGS_simulate_handover_runs) > 0) {
+    return SimulateHandovers();
+  }
+  if (GetQuicFlag(FLAGS_benchmark_hdt_packets) > 0) {
+    return BenchmarkHandoverDetection();
+  }
+  quic::QuicPrintCommandLineFlagHelp(usage);
+  return 1;
+}
@@ -13,15 +13,40 @@ then
     rsync ../net/third_party/quiche/src/quic/core/quic_dispatcher.* net_backup/third_party/quiche/src/quic/core
     rsync ../net/third_party/quiche/src/quic/tools/quic_toy_server.* ../net/third_party/quiche/src/quic/tools/quic_spdy_server_base.* ../net/third_party/quiche/src/quic/tools/quic_server.* net_backup/third_party/quiche/src/quic/tools
     rsync ../net/tools/quic/quic_simple_server.* net_backup/tools/quic
+    rsync ../net/BUILD.gn net_backup
 fi
 
 
 echo "port quic_handover_module"
 rsync ./net/third_party/quiche/src/quic/core/crypto/tls_connection.* ../net/third_party/quiche/src/quic/core/crypto
-rsync ./net/third_party/quiche/src/quic/core/quic_connection.* ./net/third_party/quiche/src/quic/core/quic_one_block_arena.h ./net/third_party/quiche/src/quic/core/quic_framer.* ./net/third_party/quiche/src/quic/core/quic_path_validator.* ./net/third_party/quiche/src/quic/core/quic_session.* ./net/third_party/quiche/src/quic/core/quic_udp_socket_posix.cc ./net/third_party/quiche/src/quic/core/quic_sent_packet_manager.* ../net/third_party/quiche/src/quic/core
+rsync ./net/third_party/quiche/src/quic/core/quic_connection.* ./net/third_party/quiche/src/quic/core/quic_one_block_arena.h ./net/third_party/quiche/src/quic/core/quic_framer.* ./net/third_party/quiche/src/quic/core/quic_path_validator.* ./net/third_party/quiche/src/quic/core/quic_session.* ./net/third_party/quiche/src/quic/core/quic_udp_socket_posix.cc ./net/third_party/quiche/src/quic/core/quic_sent_packet_manager.* ./net/third_party/quiche/src/quic/core/quic_handover_trace.h ./net/third_party/quiche/src/quic/core/quic_handover_detector.h ./net/third_party/quiche/src/quic/core/quic_handover_controller.h ./net/third_party/quiche/src/quic/core/quic_worker_steering.h ./net/third_party/quiche/src/quic/core/quic_transport_metrics.h ../net/third_party/quiche/src/quic/core
 rsync ./net/third_party/quiche/src/quic/core/congestion_control/pacing_sender.* ../net/third_party/quiche/src/quic/core/congestion_control/
-rsync ./net/third_party/quiche/src/quic/tools/quic_client_base.* ./net/third_party/quiche/src/quic/tools/quic_toy_client.* ./net/third_party/quiche/src/quic/tools/quic_spdy_server_base.* ./net/third_party/quiche/src/quic/tools/quic_client_epoll_network_helper.* ../net/third_party/quiche/src/quic/tools
+rsync ./net/third_party/quiche/src/quic/tools/quic_client_base.* ./net/third_party/quiche/src/quic/tools/quic_toy_client.* ./net/third_party/quiche/src/quic/tools/quic_spdy_server_base.* ./net/third_party/quiche/src/quic/tools/quic_client_epoll_network_helper.* ./net/third_party/quiche/src/quic/tools/quic_handover_simulator.h ./net/third_party/quiche/src/quic/tools/quic_persistent_session_cache.h ./net/third_party/quiche/src/quic/tools/quic_load_generator.h ../net/third_party/quiche/src/quic/tools
 
 rsync ./net/third_party/quiche/src/quic/core/quic_dispatcher.* ../net/third_party/quiche/src/quic/core
-rsync ./net/third_party/quiche/src/quic/tools/quic_toy_server.* ./net/third_party/quiche/src/quic/tools/quic_server.* ../net/third_party/quiche/src/quic/tools
-rsync ./net/tools/quic/quic_simple_server.* ../net/tools/quic
+rsync ./net/third_party/quiche/src/quic/tools/quic_toy_server.* ./net/third_party/quiche/src/quic/tools/quic_server.* ./net/third_party/quiche/src/quic/tools/quic_file_backend.h ./net/third_party/quiche/src/quic/tools/quic_file_dispatcher.h ../net/third_party/quiche/src/quic/tools
+rsync ./net/tools/quic/quic_simple_server.* ./net/tools/quic/quic_handover_simulator_bin.cc ../net/tools/quic
+
+# The simulator links quiche's test_tools, so it gets its own testonly target
+# instead of being part of epoll_quic_client.
+if ! grep -q '"quic_handover_simulator"' ../net/BUILD.gn
+then
+    cat >> ../net/BUILD.gn << 'GN'
+
+if (is_linux || is_chromeos) {
+  executable("quic_handover_simulator") {
+    testonly = true
+    sources = [ "tools/quic/quic_handover_simulator_bin.cc" ]
+    deps = [
+      ":epoll_quic_tools",
+      ":epoll_server",
+      ":net",
+      ":quic_test_tools",
+      ":simple_quic_tools",
+      "//base",
+      "//third_party/boringssl",
+    ]
+  }
+}
+GN
+fi
@@ -12,4 +12,18 @@ then
     rsync ./net_backup/third_party/quiche/src/quic/core/quic_dispatcher.* ../net/third_party/quiche/src/quic/core
     rsync ./net_backup/third_party/quiche/src/quic/tools/quic_toy_server.* ./net_backup/third_party/quiche/src/quic/tools/quic_spdy_server_base.* ./net_backup/third_party/quiche/src/quic/tools/quic_server.* ../net/third_party/quiche/src/quic/tools
     rsync ./net_backup/tools/quic/quic_simple_server.* ../net/tools/quic
+    rsync ./net_backup/BUILD.gn ../net
+
+    # Files added by mQUIC
+    rm -f ../net/third_party/quiche/src/quic/core/quic_handover_trace.h
+    rm -f ../net/third_party/quiche/src/quic/core/quic_handover_detector.h
+    rm -f ../net/third_party/quiche/src/quic/core/quic_handover_controller.h
+    rm -f ../net/third_party/quiche/src/quic/core/quic_worker_steering.h
+    rm -f ../net/third_party/quiche/src/quic/core/quic_transport_metrics.h
+    rm -f ../net/third_party/quiche/src/quic/tools/quic_handover_simulator.h
+    rm -f ../net/third_party/quiche/src/quic/tools/quic_persistent_session_cache.h
+    rm -f ../net/third_party/quiche/src/quic/tools/quic_load_generator.h
+    rm -f ../net/third_party/quiche/src/quic/tools/quic_file_backend.h
+    rm -f ../net/third_party/quiche/src/quic/tools/quic_file_dispatcher.h
+    rm -f ../net/tools/quic/quic_handover_simulator_bin.cc
 fi
\ No newline at end of file
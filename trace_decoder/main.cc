@@ -0,0 +1,303 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Decodes the binary trace written with "--handover_trace" and rebuilds the
+// handover delay and per-request delay reports. Also decodes the transport
+// metrics written with "--transport_metrics" into tab separated columns.
+//
+// The layouts below must match quic/core/quic_handover_trace.h and
+// quic/core/quic_transport_metrics.h.
+
+struct TraceRecord {
+    uint64_t time_us;
+    uint64_t connection;
+    int64_t value;
+    uint32_t arg;
+    uint8_t event;
+    uint8_t perspective;
+    uint8_t padding[2];
+};
+static_assert(sizeof(TraceRecord) == 32, "must match HandoverTraceRecord");
+
+enum Event {
+    kHdtArmed = 0,
+    kHdtFired = 1,
+    kRltLookup = 2,
+    kRltDeadline = 3,
+    kWriteError = 4,
+    kPathChallengeSent = 5,
+    kPathChallengeReceived = 6,
+    kPathResponseSent = 7,
+    kPathResponseReceived = 8,
+    kMigrationComplete = 9,
+    kFirstDataOnNewPath = 10,
+    kRequestStart = 11,
+    kRequestEnd = 12,
+    kRecordsDropped = 13,
+};
+
+const char* kEventNames[] = {
+    "HDT_ARMED",      "HDT_FIRED",     "RLT_LOOKUP",    "RLT_DEADLINE",
+    "WRITE_ERROR",    "PC_SENT",       "PC_RECEIVED",   "PR_SENT",
+    "PR_RECEIVED",    "MIGRATED",      "FIRST_DATA",    "REQUEST_START",
+    "REQUEST_END",    "DROPPED",
+};
+
+// Per connection state while walking the trace.
+struct Handover {
+    uint64_t first_error_us = 0;
+    uint64_t hdt_fired_us = 0;
+    int64_t hdt_delay_us = 0;
+    uint64_t pc_sent_us = 0;
+    uint64_t pr_received_us = 0;
+    uint64_t migrated_us = 0;
+};
+
+struct MetricsRecord {
+    uint64_t time_us;
+    uint64_t connection;
+    uint64_t congestion_window;
+    uint64_t bytes_in_flight;
+    uint64_t bandwidth_estimate_bps;
+    uint64_t pacing_rate_bps;
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint32_t smoothed_rtt_us;
+    uint32_t min_rtt_us;
+    uint32_t packets_lost;
+    uint32_t packets_retransmitted;
+    uint32_t num_connections;
+    uint8_t kind;
+    uint8_t perspective;
+    uint8_t worker;
+    uint8_t padding;
+};
+static_assert(sizeof(MetricsRecord) == 88, "must match TransportMetricsRecord");
+
+enum MetricsKind {
+    kConnection = 0,
+    kAggregate = 1,
+    kMetricsDropped = 2,
+};
+
+double ToMs(int64_t us) {
+    return us / 1000.0;
+}
+
+double ToMbps(uint64_t bps) {
+    return bps / 1e6;
+}
+
+// Writes the columns shared by connection and aggregate samples.
+void WriteMetrics(std::ostream& out, const MetricsRecord& record) {
+    out << record.congestion_window << '\t' << record.bytes_in_flight << '\t'
+        << ToMs(record.smoothed_rtt_us) << '\t' << ToMs(record.min_rtt_us) << '\t'
+        << ToMbps(record.bandwidth_estimate_bps) << '\t' << ToMbps(record.pacing_rate_bps) << '\t'
+        << record.bytes_sent << '\t' << record.bytes_received << '\t'
+        << record.packets_lost << '\t' << record.packets_retransmitted << std::endl;
+}
+
+// Decodes a transport metrics file into "trace_metrics.txt", one line per
+// connection sample, and "trace_metrics_aggregate.txt", one line per worker
+// and sampling round. Times are relative to the start of each run.
+int DecodeMetrics(std::ifstream& input, bool dump) {
+    const char* kColumns = "cwnd\tinflight\tsrtt\tmin_rtt\tbw_mbps\tpacing_mbps\tsent\treceived\tlost\tretransmitted";
+    std::ofstream connection_report("trace_metrics.txt");
+    std::ofstream aggregate_report("trace_metrics_aggregate.txt");
+    connection_report << std::fixed << std::setprecision(3);
+    aggregate_report << std::fixed << std::setprecision(3);
+    connection_report << "# time\tconnection\t" << kColumns << " (msec, bytes)" << std::endl;
+    aggregate_report << "# time\tworker\tperspective\tconnections\t" << kColumns
+        << " (msec, bytes, sums except srtt (mean) and min_rtt (min))" << std::endl;
+
+    uint64_t num_records = 0;
+    uint64_t run_start_us = 0;
+    char buffer[sizeof(MetricsRecord)];
+    while (input.read(buffer, 8)) {
+        if (memcmp(buffer, "MQTM", 4) == 0) {
+            uint32_t version;
+            memcpy(&version, buffer + 4, sizeof(version));
+            if (version != 1) {
+                std::cerr << "Unsupported metrics version " << version << std::endl;
+                return 1;
+            }
+            run_start_us = 0;
+            continue;
+        }
+        if (!input.read(buffer + 8, sizeof(MetricsRecord) - 8)) {
+            std::cerr << "Truncated record at the end of the metrics" << std::endl;
+            break;
+        }
+        MetricsRecord record;
+        memcpy(&record, buffer, sizeof(record));
+        num_records++;
+        if (record.kind == kMetricsDropped) {
+            std::cerr << "Warning: " << record.num_connections
+                << " samples were dropped while recording" << std::endl;
+            continue;
+        }
+        if (run_start_us == 0) {
+            run_start_us = record.time_us;
+        }
+        const double time_ms = ToMs(record.time_us - run_start_us);
+        if (record.kind == kConnection) {
+            connection_report << time_ms << '\t' << std::hex << record.connection << std::dec << '\t';
+            WriteMetrics(connection_report, record);
+            if (dump) {
+                std::cout << time_ms << '\t' << std::hex << record.connection << std::dec << '\t';
+                WriteMetrics(std::cout, record);
+            }
+        } else if (record.kind == kAggregate) {
+            aggregate_report << time_ms << '\t' << static_cast<int>(record.worker) << '\t'
+                << (record.perspective == 0 ? "server" : "client") << '\t'
+                << record.num_connections << '\t';
+            WriteMetrics(aggregate_report, record);
+        }
+    }
+    connection_report.close();
+    aggregate_report.close();
+
+    std::cout << "Metrics records: " << num_records << std::endl;
+    return 0;
+}
+
+// Prints the time of |event_us| relative to |start_us|, or "-".
+std::string Phase(uint64_t start_us, uint64_t event_us) {
+    if (event_us == 0 || event_us < start_us) {
+        return "-";
+    }
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3) << ToMs(event_us - start_us);
+    return out.str();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <trace file> [--dump]" << std::endl;
+        return 1;
+    }
+    bool dump = argc > 2 && std::string(argv[2]) == "--dump";
+
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input.is_open()) {
+        std::cerr << "Failed to open " << argv[1] << std::endl;
+        return 1;
+    }
+    char magic[4];
+    if (input.read(magic, sizeof(magic)) && memcmp(magic, "MQTM", 4) == 0) {
+        input.seekg(0);
+        return DecodeMetrics(input, dump);
+    }
+    input.clear();
+    input.seekg(0);
+
+    std::ofstream ho_report("trace_ho_delay.txt");
+    std::ofstream req_report("trace_per_req_delay.txt");
+    ho_report << std::fixed << std::setprecision(3);
+    req_report << std::fixed << std::setprecision(3);
+    ho_report << "# ho_delay\tdetect\tpc_sent\tpr_received\tmigrated\thdt_delay (msec, from last data on old path)" << std::endl;
+
+    std::map<uint64_t, Handover> handovers;
+    std::map<uint64_t, uint64_t> request_starts;
+    double sum_req_delay = 0;
+    uint64_t num_records = 0;
+    uint64_t num_handovers = 0;
+
+    // The file is appended to by every run, each run starts with an 8 byte
+    // header ("MQTR" and a version) followed by 32 byte records.
+    char buffer[sizeof(TraceRecord)];
+    while (input.read(buffer, 8)) {
+        if (memcmp(buffer, "MQTR", 4) == 0) {
+            uint32_t version;
+            memcpy(&version, buffer + 4, sizeof(version));
+            if (version != 1) {
+                std::cerr << "Unsupported trace version " << version << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (!input.read(buffer + 8, sizeof(TraceRecord) - 8)) {
+            std::cerr << "Truncated record at the end of the trace" << std::endl;
+            break;
+        }
+        TraceRecord record;
+        memcpy(&record, buffer, sizeof(record));
+        num_records++;
+
+        if (dump) {
+            std::cout << record.time_us << '\t' << std::hex << record.connection << std::dec << '\t'
+                << (record.event <= kRecordsDropped ? kEventNames[record.event] : "UNKNOWN")
+                << '\t' << record.value << '\t' << record.arg << std::endl;
+        }
+
+        Handover& ho = handovers[record.connection];
+        switch (record.event) {
+        case kWriteError:
+            if (ho.first_error_us == 0) {
+                ho.first_error_us = record.time_us;
+            }
+            break;
+        case kHdtFired:
+            ho.hdt_fired_us = record.time_us;
+            ho.hdt_delay_us = record.value;
+            break;
+        case kPathChallengeSent:
+            if (ho.pc_sent_us == 0) {
+                ho.pc_sent_us = record.time_us;
+            }
+            break;
+        case kPathResponseReceived:
+            ho.pr_received_us = record.time_us;
+            break;
+        case kMigrationComplete:
+            ho.migrated_us = record.time_us;
+            break;
+        case kFirstDataOnNewPath: {
+            // The handover started with the last data received on the old path.
+            uint64_t start_us = record.time_us - record.value;
+            uint64_t detect_us = ho.first_error_us;
+            if (detect_us == 0 || (ho.hdt_fired_us != 0 && ho.hdt_fired_us < detect_us)) {
+                detect_us = ho.hdt_fired_us;
+            }
+            ho_report << ToMs(record.value) << '\t' << Phase(start_us, detect_us) << '\t'
+                << Phase(start_us, ho.pc_sent_us) << '\t' << Phase(start_us, ho.pr_received_us) << '\t'
+                << Phase(start_us, ho.migrated_us) << '\t' << ToMs(ho.hdt_delay_us) << std::endl;
+            ho = Handover();
+            num_handovers++;
+            break;
+        }
+        case kRequestStart:
+            request_starts[record.connection] = record.time_us;
+            break;
+        case kRequestEnd: {
+            auto it = request_starts.find(record.connection);
+            if (it != request_starts.end()) {
+                double delay = ToMs(record.time_us - it->second);
+                req_report << delay << std::endl;
+                sum_req_delay += delay;
+                request_starts.erase(it);
+            }
+            break;
+        }
+        case kRecordsDropped:
+            std::cerr << "Warning: " << record.value << " records were dropped while tracing" << std::endl;
+            break;
+        default:
+            break;
+        }
+    }
+    req_report << sum_req_delay << std::endl;
+
+    ho_report.close();
+    req_report.close();
+
+    std::cout << "Records: " << num_records << " / Handovers: " << num_handovers << std::endl;
+    return 0;
+}